@@ -0,0 +1,139 @@
+/**
+ * Temperature data logger.
+ *
+ * Configuration in EEPROM: the server strings from Strings, each up to its
+ * terminator, then the journal of ConfigStore.h holding records made of the
+ * config struct and the CRC-16 of the strings.  Shared by Misc.pde and the
+ * host benchmark, which give the addresses.
+ *
+ * The layout before the journal was the config struct from address 0, the
+ * strings right after it, then an 8 bits sum of all that from
+ * CONFIG_OLD_SEED.  When no journal record is valid, a configuration found
+ * there is moved to the journal once: the record first, in the first slot
+ * clear of the former layout, then the strings down to their place.  A
+ * reset while the strings are moved leaves the record, the strings failing
+ * their CRC being cleared at the next boot.
+ */
+
+#ifndef ConfigLayout_H
+#define ConfigLayout_H
+
+#include "ConfigStore.h"
+
+#define CONFIG_STRINGS   3
+#define CONFIG_OLD_SEED  33
+
+// The layout of Misc.pde: SRV_HOST_EEPROM, SRV_URL_EEPROM and SRV_HDR_EEPROM, then the journal
+#define CONFIG_HOST_LEN  30
+#define CONFIG_URL_LEN   50
+#define CONFIG_HDR_LEN   90
+#define CONFIG_SLOTS     7
+
+// First EEPROM address after that layout, for records of Size bytes
+#define CONFIG_EEPROM_END(Size)  (CONFIG_HOST_LEN + CONFIG_URL_LEN + CONFIG_HDR_LEN + \
+                                  CONFIG_SLOTS * CONFIG_SLOT_LEN(Size))
+
+// ConfigLoad() results
+#define CONFIG_NONE      0  // Nothing valid, set the defaults and save them
+#define CONFIG_LOADED    1
+#define CONFIG_MIGRATED  2  // From the former layout
+
+typedef struct {
+  ConfigStore Journal;  // Records of Size bytes: the config struct, then the CRC of the strings, little endian
+  uint16_t Strings;     // EEPROM address of the first string, the others following it
+  uint8_t StringLen[CONFIG_STRINGS];
+} ConfigLayout;
+
+// EEPROM addresses are kept as numbers, the first ones being 0
+static uint8_t *ConfigAddr(uint16_t Addr) {
+  return (uint8_t *)(uintptr_t)Addr;
+}
+
+static uint16_t ConfigStringsCRC(const ConfigLayout *Layout, uint16_t Strings) {
+  uint16_t CRC = Layout->Journal.Seed;
+
+  for (uint8_t i = 0; i < CONFIG_STRINGS; i++) {
+    CRC = ConfigStringCRC(CRC, ConfigAddr(Strings), Layout->StringLen[i]);
+    Strings += Layout->StringLen[i];
+  }
+  return CRC;
+}
+
+static void ConfigClearStrings(const ConfigLayout *Layout) {
+  uint16_t Addr = Layout->Strings;
+
+  for (uint8_t i = 0; i < CONFIG_STRINGS; i++) {
+    ConfigUpdateByte(ConfigAddr(Addr), 0);
+    Addr += Layout->StringLen[i];
+  }
+}
+
+// Save Record, a config struct followed by room for the CRC of the strings
+static void ConfigSave(ConfigLayout *Layout, void *Record) {
+  uint8_t *CRCPt = (uint8_t *)Record + Layout->Journal.Size - 2;
+  uint16_t CRC = ConfigStringsCRC(Layout, Layout->Strings);
+
+  CRCPt[0] = CRC & 0xff;
+  CRCPt[1] = CRC >> 8;
+  ConfigStoreSave(&Layout->Journal, Record);
+}
+
+// Move a configuration of the former layout into Record and the journal, false if there is none
+static bool ConfigMigrate(ConfigLayout *Layout, void *Record) {
+  uint8_t Size = Layout->Journal.Size - 2, Cks = CONFIG_OLD_SEED, *Out = (uint8_t *)Record;
+  uint16_t Old = Size, New = Layout->Strings, End = Size, CRC;
+  uint8_t Slot, c;
+
+  for (uint8_t i = 0; i < CONFIG_STRINGS; i++)
+    End += Layout->StringLen[i];
+  for (uint16_t i = 0; i < End; i++)
+    Cks += eeprom_read_byte(ConfigAddr(i));
+  if (Cks != eeprom_read_byte(ConfigAddr(End)))
+    return false;
+
+  // The first slot past the checksum
+  for (Slot = 0; Slot < Layout->Journal.Slots && ConfigSlot(&Layout->Journal, Slot) <= ConfigAddr(End); Slot++)
+    ;
+  if (Slot == Layout->Journal.Slots)
+    return false;
+
+  for (uint8_t i = 0; i < Size; i++)
+    Out[i] = eeprom_read_byte(ConfigAddr(i));
+  CRC = ConfigStringsCRC(Layout, Old);
+  Out[Size] = CRC & 0xff;
+  Out[Size + 1] = CRC >> 8;
+  Layout->Journal.Newest = Slot - 1;
+  ConfigStoreSave(&Layout->Journal, Record);
+
+  // Down to their place, the new addresses being lower
+  for (uint8_t i = 0; i < CONFIG_STRINGS; i++) {
+    for (uint8_t j = 0; j < Layout->StringLen[i]; j++) {
+      c = eeprom_read_byte(ConfigAddr(Old + j));
+      ConfigUpdateByte(ConfigAddr(New + j), c);
+      if (c == 0)
+        break;
+    }
+    Old += Layout->StringLen[i];
+    New += Layout->StringLen[i];
+  }
+  return true;
+}
+
+/*
+ * Load the newest record into Record, see the results above.  Strings
+ * failing the CRC of the record, written partly when a reset came, are
+ * cleared and the record saved again.
+ */
+static uint8_t ConfigLoad(ConfigLayout *Layout, void *Record) {
+  const uint8_t *CRCPt = (const uint8_t *)Record + Layout->Journal.Size - 2;
+
+  if (!ConfigStoreLoad(&Layout->Journal, Record))
+    return ConfigMigrate(Layout, Record) ? CONFIG_MIGRATED : CONFIG_NONE;
+  if ((CRCPt[0] | (uint16_t)CRCPt[1] << 8) != ConfigStringsCRC(Layout, Layout->Strings)) {
+    ConfigClearStrings(Layout);
+    ConfigSave(Layout, Record);
+  }
+  return CONFIG_LOADED;
+}
+
+#endif
@@ -0,0 +1,161 @@
+/**
+ * Temperature data logger.
+ *
+ * Journal of configuration records in EEPROM.  The region holds Slots
+ * slots written in turn, each save going to the slot after the newest one,
+ * so that every cell takes one write per Slots saves:
+ *
+ *   Seq     2 bytes, little endian, +1 per save
+ *   Data    Size bytes
+ *   CRC     2 bytes, CRC-16 0x1021 of Seq and Data from Seed
+ *
+ * Bytes are only written when they differ from what the cell holds, and a
+ * save of unchanged data writes nothing.  The CRC is written last: a save
+ * cut by a reset leaves a record failing its CRC and the load falls back to
+ * the previous one.
+ *
+ * Loading reads the Seq of the slots until the run of consecutive numbers
+ * breaks, then checks the CRC of the newest record only, instead of
+ * checksumming the whole EEPROM.  Only when that one is bad are the records
+ * before it checked in turn.
+ */
+
+#ifndef ConfigStore_H
+#define ConfigStore_H
+
+#include <avr/eeprom.h>
+#include <stdint.h>
+
+#define CONFIG_SLOT_LEN(Size)  ((Size) + 4)
+
+typedef struct {
+  uint8_t *Base;     // EEPROM address of slot 0, Slots * CONFIG_SLOT_LEN(Size) bytes
+  uint8_t Slots;
+  uint8_t Size;      // Bytes of data per record
+  uint16_t Seed;     // CRC initial value, change it to invalidate the records on a layout change
+  // Set by ConfigStoreLoad()
+  uint8_t Newest;    // Slots if there is no valid record
+  uint16_t Seq;
+} ConfigStore;
+
+#ifdef __AVR__
+#include <util/crc16.h>
+#endif
+
+static uint16_t ConfigCRC16(uint16_t CRC, uint8_t Data) {
+#ifdef __AVR__
+  return _crc_xmodem_update(CRC, Data);  // Same CRC, in assembler
+#else
+  CRC ^= (uint16_t)Data << 8;
+  for (uint8_t i = 0; i < 8; i++)
+    CRC = (CRC & 0x8000) ? (CRC << 1) ^ 0x1021 : CRC << 1;
+  return CRC;
+#endif
+}
+
+// CRC of a 0 terminated string in EEPROM, reading up to its terminator
+static uint16_t ConfigStringCRC(uint16_t CRC, const uint8_t *Str, uint8_t Size) {
+  uint8_t c;
+
+  for (uint8_t i = 0; i < Size; i++) {
+    c = eeprom_read_byte(Str + i);
+    CRC = ConfigCRC16(CRC, c);
+    if (c == 0)
+      break;
+  }
+  return CRC;
+}
+
+// Write a byte only if the cell holds another value
+static void ConfigUpdateByte(uint8_t *Addr, uint8_t Value) {
+  if (eeprom_read_byte(Addr) != Value)
+    eeprom_write_byte(Addr, Value);
+}
+
+static uint8_t *ConfigSlot(const ConfigStore *Store, uint8_t Slot) {
+  return Store->Base + Slot * CONFIG_SLOT_LEN(Store->Size);
+}
+
+static uint16_t ConfigSlotSeq(const ConfigStore *Store, uint8_t Slot) {
+  uint8_t *Pt = ConfigSlot(Store, Slot);
+
+  return eeprom_read_byte(Pt) | (uint16_t)eeprom_read_byte(Pt + 1) << 8;
+}
+
+// Read the data of a slot into Data, true if its CRC is right
+static bool ConfigSlotRead(const ConfigStore *Store, uint8_t Slot, void *Data) {
+  uint8_t *Pt = ConfigSlot(Store, Slot), *Out = (uint8_t *)Data;
+  uint16_t CRC = Store->Seed;
+
+  CRC = ConfigCRC16(CRC, eeprom_read_byte(Pt++));
+  CRC = ConfigCRC16(CRC, eeprom_read_byte(Pt++));
+  for (uint8_t i = 0; i < Store->Size; i++) {
+    *Out = eeprom_read_byte(Pt++);
+    CRC = ConfigCRC16(CRC, *Out++);
+  }
+  return (eeprom_read_byte(Pt) | (uint16_t)eeprom_read_byte(Pt + 1) << 8) == CRC;
+}
+
+/*
+ * Load the newest valid record into Data, false if there is none (blank or
+ * corrupted EEPROM).  Either way, the store is then ready for saves.
+ */
+static bool ConfigStoreLoad(ConfigStore *Store, void *Data) {
+  uint16_t Seq = ConfigSlotSeq(Store, 0), Next;
+  uint8_t Slot;
+
+  // Newest: the last of the run of consecutive numbers from slot 0
+  for (Slot = 0; Slot + 1 < Store->Slots; Slot++) {
+    Next = ConfigSlotSeq(Store, Slot + 1);
+    if (Next != (uint16_t)(Seq + 1))
+      break;
+    Seq = Next;
+  }
+
+  // Or the newest valid one before, if the last save was cut
+  for (uint8_t Try = 0; Try < Store->Slots; Try++) {
+    if (ConfigSlotRead(Store, Slot, Data)) {
+      Store->Newest = Slot;
+      Store->Seq = ConfigSlotSeq(Store, Slot);
+      return true;
+    }
+    Slot = (Slot == 0 ? Store->Slots : Slot) - 1;
+  }
+
+  // Start over from slot 0
+  Store->Newest = Store->Slots;
+  Store->Seq = 0xffff;
+  return false;
+}
+
+// Save Data as the newest record, unless it is the same as the current one
+static void ConfigStoreSave(ConfigStore *Store, const void *Data) {
+  const uint8_t *In = (const uint8_t *)Data;
+  uint8_t *Pt;
+  uint16_t CRC;
+  uint8_t i;
+
+  if (Store->Newest < Store->Slots) {
+    Pt = ConfigSlot(Store, Store->Newest) + 2;
+    for (i = 0; i < Store->Size && eeprom_read_byte(Pt + i) == In[i]; i++)
+      ;
+    if (i == Store->Size)
+      return;
+  }
+
+  Store->Newest = Store->Newest + 1 >= Store->Slots ? 0 : Store->Newest + 1;
+  Store->Seq++;
+  Pt = ConfigSlot(Store, Store->Newest);
+  CRC = ConfigCRC16(Store->Seed, Store->Seq & 0xff);
+  CRC = ConfigCRC16(CRC, Store->Seq >> 8);
+  ConfigUpdateByte(Pt++, Store->Seq & 0xff);
+  ConfigUpdateByte(Pt++, Store->Seq >> 8);
+  for (i = 0; i < Store->Size; i++) {
+    CRC = ConfigCRC16(CRC, In[i]);
+    ConfigUpdateByte(Pt++, In[i]);
+  }
+  ConfigUpdateByte(Pt++, CRC & 0xff);
+  ConfigUpdateByte(Pt, CRC >> 8);
+}
+
+#endif
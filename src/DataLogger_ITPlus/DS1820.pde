@@ -7,13 +7,17 @@
  *
  * Gérard Chevalier, Jan 2011
  * March 2011, added DS18B20 / DS18S20 logic, 18S20 code is the same as old 1820.
+ *
+ * The conversion takes up to 750 ms, during which loop() must keep serving
+ * the RF12 and the network: Start1820Tmp() only starts it, and Poll1820Tmp(),
+ * called from every loop(), reads the scratchpad once it is over.
  */
 #include "DataloggerDefs.h"
 #include <OneWire.h>
 
-extern char CommonStrBuff[];
 extern void DebugPrint_P(const char *);
 extern void DebugPrintln_P(const char *);
+void Read1820Tmp();
 
 // if B_MODEL defined, temp reading will use 18B20 model scheme, otherwise 18S20/1820 is assumed
 #define B_MODEL
@@ -24,21 +28,63 @@ byte HighByte, LowByte, TReading, CentralTempSignBit, CentralTempWhole, CentralT
 byte TempRead, CountRemain;
 word Tc_100;
 
+// Max conversion time, 12 bits for the 18B20
+#define DS1820_CONVERSION_MS 750
+
+byte DS1820State = DS1820_IDLE;
+unsigned long ConversionStart;
+
 void DS1820Init() {
 }
 
-void Get1820Tmp() {
-  byte i;
-  byte present = 0;
-  byte OneWData[12];
-  
-  ds.reset();
+// Start a conversion, unless one is running or no sensor answers
+void Start1820Tmp() {
+  if (DS1820State != DS1820_IDLE)
+    return;
+  if (!ds.reset())
+    return;
   ds.skip();
   ds.write(0x44, 1);         // start conversion, with parasite power on at the end
-  
-  delay(1000);     // maybe 750ms is enough, maybe not
+  ConversionStart = millis();
+  DS1820State = DS1820_CONVERTING;
+}
+
+// Step the conversion started by Start1820Tmp(), does nothing when idle
+void Poll1820Tmp() {
+  switch (DS1820State) {
+  case DS1820_IDLE:
+    return;
+  case DS1820_CONVERTING:
+    if (millis() - ConversionStart < DS1820_CONVERSION_MS) {
+#ifdef DS1820_POWERED
+      // The sensor holds the bus low while converting
+      if (ds.read_bit() == 0)
+        return;
+#else
+      // Reading would cut the parasite power
+      return;
+#endif
+    }
+    DS1820State = DS1820_READ;
+    return;
+  case DS1820_READ:
+    DS1820State = DS1820_IDLE;
+    Read1820Tmp();
+    return;
+  }
+}
+
+// Read the scratchpad of the conversion just done
+void Read1820Tmp() {
+  byte i;
+  byte present;
+  byte OneWData[12];
+
   // we might do a ds.depower() here, but the reset will take care of it.
   present = ds.reset();
+  // Unplugged during the conversion: keep the t° values, as for a CRC error
+  if (!present)
+    return;
   ds.skip();
   ds.write(0xBE);         // Read Scratchpad
 
@@ -109,8 +155,11 @@ void Get1820Tmp() {
 
 #endif
 #ifdef DS1820_DEBUG
-  sprintf(CommonStrBuff, "1Wire: %c%d.%d", CentralTempSignBit != 0 ? '-' : '+', CentralTempWhole, CentralTempFract);
-  Serial.println(CommonStrBuff);
+  DebugPrint_P(PSTR("1Wire: "));
+  Serial.print(CentralTempSignBit != 0 ? '-' : '+');
+  Serial.print(CentralTempWhole, DEC);
+  Serial.print('.');
+  Serial.println(CentralTempFract, DEC);
 #endif
 }
 
@@ -19,18 +19,23 @@ extern void RF12Init();
 extern void NetworkInitialize();
 extern void TX433Init();
 extern void WebSend();
+extern void WebQueuePush();
+extern void WebQueueSend();
 extern void DecodeFrame();
-extern void Get1820Tmp();
+extern void Start1820Tmp();
+extern void Poll1820Tmp();
 extern void CheckRF12Recept();
 extern void switchON();
 extern void switchOFF();
 extern void DebugPrint_P(const char *);
 extern void DebugPrintln_P(const char *);
 extern void CheckProcessBrowserRequest();
+extern void ITPlusMinuteTick();
 
 extern byte CentralTempSignBit, CentralTempWhole, CentralTempFract;
 extern Type_Channel ITPlusChannels[];
 extern Type_Discovered DiscoveredITPlus[];
+extern byte StalledSensors;
 extern Type_Config Config;
 extern word LastServerSendOK;
 extern byte buf[];
@@ -42,6 +47,7 @@ unsigned long previousMillis = 0;
 // Most of time calculation done in mn with 8 bits, having so a roll-over of about 4 h
 // But total nb of mn stored as 16 bits (~1092 h, ~45.5 days)
 byte LastWebSend = 0;
+byte LastWebQueued = 0;
 word Minutes = 0;
 
 // For seconds, 1 byte also used as we just want to check within 1 minute
@@ -53,9 +59,11 @@ byte badPeriodNb = 0;
 byte boxRebootCount = 0;
 byte boxRebootFlag = BOX_REBOOT_IDLE;
 boolean plugTestRequest = false;
+// Set on a 200 OK when more reports are queued, see WebQueue.pde
+boolean WebDrain = false;
 
-// "0,-tt.dNL1,-tt.dNL2,-tt.dNL3,-tt.dNL0" xxxxxxxxxxxxxxxx 0,-tt.dNL1,-tt.dNL2,-tt.dNL3,-tt.dNL4,-tt.dNL5,-tt.dNL6,-tt.dNL0
-char CommonStrBuff[50], *PtData;
+// "0,-tt.dNL1,-tt.dNL2,-tt.dNL3,-tt.d" or a batch of queued reports, must stay untouched up to the server answer
+char ReportBuff[REPORT_BATCH_LEN + 1];
 
 // SignalError tells if an error has to be signaled on LED, 0=No, 1&2=yes, 2 values for blinking
 byte SignalError = 1;
@@ -116,13 +124,8 @@ void loop() {
   // If one minute elapsed, check what we have to do
   if (ANewMinute) {
     ANewMinute = false;
-    // Decrement LastReceiveTimer for all channels every mn...
-    for (byte Channel = 0; Channel < ITPLUS_MAX_SENSORS; Channel++) {
-      if (ITPlusChannels[Channel].LastReceiveTimer != 0) ITPlusChannels[Channel].LastReceiveTimer--;
-    }
-    for (byte Channel = 0; Channel < ITPLUS_MAX_DISCOVER; Channel++) {
-      if (DiscoveredITPlus[Channel].LastReceiveTimer != 0) DiscoveredITPlus[Channel].LastReceiveTimer--;
-    }
+    // Expire the receive timers of sensors we didn't hear from
+    ITPlusMinuteTick();
 
     // To simplify, a new DS1820 measure is triggered every minute
     Acquire1820 = true;
@@ -182,6 +185,12 @@ Watchdog:
      wdt_reset();
      */
 
+    // Queue a report every "WebSendPeriod" mn, even if it can't be sent now: it is kept until the server got it
+    if ((byte)((byte)Minutes - LastWebQueued) >= Config.WebSendPeriod) {
+      LastWebQueued = (byte)Minutes;
+      WebQueuePush();
+    }
+
     // Check if we have to send to WEB server (and send only if DNS lookup was OK or not needed)
     // We send every "WebSendPeriod" mn. If a send fails, there will be MAX_WEB_RETRY attempts (at one mn interval) within the
     // current period, but the next sed period will be still calculated from the fisrt attempt (not the last good try) to keep
@@ -204,41 +213,24 @@ Watchdog:
 #endif
       }
 
-      PtData = CommonStrBuff;
-
-      // DataStream 0 is local DS1820 temp
-      PtData += sprintf(PtData, "0,");
-      if (CentralTempSignBit)
-        *PtData++ = '-';
-      PtData += sprintf(PtData, "%d.%d\r\n", CentralTempWhole, CentralTempFract);
-
-      // DataStream 1 to ITPLUS_MAX_SENSORS are IT+ Sensors
-      for (byte Channel = 0; Channel < ITPLUS_MAX_SENSORS; Channel++) {
-        if (ITPlusChannels[Channel].SensorID != 0xff) {  // Send only if registered
-          if (ITPlusChannels[Channel].LastReceiveTimer != 0) {  // Send only if valid temp received
-            //                        "0,-tt.dNL1,-tt.dNL2,-tt.dNL3,-tt.dNL0"
-            PtData += sprintf(PtData, "%d,", Channel + 1);
-            if (ITPlusChannels[Channel].Temp & 0x80)
-              *PtData++ = '-';
-            PtData += sprintf(PtData, "%d.%d\r\n", ITPlusChannels[Channel].Temp & 0x7f, ITPlusChannels[Channel].DeciTemp);
-          }
-        }
-      }
-
-      // Remove last CR/LF
-      *(PtData - 2) = 0;
-#if DEBUG_HTTP
-      DebugPrint_P(PSTR("POST ")); 
-      Serial.println(CommonStrBuff);
-#endif
-      WebSend(CommonStrBuff);
+      // Retries send the same queued reports
+      WebQueueSend();
     }
   }
 
+  // Catch up with the reports queued while the server could not be reached, one batch per answer
+  if (WebDrain) {
+    WebDrain = false;
+    justSent = 1;  // Retried every minute like a period report
+    WebQueueSend();
+  }
+
+  // The conversion goes on while the radio and the network are served
   if (Acquire1820) {
-    Get1820Tmp();
+    Start1820Tmp();
     Acquire1820 = false;
   }
+  Poll1820Tmp();
 
   CheckProcessBrowserRequest();
   CheckRF12Recept();
@@ -258,14 +250,7 @@ Watchdog:
     while (true) ;
   }
   // Check error condition for signaling through LED
-  ErrorCondition = false;
-  for (byte Channel = 0; Channel < ITPLUS_MAX_SENSORS; Channel++) {
-    if (ITPlusChannels[Channel].SensorID != 0xff &&  // La Crosse receive OK check, only if registered
-    ITPlusChannels[Channel].LastReceiveTimer == 0) {
-      ErrorCondition = true;
-      break;
-    }
-  }
+  ErrorCondition = StalledSensors != 0;  // La Crosse receive OK check, only for registered sensors
   /* xx Check removed as RF12 "enabling" was removed, always on error condition
    if (!ErrorCondition) {
    for (byte Channel = 0; Channel < MAX_JEENODE; Channel++) {
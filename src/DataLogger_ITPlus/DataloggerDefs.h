@@ -11,11 +11,18 @@
 // Central Node DS1820 sensor debug flags
 //#define DS1820_DEBUG
 //#define DS1820_DEBUG_LOW
+// DS1820 VDD wired rather than parasite powered: the end of the conversion is polled
+//#define DS1820_POWERED
 #define DEBUG_BOX_REBOOT
 
 // IT+ Decoding debug flags
 //#define ITPLUS_DEBUG_FRAME
 //#define ITPLUS_DEBUG
+//#define DEBUG_CRC
+
+// IT+ CRC implementation, see ITPlusCRC.h: ITPLUS_CRC_BITWISE (no table),
+// ITPLUS_CRC_NIBBLE (16 bytes of flash) or ITPLUS_CRC_TABLE (256 bytes of flash)
+#define ITPLUS_CRC_IMPL ITPLUS_CRC_NIBBLE
 
 // Network debuging flag
 //#define DEBUG_ETH 1 // set to 1 to show incoming requests on serial port
@@ -45,6 +52,26 @@
 #define ITPLUS_MAX_DISCOVER  5
 #define ITPLUS_DISCOVERY_PERIOD 255
 
+// One receive timer per ITPlusChannels entry, then one per DiscoveredITPlus entry, see SensorTimer.pde
+#define SENSOR_TIMERS        (ITPLUS_MAX_SENSORS + ITPLUS_MAX_DISCOVER)
+#define CHANNEL_TIMER(i)     (i)
+#define DISCOVERED_TIMER(i)  (ITPLUS_MAX_SENSORS + (i))
+
+// Worst case WebSend report: "nn,-tt.d" records for the DS1820 and every IT+ channel, CR/LF separated
+#define REPORT_MAX_LEN  ((1 + ITPLUS_MAX_SENSORS) * 10)
+// WebSend batch of queued reports, "nn,2026-10-17T11:31:00Z,-tt.d" records, see WebQueue.pde.
+// Holds one worst case report with some room to spare, StrPrint::full() telling a cut one.
+#define REPORT_BATCH_LEN  ((1 + ITPLUS_MAX_SENSORS) * 31)
+
+// tcp/ip send and receive buffer of Network.pde
+#define ETH_BUFFER_LEN  800
+
+// Pages sent over several packets are written by a generator, one part per packet: each call writes part
+// Part of the page and returns true if more parts follow.  A part must fit in a packet with the headers,
+// see PageStream.pde.
+class BufferFiller;
+typedef boolean (*PageGenerator)(BufferFiller& buf, byte Part);
+
 #define FIRST_JEENODE  10
 #define MAX_JEENODE    3
 
@@ -57,12 +84,24 @@ typedef struct {
     byte ITPlusID[ITPLUS_MAX_SENSORS];  // IT+ Sensors ID for Registered sensors
 } Type_Config;
 
+// Record of the configuration journal in EEPROM, see Misc.pde
+typedef struct {
+  Type_Config Config;
+  word StringsCRC;
+} Type_ConfigRecord;
+
 #define DNS_INIT	0
 #define DNS_WAIT_ANSWER	1
 #define DNS_GOT_ANSWER	2
 #define DNS_NO_HOST	3
 
+// DS1820 read steps, see DS1820.pde
+#define DS1820_IDLE		0
+#define DS1820_CONVERTING	1
+#define DS1820_READ		2
+
 // Radio Sensor structure (both RF12 & IT+)
+// LastReceiveTimer is set to the timeout on receive and cleared when the sensor timer expires
 typedef struct {
   byte SensorID;
   byte LastReceiveTimer;
@@ -76,6 +115,13 @@ typedef struct {
   byte Temp, DeciTemp;
 } Type_Discovered;
 
+// One period of reports queued by WebQueue.pde: stream 0 is the DS1820, then the IT+ channels
+typedef struct {
+  word Minutes;
+  byte Temp[1 + ITPLUS_MAX_SENSORS];      // Sign bit and whole degrees, as in Type_Channel
+  byte DeciTemp[1 + ITPLUS_MAX_SENSORS];
+} Type_Sample;
+
 #define RX_LED_ON()   ((PORTC |=  (1<<PORTC3)))
 #define RX_LED_OFF()  ((PORTC &= ~(1<<PORTC3)))
 
@@ -83,6 +129,28 @@ typedef struct {
 #define PARAM_RESET_PIN_PORT   PIND
 #define PARAM_RESET_PIN_NB     6
 
+// Print into a char array, keeping it 0 terminated. What doesn't fit is dropped.
+class StrPrint : public Print {
+  public:
+    StrPrint(char *Buff, word Size) : Pt(Buff), Last(Buff + Size - 1) { *Pt = 0; }
+#if ARDUINO >= 100
+    virtual size_t write(uint8_t c) {
+      if (Pt == Last) return 0;
+      *Pt++ = c; *Pt = 0;
+      return 1;
+    }
+#else
+    virtual void write(uint8_t c) {
+      if (Pt == Last) return;
+      *Pt++ = c; *Pt = 0;
+    }
+#endif
+    // Nothing more fits, what was written last may have been cut
+    boolean full() { return Pt == Last; }
+  private:
+    char *Pt, *Last;
+};
+
 #define DATALOGGERDEFS
 #endif
-
+
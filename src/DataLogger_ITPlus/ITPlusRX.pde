@@ -11,12 +11,18 @@
  */
 
 #include "DataloggerDefs.h"
+#include "ITPlusCRC.h"
 #include <RF12.h>
 
 extern void DebugPrint_P(const char *);
 extern void DebugPrintln_P(const char *);
 
 extern byte SignalError;
+extern void SensorTimerInit();
+extern void SensorTimerSet(byte Timer, byte Minutes);
+extern byte SensorTimerLeft(byte Timer);
+extern void SensorTimerTick(void (*Expired)(byte Timer));
+extern void PrintRecord(Print &Out, byte Stream, byte Negative, byte Whole, byte Fract, byte *Records);
 byte CheckITPlusRegistration(byte, byte, byte);
 
 Type_Discovered DiscoveredITPlus[ITPLUS_MAX_DISCOVER];
@@ -25,6 +31,9 @@ Type_Discovered DiscoveredITPlus[ITPLUS_MAX_DISCOVER];
 
 Type_Channel ITPlusChannels[ITPLUS_MAX_SENSORS];
 
+// Registered channels whose receive timer is 0, for the error LED
+byte StalledSensors;
+
 /* Initialization of this module */
 /* ----------------------------- */
 void ITPlusRXSetup() {
@@ -34,48 +43,44 @@ void ITPlusRXSetup() {
     ITPlusChannels[i].LastReceiveTimer = 0;
   for (byte i = 0; i < ITPLUS_MAX_DISCOVER; i++)
     DiscoveredITPlus[i].SensorID = 0xff;
+  SensorTimerInit();
+  CountStalledSensors();
 }
 
-#define CRC_POLY 0x31
-boolean CheckITPlusCRC(byte *msge, byte nbBytes) {
-  byte reg = 0;
-  short int i;
-  byte curByte, curbit, bitmask;
-    byte do_xor;
-  
-  while (nbBytes-- != 0) {
-    curByte = *msge++; bitmask = 0b10000000;
-    while (bitmask != 0) {
-      curbit = ((curByte & bitmask) == 0) ? 0 : 1;
-      bitmask >>= 1;
-#ifdef DEBUG_CRC
-    Serial.print("byte ");printHex(curByte);
-#endif
-    do_xor = (reg & 0x80);
+// To be called whenever sensors are registered or removed
+void CountStalledSensors() {
+  StalledSensors = 0;
+  for (byte Channel = 0; Channel < ITPLUS_MAX_SENSORS; Channel++) {
+    if (ITPlusChannels[Channel].SensorID != 0xff && ITPlusChannels[Channel].LastReceiveTimer == 0)
+      StalledSensors++;
+  }
+}
 
-    reg <<=1;
-    reg |= curbit;
-#ifdef DEBUG_CRC
-    Serial.print(" b=");Serial.print(curbit, DEC);Serial.print(" ");
-#endif
+// Receive timeouts are kept in SensorTimer.pde, LastReceiveTimer is only cleared here when the timer expires
+static void SensorTimerExpired(byte Timer) {
+  if (Timer < ITPLUS_MAX_SENSORS) {
+    ITPlusChannels[Timer].LastReceiveTimer = 0;
+    if (ITPlusChannels[Timer].SensorID != 0xff)
+      StalledSensors++;
+  } else {
+    DiscoveredITPlus[Timer - ITPLUS_MAX_SENSORS].LastReceiveTimer = 0;
+  }
+}
 
-    if (do_xor)
-    {
-#ifdef DEBUG_CRC
-    Serial.print(" Xoring ");printHex(reg);
-#endif
-        reg ^= CRC_POLY;
-#ifdef DEBUG_CRC
-    Serial.print(" > ");printHex(reg);
-#endif
-    }
+// To be called once a minute
+void ITPlusMinuteTick() {
+  SensorTimerTick(SensorTimerExpired);
+}
+
+// Frame is valid when the CRC over all its bytes, CRC byte included, is 0.
+// The implementation used is selected by ITPLUS_CRC_IMPL in DataloggerDefs.h
+boolean CheckITPlusCRC(byte *msge, byte nbBytes) {
+  byte reg = ITPlusCRC8<ITPLUS_CRC_IMPL>(msge, nbBytes, 0);
 
 #ifdef DEBUG_CRC
-    Serial.print(" reg ");printHex(reg);
-    Serial.println();
+  Serial.print("CRC reg ");printHex(reg);
+  Serial.println();
 #endif
-    }
-  }
   return (reg == 0);
 }
 
@@ -178,7 +183,10 @@ byte CheckITPlusRegistration(byte id, byte Temp, byte DeciTemp) {
   for (i = 0; i < ITPLUS_MAX_SENSORS; i++) {
     if (ITPlusChannels[i].SensorID == (id & ITPLUS_ID_MASK)) {  // Do the search without reset flag
       // OK Found, reset receive timer & return channel = index
+      if (ITPlusChannels[i].LastReceiveTimer == 0)
+        StalledSensors--;
       ITPlusChannels[i].LastReceiveTimer = SENSORS_RX_TIMEOUT;
+      SensorTimerSet(CHANNEL_TIMER(i), SENSORS_RX_TIMEOUT);
       return i;
     }
   }
@@ -188,6 +196,7 @@ byte CheckITPlusRegistration(byte id, byte Temp, byte DeciTemp) {
     if ((DiscoveredITPlus[i].SensorID & ITPLUS_ID_MASK) == (id & ITPLUS_ID_MASK)) {
       // Found! Update the last receive timer
       DiscoveredITPlus[i].LastReceiveTimer = ITPLUS_DISCOVERY_PERIOD;
+      SensorTimerSet(DISCOVERED_TIMER(i), ITPLUS_DISCOVERY_PERIOD);
       DiscoveredITPlus[i].Temp = Temp;
       DiscoveredITPlus[i].DeciTemp = DeciTemp;
       
@@ -201,6 +210,7 @@ byte CheckITPlusRegistration(byte id, byte Temp, byte DeciTemp) {
     if (DiscoveredITPlus[i].SensorID == 0xff) {
       DiscoveredITPlus[i].SensorID = id;
       DiscoveredITPlus[i].LastReceiveTimer = ITPLUS_DISCOVERY_PERIOD;
+      SensorTimerSet(DISCOVERED_TIMER(i), ITPLUS_DISCOVERY_PERIOD);
       DiscoveredITPlus[i].Temp = Temp;
       DiscoveredITPlus[i].DeciTemp = DeciTemp;
       return 0xff;
@@ -210,16 +220,29 @@ byte CheckITPlusRegistration(byte id, byte Temp, byte DeciTemp) {
   // No free slot found. Use the one with oldest receiving time.
   MaxTime = ITPLUS_DISCOVERY_PERIOD;
   FreeIndex = 0;
-  for (i = 0; i < ITPLUS_DISCOVERY_PERIOD; i++) {
-    if (DiscoveredITPlus[i].LastReceiveTimer < MaxTime) {
-      MaxTime = DiscoveredITPlus[i].LastReceiveTimer;
+  for (i = 0; i < ITPLUS_MAX_DISCOVER; i++) {
+    if (SensorTimerLeft(DISCOVERED_TIMER(i)) < MaxTime) {
+      MaxTime = SensorTimerLeft(DISCOVERED_TIMER(i));
       FreeIndex = i;
     }
   }
   DiscoveredITPlus[FreeIndex].SensorID = id;
   DiscoveredITPlus[FreeIndex].LastReceiveTimer = ITPLUS_DISCOVERY_PERIOD;
+  SensorTimerSet(DISCOVERED_TIMER(FreeIndex), ITPLUS_DISCOVERY_PERIOD);
   DiscoveredITPlus[FreeIndex].Temp = Temp;
   DiscoveredITPlus[FreeIndex].DeciTemp = DeciTemp;
   return 0xff;
 }
 
+// Write the report records of the registered channels we have a valid temperature for, see PrintRecord()
+// DataStream 1 to ITPLUS_MAX_SENSORS are IT+ Sensors
+void PrintITPlusRecords(Print &Out, byte *Records) {
+  for (byte Channel = 0; Channel < ITPLUS_MAX_SENSORS; Channel++) {
+    if (ITPlusChannels[Channel].SensorID != 0xff) {  // Send only if registered
+      if (ITPlusChannels[Channel].LastReceiveTimer != 0) {  // Send only if valid temp received
+        PrintRecord(Out, Channel + 1, ITPlusChannels[Channel].Temp & 0x80, ITPlusChannels[Channel].Temp & 0x7f,
+                    ITPlusChannels[Channel].DeciTemp, Records);
+      }
+    }
+  }
+}
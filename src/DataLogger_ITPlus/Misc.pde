@@ -8,6 +8,7 @@
  */
 
 #include <avr/eeprom.h>
+#include "ConfigLayout.h"
 
 // Nb of milliseconds in day, hour, min, sec
 #define DAY     86400000
@@ -63,40 +64,36 @@ Type_Config Config;  // Holds all configuration parameters
 // The default configuration values NodeIP, Gateway, serverIP, WebSendPeriod
 Type_Config DefaultConfig PROGMEM = {{ 192,168,1,5 }, { 192,168,1,1 }, {0,0,0,0}, 15};
 
-// The same into the EEPROM
-Type_Config CONFIG_STRUCT_EEPROM EEMEM;
-
 // Some configuration parameters are too long to be copied into RAM, they will be maintained only into EEPROM
-char SRV_HOST_EEPROM[30] EEMEM;
-char SRV_URL_EEPROM[50] EEMEM;
-char SRV_HDR_EEPROM[90] EEMEM;
-/**** Next one MUST BE THE LAST! ****/
-byte CONFIG_CKS_EEPROM EEMEM;
-
-// Initial Checksum "seed". To be set to something <> 0 as a blank EEPROM will has all 0. For each change in EEPROM
-// structure, change this to invalidate content and force re-init.
-#define CKS_INIT_SEED  33
+// at fixed addresses, as the EtherCard code reads them from there.
+char SRV_HOST_EEPROM[CONFIG_HOST_LEN] EEMEM;
+char SRV_URL_EEPROM[CONFIG_URL_LEN] EEMEM;
+char SRV_HDR_EEPROM[CONFIG_HDR_LEN] EEMEM;
+
+// The config struct is saved into a journal of records, see ConfigLayout.h.  The records also hold the CRC
+// of the strings, so a boot reads the newest record and the strings up to their terminator, not the whole
+// EEPROM.  7 slots of 24 bytes and the strings take 338 bytes, below the WebQueue.pde ring at 352.
+// The EEMEM variables are laid out from address 0 in the order they are defined.  A configuration of the
+// former layout, the config struct in front, is moved to this one at the first boot.  CONFIG_EEPROM_END()
+// of ConfigLayout.h gives the end of these variables.
+byte CONFIG_JOURNAL_EEPROM[CONFIG_SLOTS * CONFIG_SLOT_LEN(sizeof(Type_ConfigRecord))] EEMEM;
+
+// CRC "seed". For each change in EEPROM structure, change this to invalidate content and force re-init.
+#define CONFIG_SEED  0x3321
+
+static ConfigLayout ConfigEeprom = {
+  { CONFIG_JOURNAL_EEPROM, CONFIG_SLOTS, sizeof(Type_ConfigRecord), CONFIG_SEED },
+  (word)(uintptr_t)SRV_HOST_EEPROM, { sizeof(SRV_HOST_EEPROM), sizeof(SRV_URL_EEPROM), sizeof(SRV_HDR_EEPROM) }
+};
 
 extern Type_Channel ITPlusChannels[];  // Live table of IT+ Sensors
 
-// Compute all configuration parameters CKS and write it into EEP
-static void WriteEEPCKS() {
-  byte CKS;
-
-  CKS = CKS_INIT_SEED;
-  for (int i = 0; i < (int)&CONFIG_CKS_EEPROM; i++)
-    CKS += eeprom_read_byte((byte *)i);
-  eeprom_write_byte(&CONFIG_CKS_EEPROM, CKS);
-}
-
-// Writes the configuration parameters stored in config struct into EEPROM & Update CKS
+// Saves the config struct & the CRC of the strings into EEPROM, if they changed since last save
 static void SaveConfig() {
-  byte *ptConfig, *ptEEPROM;
-  ptConfig = (byte *) &Config;
-  ptEEPROM = (byte *) &CONFIG_STRUCT_EEPROM;
-  for (byte i = 0; i < sizeof(Config); i++) eeprom_write_byte(ptEEPROM++, *ptConfig++);
-  // Update CKS into EEP
-  WriteEEPCKS();
+  Type_ConfigRecord Record;
+
+  Record.Config = Config;
+  ConfigSave(&ConfigEeprom, &Record);
 }
 
 // Resets configuration parameters stored in config struct to default and other strings to null
@@ -109,17 +106,15 @@ static void ResetConfig() {
     ITPlusChannels[i].SensorID = Config.ITPlusID[i] = 0xff;  // Initialize also live IT+ table
 
   // Init other stings to null
-  eeprom_write_byte((byte *)&SRV_HOST_EEPROM[0], 0);
-  eeprom_write_byte((byte *)&SRV_URL_EEPROM[0], 0);
-  eeprom_write_byte((byte *)&SRV_HDR_EEPROM[0], 0);
+  ConfigClearStrings(&ConfigEeprom);
   
-  // Write config struct to EEP, this will also compute and update CKS on all saved parameters
+  // Write config struct to EEP, along with the CRC of the strings
   SaveConfig();
 }
 
 // Initial loading of configuration parameters from EEPROM
 static void LoadConfig() {
-  byte CKS;
+  Type_ConfigRecord Record;
 
   // Set pull-up on pin used to reset config in order to check correctly
   // On POR, all DDR = 0 ==> pin = input, but no pull-up beacause:
@@ -127,19 +122,14 @@ static void LoadConfig() {
   PARAM_RESET_DATA_PORT |= (1 << PARAM_RESET_PIN_NB);
 
 //  DebugPrint_P(PSTR("Load Config "));
-  // First check if EEPROM has valid data
-  CKS = CKS_INIT_SEED;
-  for (int i = 0; i < (int)&CONFIG_CKS_EEPROM; i++)
-    CKS += eeprom_read_byte((byte *) i);
-
-  // If invalid CKS, initialize all parameters in EEPROM
-  if (CKS != eeprom_read_byte(&CONFIG_CKS_EEPROM)) {
-//    DebugPrintln_P(PSTR("CKS KO"));
+  // If no valid record, initialize all parameters in EEPROM.  Strings failing their CRC are cleared.
+  if (ConfigLoad(&ConfigEeprom, &Record) == CONFIG_NONE) {
+//    DebugPrintln_P(PSTR("CRC KO"));
 
     // Copy initial values to config struct
     ResetConfig();
-  } else {  // Checksum OK, Load the valid config if not reset requested
-//    DebugPrintln_P(PSTR("CKS OK"));
+  } else {  // CRC OK, Load the valid config if not reset requested
+//    DebugPrintln_P(PSTR("CRC OK"));
     
     // Check if a HARD RESET config is requested (PARAM_RESET_PIN grounded to low)
     if ((PARAM_RESET_PIN_PORT & (1 << PARAM_RESET_PIN_NB)) == 0) {
@@ -158,11 +148,8 @@ static void LoadConfig() {
       }
     }
     
-    // Otherwise, load config structure from EEPROM
-    byte *ptConfig, *ptEEPROM;
-    ptConfig = (byte *) &Config;
-    ptEEPROM = (byte *) &CONFIG_STRUCT_EEPROM;
-    for (byte i = 0; i < sizeof(Config); i++) *ptConfig++ = eeprom_read_byte(ptEEPROM++);
+    // Otherwise, load config structure from the record
+    Config = Record.Config;
 
     // Load registered IT+ sensors IDs
     for (byte i = 0; i < ITPLUS_MAX_SENSORS; i++)
@@ -170,4 +157,4 @@ static void LoadConfig() {
   }
 }
 
-
+
@@ -17,6 +17,7 @@
 #include <Ports.h>
 #include <RF12.h>
 #include "dnslkup.h"
+#include "net.h"
 
 /********************/
 /* IMPORTANT NOTICE */
@@ -31,6 +32,9 @@
 // Those variables are copied into internal buffers using fill_tcp_data_p.
 // We had to change the call to fill_tcp_data_p by a call to fill_tcp_data_e and implement fill_tcp_data_e
 // A #define USE_EEP_INSTEADOF_FLASH placed into ip_arp_udp_tcp.cpp is driving the change.
+//
+// Pages sent over several packets (see PageStream.pde) also call make_tcp_ack_from_any and
+// make_tcp_ack_with_data_noflags from ip_arp_udp_tcp.cpp directly, as www_server_reply does for one packet.
 
 // IP @ settings
 // The beginning of address is hardcoded to 192.168 and cannot be changed
@@ -46,15 +50,21 @@ extern Type_Channel ITPlusChannels[];
 extern Type_Discovered DiscoveredITPlus[];
 extern Type_Config Config;
 extern void SaveConfig();
+extern void CountStalledSensors();
+extern byte SensorTimerLeft(byte Timer);
 
-extern Type_Config CONFIG_STRUCT_EEPROM EEMEM;
 extern char SRV_HOST_EEPROM[] EEMEM;
 extern char SRV_URL_EEPROM[] EEMEM;
 extern char SRV_HDR_EEPROM[] EEMEM;
-extern byte CONFIG_CKS_EEPROM EEMEM;
 extern byte justSent;
 extern byte boxRebootCount;
 extern boolean plugTestRequest;
+extern boolean WebDrain;
+extern boolean WebQueueSent();
+extern void WebQueueAnswer(const char *Answer, word Len);
+extern byte WebQueueCount();
+extern word WebQueueDropped;
+extern void StreamPage(PageGenerator Gen, word ReqLen);
 
 // ethernet interface mac address - must be unique on your network
 byte mymac[6] = { 0x54,0x55,0x58,0x10,0x00,0x26 };  // Not configurable
@@ -72,7 +82,7 @@ word SentCount;
 // TCP PORT for send / receive NOT configurable via WEB interface
 #define HTTP_PORT 80
 
-byte buf[800];      // tcp/ip send and receive buffer
+byte buf[ETH_BUFFER_LEN];  // tcp/ip send and receive buffer
 static BufferFiller bfill;  // used as cursor while filling the buffer
 
 word LastServerSendOK;
@@ -124,6 +134,7 @@ void NetworkInitialize() {
  * 
  * Home   /
  * Status /s
+ * Status as JSON /J
  * Config /c
  *  Sensors /d [IT+ Sensors registering page]
  *   Remove  /k [Remove a sensor from registered table]
@@ -149,6 +160,10 @@ static char okHeader[] PROGMEM =
     "HTTP/1.0 200 OK\r\n"
     "Content-Type: text/html\r\n"
     "Pragma: no-cache\r\n";
+static char jsonHeader[] PROGMEM = 
+    "HTTP/1.0 200 OK\r\n"
+    "Content-Type: application/json\r\n"
+    "Pragma: no-cache\r\n";
 static char redirHeader[] PROGMEM = 
     "HTTP/1.0 302 found\r\nLocation: ";
 static char BreakAndCRLF[] PROGMEM = "<br/>\r\n";
@@ -162,9 +177,12 @@ static void homePage(BufferFiller& buf) {
     "<a href='s'>Status</a><br/><a href='c'>Configure</a>"), okHeader);
 }
 
+// Registered channels per part of the pages listing them
+#define CHANNELS_PER_PART  8
+
 // STATUS
 // ------
-static void StatusPage(BufferFiller& buf) {
+static void StatusHead(BufferFiller& buf) {
   buf.emit_p(PSTR("$F\r\n"
     "<meta http-equiv='refresh' content='$D'/>"
     "<title>Status</title>" 
@@ -204,6 +222,9 @@ static void StatusPage(BufferFiller& buf) {
   } else
     buf.emit_p(PSTR("None"));
   
+  // Print reports waiting for the server
+  buf.emit_p(PSTR("<br/>Queued: $D ($D dropped)"), WebQueueCount(), WebQueueDropped);
+
   // Print number of ADSL Box reboot
   buf.emit_p(PSTR("<br/>Box Reboot: "));
   buf.emit_p(PSTR("$D"), boxRebootCount);
@@ -216,8 +237,17 @@ static void StatusPage(BufferFiller& buf) {
 
   // Print IT+ sensors temps
   buf.emit_p(PSTR("<H3>Sensors</H3>"));
+}
 
-  for (byte Channel = 0; Channel < ITPLUS_MAX_SENSORS; Channel++) {
+// Head, then CHANNELS_PER_PART channels per part
+static boolean StatusPage(BufferFiller& buf, byte Part) {
+  if (Part == 0) {
+    StatusHead(buf);
+    return true;
+  }
+
+  for (byte Channel = (Part - 1) * CHANNELS_PER_PART;
+       Channel < ITPLUS_MAX_SENSORS && Channel < Part * CHANNELS_PER_PART; Channel++) {
     if (Channel != 0) buf.emit_p(PSTR("<br/>"));
     buf.emit_p(PSTR("Ch$D: "), Channel + 1);
     if (ITPlusChannels[Channel].SensorID != 0xff) {
@@ -231,6 +261,65 @@ static void StatusPage(BufferFiller& buf) {
     } else
       buf.emit_p(PSTR("Not Reg"));
   }
+  return Part * CHANNELS_PER_PART < ITPLUS_MAX_SENSORS;
+}
+
+// STATUS AS JSON
+// --------------
+// For pollers: {"uptime":<mn>,"posts":<POST OK>,"lastPost":<mn ago or null>,"queued":<reports>,"dropped":<reports>,
+// "reboots":<box reboots>,"temp":<DS1820>,"sensors":[{"ch":1,"id":<id or null>,"temp":<temp or null>},...]}
+// $D prints an int, words past 32767 would come out negative
+static void JsonWord(BufferFiller& buf, word Value) {
+  char Str[6];
+
+  utoa(Value, Str, 10);
+  buf.emit_raw(Str, strlen(Str));
+}
+
+static void JsonTemp(BufferFiller& buf, byte Temp, byte DeciTemp) {
+  if (Temp & 0x80)
+    buf.emit_raw("-", 1);
+  buf.emit_p(PSTR("$D.$D"), Temp & 0x7f, DeciTemp);
+}
+
+static boolean JsonStatusPage(BufferFiller& buf, byte Part) {
+  if (Part == 0) {
+    buf.emit_p(PSTR("$F\r\n{\"uptime\":"), jsonHeader);
+    JsonWord(buf, Minutes);
+    buf.emit_p(PSTR(",\"posts\":"));
+    JsonWord(buf, SentCount);
+    buf.emit_p(PSTR(",\"lastPost\":"));
+    if (SentCount != 0)
+      JsonWord(buf, Minutes - LastServerSendOK);
+    else
+      buf.emit_p(PSTR("null"));
+    buf.emit_p(PSTR(",\"queued\":$D,\"dropped\":"), WebQueueCount());
+    JsonWord(buf, WebQueueDropped);
+    buf.emit_p(PSTR(",\"reboots\":$D,\"temp\":"), boxRebootCount);
+    JsonTemp(buf, (CentralTempSignBit ? 0x80 : 0) | CentralTempWhole, CentralTempFract);
+    buf.emit_p(PSTR(",\"sensors\":["));
+    return true;
+  }
+
+  for (byte Channel = (Part - 1) * CHANNELS_PER_PART;
+       Channel < ITPLUS_MAX_SENSORS && Channel < Part * CHANNELS_PER_PART; Channel++) {
+    if (Channel != 0) buf.emit_raw(",", 1);
+    buf.emit_p(PSTR("{\"ch\":$D,\"id\":"), Channel + 1);
+    if (ITPlusChannels[Channel].SensorID != 0xff)
+      buf.emit_p(PSTR("$D"), ITPlusChannels[Channel].SensorID);
+    else
+      buf.emit_p(PSTR("null"));
+    buf.emit_p(PSTR(",\"temp\":"));
+    if (ITPlusChannels[Channel].SensorID != 0xff && ITPlusChannels[Channel].LastReceiveTimer != 0)
+      JsonTemp(buf, ITPlusChannels[Channel].Temp, ITPlusChannels[Channel].DeciTemp);
+    else
+      buf.emit_p(PSTR("null"));
+    buf.emit_raw("}", 1);
+  }
+  if (Part * CHANNELS_PER_PART < ITPLUS_MAX_SENSORS)
+    return true;
+  buf.emit_p(PSTR("]}"));
+  return false;
 }
 
 // Global configuration
@@ -291,6 +380,7 @@ static void ProcessRemoveSensor(const char* data, BufferFiller& buf) {
     
     // Unregister the channel
     ITPlusChannels[ChannelIndex].SensorID = 0xff;
+    CountStalledSensors();
 
     // Write back into config and then to EEP
     Config.ITPlusID[ChannelIndex] = 0xff;
@@ -307,6 +397,7 @@ static void ProcessCancelLastRemove(BufferFiller& buf) {
   if (LastRemovedSensorID != 0xff) {
     // Re-enable last removed sensor
     ITPlusChannels[LastRemovedSensorIndex].SensorID = LastRemovedSensorID;
+    CountStalledSensors();
     
     // Write back into config and then to EEP
     Config.ITPlusID[LastRemovedSensorIndex] = LastRemovedSensorID;
@@ -334,36 +425,32 @@ static void ProcessCancelLastRemove(BufferFiller& buf) {
 // ---------------------------------
 // This page displays senors that can be registered: received & not yet registered
 // To help indentify them, temperature is also shown if refreshed within the last 10 mn.
-static void SensorsAddPage(BufferFiller& buf) {
-  char bufStr[5], *ptBuff, c;
-  
-  buf.emit_p(PSTR("$F\r\n<title>Config</title>"
-    "<a href='/'>Home</a>"
-    "<h1>Sensors Add</h1>"
-    "IDs With RESET<br/>"), okHeader);
-
-  // Display sensors still in reset state
-  for (byte i = 0; i < ITPLUS_MAX_DISCOVER; i++) {
-    if ((DiscoveredITPlus[i].SensorID != 0xff) && ((DiscoveredITPlus[i].SensorID & ~ITPLUS_ID_MASK)) != 0) {
-
-      buf.emit_p(PSTR("$D "), DiscoveredITPlus[i].SensorID & ITPLUS_ID_MASK);
-      if (DiscoveredITPlus[i].LastReceiveTimer > ITPLUS_DISCOVERY_PERIOD - 10) {
-        if (DiscoveredITPlus[i].Temp & 0x80)
-          buf.write('-');
-        buf.emit_p(PSTR("($D.$D&deg;)"), DiscoveredITPlus[i].Temp & 0x7f, DiscoveredITPlus[i].DeciTemp);
-      } else {
-        buf.emit_p(PSTR("NoRX"));
-      }
-      buf.emit_p(PSTR("<br/>"));
-    }
+// Discovered sensors per part, listed twice: those still in reset state, then the others
+#define DISCOVERED_PARTS  ((ITPLUS_MAX_DISCOVER + CHANNELS_PER_PART - 1) / CHANNELS_PER_PART)
+
+static boolean SensorsAddPage(BufferFiller& buf, byte Part) {
+  boolean Reset;
+  byte First;
+
+  if (Part == 0) {
+    buf.emit_p(PSTR("$F\r\n<title>Config</title>"
+      "<a href='/'>Home</a>"
+      "<h1>Sensors Add</h1>"
+      "IDs With RESET<br/>"), okHeader);
+    return true;
   }
 
-  // Display sensors in normal state
-  buf.emit_p(PSTR("Normal IDs<br/>"));
-  for (byte i = 0; i < ITPLUS_MAX_DISCOVER; i++) {
-    if ((DiscoveredITPlus[i].SensorID != 0xff) && ((DiscoveredITPlus[i].SensorID & ~ITPLUS_ID_MASK)) == 0) {
+  Part--;
+  if (Part < 2 * DISCOVERED_PARTS) {
+    Reset = Part < DISCOVERED_PARTS;
+    First = (Part % DISCOVERED_PARTS) * CHANNELS_PER_PART;
+    if (Part == DISCOVERED_PARTS)
+      buf.emit_p(PSTR("Normal IDs<br/>"));
+    for (byte i = First; i < ITPLUS_MAX_DISCOVER && i < First + CHANNELS_PER_PART; i++) {
+      if (DiscoveredITPlus[i].SensorID == 0xff || ((DiscoveredITPlus[i].SensorID & ~ITPLUS_ID_MASK) != 0) != Reset)
+        continue;
       buf.emit_p(PSTR("$D "), DiscoveredITPlus[i].SensorID & ITPLUS_ID_MASK);
-      if (DiscoveredITPlus[i].LastReceiveTimer > ITPLUS_DISCOVERY_PERIOD - 10) {
+      if (SensorTimerLeft(DISCOVERED_TIMER(i)) > ITPLUS_DISCOVERY_PERIOD - 10) {
         if (DiscoveredITPlus[i].Temp & 0x80)
           buf.write('-');
         buf.emit_p(PSTR("($D.$D&deg;)"), DiscoveredITPlus[i].Temp & 0x7f, DiscoveredITPlus[i].DeciTemp);
@@ -372,6 +459,7 @@ static void SensorsAddPage(BufferFiller& buf) {
       }
       buf.emit_p(PSTR("<br/>"));
     }
+    return true;
   }
 
   buf.emit_p(PSTR("<form action=\"r\">"
@@ -379,6 +467,7 @@ static void SensorsAddPage(BufferFiller& buf) {
     "<input type=submit value=\"Add\"></form>"));
   buf.emit_p(PSTR("<a href='/C'>Clear List</a>$F"), BreakAndCRLF);
   buf.emit_p(PSTR("<input type=button value=\"Cancel\" onclick=\"location.replace('/d');\">"));
+  return false;
 }
 
 // Processing functions & data for sensors add page
@@ -422,6 +511,7 @@ static void ProcessRegisterIPPlusSensor(const char* data, BufferFiller& buf) {
   
   // All check OK: register the sensor
   ITPlusChannels[channel - 1].SensorID = sensorID;
+  CountStalledSensors();
   // Sensor should not be anymore in discovery table
   DiscoveredITPlus[i].SensorID = 0xff;
 
@@ -636,14 +726,14 @@ static void ProcessSetHostName(char* data, BufferFiller& buf) {
     // Decode
     urldecode(data + 6 + 3);
 
-    // Write the string into EEPROM
+    // Write the string into EEPROM, changed bytes only
     for (i = 0, pt = data + 6 + 3; *pt != 0 && i < sizeof(SRV_HOST_EEPROM) - 1; i++, pt++)
-      eeprom_write_byte((byte *)&SRV_HOST_EEPROM[i], (byte)*pt);
+      ConfigUpdateByte((byte *)&SRV_HOST_EEPROM[i], (byte)*pt);
     
     // Write terminating 0, string truncated to sizef() if too long
-    eeprom_write_byte((byte *)&SRV_HOST_EEPROM[i], 0);
-    // Update CKS into EEP
-    WriteEEPCKS();
+    ConfigUpdateByte((byte *)&SRV_HOST_EEPROM[i], 0);
+    // Save the CRC of the new string
+    SaveConfig();
 
     // Initiate DNS lookup for new host if needed
     if (Config.ServerIP[0] == 0) {
@@ -705,14 +795,14 @@ static void ProcessSetURL(char* data, BufferFiller& buf) {
     // Decode
     urldecode(data + 6 + 3);
 
-    // Write the string into EEPROM
+    // Write the string into EEPROM, changed bytes only
     for (i = 0, pt = data + 6 + 3; *pt != 0 && i < sizeof(SRV_URL_EEPROM) - 1; i++, pt++)
-      eeprom_write_byte((byte *)&SRV_URL_EEPROM[i], (byte)*pt);
+      ConfigUpdateByte((byte *)&SRV_URL_EEPROM[i], (byte)*pt);
     
     // Write terminating 0, string truncated to sizef() if too long
-    eeprom_write_byte((byte *)&SRV_URL_EEPROM[i], 0);
-    // Update CKS into EEP
-    WriteEEPCKS();
+    ConfigUpdateByte((byte *)&SRV_URL_EEPROM[i], 0);
+    // Save the CRC of the new string
+    SaveConfig();
   
     // Redirect to server config page when done. This will display updated data  
     buf.emit_p(PSTR("$F/a\r\n\r\n"), redirHeader);
@@ -735,14 +825,14 @@ static void ProcessSetExtraHeader(char* data, BufferFiller& buf) {
     // Decode
     urldecode(data + 6 + 3);
 
-    // Write the string into EEPROM
+    // Write the string into EEPROM, changed bytes only
     for (i = 0, pt = data + 6 + 3; *pt != 0 && i < sizeof(SRV_HDR_EEPROM) - 1; i++, pt++)
-      eeprom_write_byte((byte *)&SRV_HDR_EEPROM[i], (byte)*pt);
+      ConfigUpdateByte((byte *)&SRV_HDR_EEPROM[i], (byte)*pt);
     
     // Write terminating 0, string truncated to sizef() if too long
-    eeprom_write_byte((byte *)&SRV_HDR_EEPROM[i], 0);
-    // Update CKS into EEP
-    WriteEEPCKS();
+    ConfigUpdateByte((byte *)&SRV_HDR_EEPROM[i], 0);
+    // Save the CRC of the new string
+    SaveConfig();
   
     // Redirect to server config page when done. This will display updated data  
     buf.emit_p(PSTR("$F/a\r\n\r\n"), redirHeader);
@@ -852,18 +942,22 @@ if (enc28j60linkup()) {
 #if DEBUG_ETH
         Serial.println(data);
 #endif
+        // Request length, to be acknowledged by the pages streamed over several packets
+        word ReqLen = (((word)buf[IP_TOTLEN_H_P] << 8) | buf[IP_TOTLEN_L_P]) + ETH_HEADER_LEN - pos;
+
         // Check if we have a valid "GET /"
         if (strncmp("GET /", data, 5) == 0) {
           switch (data[5]) {  // Command dispatcher
             case ' ' : homePage(bfill); break;
-            case 's' : StatusPage(bfill); break;
+            case 's' : StreamPage(StatusPage, ReqLen); return;
+            case 'J' : StreamPage(JsonStatusPage, ReqLen); return;
             case 'c' : ConfigPage(bfill); break;
 
             case 'd' : SensorsConfigPage(bfill); break;
             case 'k' : ProcessRemoveSensor(data, bfill); break;
             case 'z' : ProcessCancelLastRemove(bfill); break;
 
-            case 'j' : SensorsAddPage(bfill); break;
+            case 'j' : StreamPage(SensorsAddPage, ReqLen); return;
             case 'r' : ProcessRegisterIPPlusSensor(data, bfill); break;
             case 'C' : ClearDiscoveryTable(bfill); break;
 
@@ -932,10 +1026,14 @@ void browserresult_callback(uint8_t statuscode, uint16_t datapos, uint16_t len)
   // Retry mechanism is there to cope with transmission errors (mostly WEB time-outs), not negative answers,
   // so any type of response mean communication is OK.
   justSent = 0;
+  if (statuscode != 2)
+    WebQueueAnswer((char *)&buf[datapos], len);
   switch (statuscode) {
     case 0:
       LastServerSendOK = Minutes;  // For Status Page & Error Signaling
       SentCount++;
+      // The reports got there, send the next ones if any
+      WebDrain = WebQueueSent();
       break;
 
     case 1:
@@ -0,0 +1,107 @@
+/**
+ * Temperature data logger.
+ *
+ * Pages sent over several packets, for the ones that don't fit in buf: the
+ * parts of a PageGenerator (see DataloggerDefs.h) are sent one packet at a
+ * time, each waiting for the ACK of the browser.
+ */
+
+#include "DataloggerDefs.h"
+#include <EtherCard.h>
+#include "net.h"
+
+extern byte buf[ETH_BUFFER_LEN];
+extern EtherCard eth;
+extern void make_tcp_ack_from_any(uint8_t *buf, int16_t datlentoack, uint8_t addflags);
+extern void make_tcp_ack_with_data_noflags(uint8_t *buf, uint16_t dlen);
+
+#define STREAM_ACK_MS   300  // Wait for the ACK of a part, browsers may delay theirs by 200 ms
+#define STREAM_TRIES    3    // Sends of a part before giving up on the page
+
+#define STREAM_ACKED    0
+#define STREAM_TIMEOUT  1
+#define STREAM_RESET    2
+
+static unsigned long GetSeq(const byte *Pt) {
+  return (unsigned long)Pt[0] << 24 | (unsigned long)Pt[1] << 16 | (word)Pt[2] << 8 | Pt[3];
+}
+
+static void PutSeq(byte *Pt, unsigned long Seq) {
+  for (byte i = 4; i != 0; i--, Seq >>= 8)
+    Pt[i - 1] = Seq & 0xff;
+}
+
+/*
+ * Wait for the browser to acknowledge the reply whose headers are in Hdr up
+ * to sequence number End.  Other packets received meanwhile are dropped,
+ * the browser resending them.
+ */
+static byte StreamWaitAck(const byte *Hdr, unsigned long End) {
+  unsigned long Start = millis();
+  word len;
+
+  while (millis() - Start < STREAM_ACK_MS) {
+    len = eth.packetReceive(buf, sizeof(buf));
+    // A TCP segment from the browser on this connection, addresses and ports of Hdr being swapped
+    if (len < TCP_OPTIONS_P || buf[ETH_TYPE_H_P] != ETH_TYPE_IP_H_V || buf[ETH_TYPE_L_P] != ETH_TYPE_IP_L_V ||
+        buf[IP_PROTO_P] != IP_PROTO_TCP_V || memcmp(&buf[IP_SRC_P], &Hdr[IP_DST_P], 4) != 0 ||
+        memcmp(&buf[TCP_SRC_PORT_H_P], &Hdr[TCP_DST_PORT_H_P], 2) != 0 ||
+        memcmp(&buf[TCP_DST_PORT_H_P], &Hdr[TCP_SRC_PORT_H_P], 2) != 0)
+      continue;
+    if (buf[TCP_FLAGS_P] & TCP_FLAGS_RST_V)
+      return STREAM_RESET;
+    if ((buf[TCP_FLAGS_P] & TCP_FLAGS_ACK_V) && (long)(GetSeq(&buf[TCP_SEQACK_H_P]) - End) >= 0)
+      return STREAM_ACKED;
+  }
+  return STREAM_TIMEOUT;
+}
+
+/*
+ * Send a page written by a generator, one packet per part, in answer to the
+ * request of ReqLen bytes in buf.  Each part waits for its ACK and is sent
+ * again, up to STREAM_TRIES times, if none came within STREAM_ACK_MS.  An
+ * empty part but the last is skipped, a segment without data nor FIN not
+ * being acknowledged.  As
+ * loop() does not run meanwhile, a part written again is the same but for
+ * the seconds of the uptime.  The page is cut if the browser resets the
+ * connection or a part is never acknowledged, the worst case blocking
+ * loop() for parts x STREAM_TRIES x STREAM_ACK_MS.
+ */
+void StreamPage(PageGenerator Gen, word ReqLen) {
+  byte Hdr[TCP_OPTIONS_P];  // Headers of the part to send, buf taking the ACKs
+  BufferFiller Fill;
+  boolean More;
+  word Len;
+  byte Result;
+
+  make_tcp_ack_from_any(buf, ReqLen, 0);
+  memcpy(Hdr, buf, sizeof(Hdr));
+  for (byte Part = 0; ; Part++) {
+    for (byte Try = 0; ; Try++) {
+      memcpy(buf, Hdr, sizeof(Hdr));
+      Fill = eth.tcpOffset(buf);
+      More = Gen(Fill, Part);
+      Len = Fill.position();
+      if (Len == 0 && More)
+        break;
+      buf[TCP_FLAGS_P] = TCP_FLAGS_ACK_V | TCP_FLAGS_PUSH_V | (More ? 0 : TCP_FLAGS_FIN_V);
+      make_tcp_ack_with_data_noflags(buf, Len);
+      Result = StreamWaitAck(Hdr, GetSeq(&Hdr[TCP_SEQ_H_P]) + Len);
+      if (Result == STREAM_ACKED)
+        break;
+      if (Result == STREAM_RESET || Try + 1 == STREAM_TRIES) {
+#if DEBUG_ETH
+        DebugPrintln_P(PSTR("Resp cut"));
+#endif
+        return;
+      }
+    }
+    if (!More)
+      break;
+    // Sequence number of the next part
+    PutSeq(&Hdr[TCP_SEQ_H_P], GetSeq(&Hdr[TCP_SEQ_H_P]) + Len);
+  }
+#if DEBUG_ETH
+  DebugPrintln_P(PSTR("Resp sent"));
+#endif
+}
@@ -0,0 +1,105 @@
+/**
+ * Temperature data logger.
+ *
+ * Sensor receive timeouts, kept in a two level timing wheel so that the
+ * per-minute housekeeping only touches the timers that actually expire.
+ *
+ * Timers are keyed on their absolute expiry minute.  Level 0 has one slot per
+ * minute of the current 16 minutes block, level 1 one slot per 16 minutes
+ * block.  When a new block starts, its level 1 slot is moved down to level 0.
+ * Timeouts can be up to 255 minutes.
+ */
+
+#include "DataloggerDefs.h"
+
+#define WHEEL_BITS  4
+#define WHEEL_SIZE  (1 << WHEEL_BITS)
+#define WHEEL_MASK  (WHEEL_SIZE - 1)
+#define NO_TIMER    0xff
+
+static word TimerNow;                       // minutes since SensorTimerInit()
+static byte TimerWheel[2 * WHEEL_SIZE];     // list heads, level 0 then level 1
+static byte TimerNext[SENSOR_TIMERS], TimerPrev[SENSOR_TIMERS];
+static byte TimerSlot[SENSOR_TIMERS];       // TimerWheel index the timer is in, or NO_TIMER
+static word TimerExpiry[SENSOR_TIMERS];
+
+void SensorTimerInit() {
+  TimerNow = 0;
+  for (byte i = 0; i < 2 * WHEEL_SIZE; i++)
+    TimerWheel[i] = NO_TIMER;
+  for (byte i = 0; i < SENSOR_TIMERS; i++)
+    TimerSlot[i] = NO_TIMER;
+}
+
+static void TimerInsert(byte Timer) {
+  byte s;
+
+  if ((TimerExpiry[Timer] >> WHEEL_BITS) == (TimerNow >> WHEEL_BITS))
+    s = TimerExpiry[Timer] & WHEEL_MASK;
+  else
+    s = WHEEL_SIZE + ((TimerExpiry[Timer] >> WHEEL_BITS) & WHEEL_MASK);
+
+  TimerSlot[Timer] = s;
+  TimerPrev[Timer] = NO_TIMER;
+  TimerNext[Timer] = TimerWheel[s];
+  if (TimerWheel[s] != NO_TIMER)
+    TimerPrev[TimerWheel[s]] = Timer;
+  TimerWheel[s] = Timer;
+}
+
+void SensorTimerCancel(byte Timer) {
+  if (TimerSlot[Timer] == NO_TIMER)
+    return;
+  if (TimerPrev[Timer] != NO_TIMER)
+    TimerNext[TimerPrev[Timer]] = TimerNext[Timer];
+  else
+    TimerWheel[TimerSlot[Timer]] = TimerNext[Timer];
+  if (TimerNext[Timer] != NO_TIMER)
+    TimerPrev[TimerNext[Timer]] = TimerPrev[Timer];
+  TimerSlot[Timer] = NO_TIMER;
+}
+
+/*
+ * (Re)start Timer to expire Minutes from now, Minutes must be 1..255
+ */
+void SensorTimerSet(byte Timer, byte Minutes) {
+  SensorTimerCancel(Timer);
+  TimerExpiry[Timer] = TimerNow + Minutes;
+  TimerInsert(Timer);
+}
+
+/*
+ * Minutes left before Timer expires, 0 if expired or never set
+ */
+byte SensorTimerLeft(byte Timer) {
+  if (TimerSlot[Timer] == NO_TIMER)
+    return 0;
+  return TimerExpiry[Timer] - TimerNow;
+}
+
+/*
+ * To be called once a minute.  Expired is called for each timer reaching 0.
+ */
+void SensorTimerTick(void (*Expired)(byte Timer)) {
+  byte Timer, NextTimer;
+
+  TimerNow++;
+
+  if ((TimerNow & WHEEL_MASK) == 0) {
+    // New block: move its timers down to level 0
+    Timer = TimerWheel[WHEEL_SIZE + ((TimerNow >> WHEEL_BITS) & WHEEL_MASK)];
+    TimerWheel[WHEEL_SIZE + ((TimerNow >> WHEEL_BITS) & WHEEL_MASK)] = NO_TIMER;
+    for (; Timer != NO_TIMER; Timer = NextTimer) {
+      NextTimer = TimerNext[Timer];
+      TimerInsert(Timer);
+    }
+  }
+
+  Timer = TimerWheel[TimerNow & WHEEL_MASK];
+  TimerWheel[TimerNow & WHEEL_MASK] = NO_TIMER;
+  for (; Timer != NO_TIMER; Timer = NextTimer) {
+    NextTimer = TimerNext[Timer];
+    TimerSlot[Timer] = NO_TIMER;
+    Expired(Timer);
+  }
+}
@@ -5,9 +5,17 @@
  *
  * Gérard Chevalier, Nov 2011
  * Nov 2011, xxxxxxxxx
+ *
+ * The frames are sent from the Timer1 compare interrupt: switchON() and
+ * switchOFF() only queue a command and return, the waveform is made of
+ * segments each ending on a compare match, see TX433Step().  Timer1 runs
+ * in CTC mode at clk/8 (0.5 us), so the widths don't drift with the code
+ * run in between; edges only move by the latency of the ISR, mostly when
+ * the RF12 interrupt is being served.
  */
 
 #include "DataloggerDefs.h"
+#include <avr/interrupt.h>
 
 #define NB_BITS 52
 
@@ -17,63 +25,111 @@
 byte onFrame[] = {0xfe, 1, 0xbf, 0xf8, 1, 0xe1, 0xb0};
 byte offFrame[] = {0xfe, 1, 0xbf, 0xf8, 0x1d, 0xa5, 0xb0};
 
+// Compensation blabla xx OK for 5V
+#define COMPENSATE 100
+
+// Waveform, in us: a bit is OFF then ON over TX433_BIT_US, the ON part
+// being longer for a 1.  The widths are the ones the bit banging put on the
+// air: its delays, the 20 us of loop it spent per bit falling in the OFF
+// part.  So a 1 is 420 us OFF and 780 us ON, a 0 820 us OFF and 380 us ON.
+#define TX433_BIT_US       1200
+#define TX433_LOOP_US      20
+#define TX433_OFF1_US      (500 - COMPENSATE + TX433_LOOP_US)
+#define TX433_OFF0_US      (900 - COMPENSATE + TX433_LOOP_US)
+#define TX433_PREAMBLE_US  2600
+#define TX433_GAP_US       23800  // OFF after each frame
+#define TX433_REPEAT       5      // Frames per command
+
+// Segments of a frame: preamble, OFF and ON of each bit, gap
+#define TX433_SEG_GAP      (1 + 2 * NB_BITS)
+
+// Commands waiting to be sent, the first one being sent
+#define TX433_QUEUE        4
+static byte *volatile TxQueue[TX433_QUEUE];
+static volatile byte TxHead = 0, TxCount = 0;
+static byte TxSeg, TxRepeat;
+
 void TX433Init() {
   // PD7/AIN1 (pin 13) = DIO port 4 on Jeenode xx
   DDRD |= _BV(DDD7);
+  TX_OFF();
+  // CTC on OCR1A, clk/8
+  TCCR1A = 0;
+  TCCR1B = _BV(WGM12) | _BV(CS11);
 }
 
-// Compensation blabla xx OK for 5V
-#define COMPENSATE 100
+/*
+ * Set the output for the next segment of the command at the head of the
+ * queue and return its length in us, 0 once the queue is empty.  Called
+ * from the ISR only.
+ */
+static word TX433Step() {
+  byte *Frame = TxQueue[TxHead];
+  byte Bit;
 
-void sendBit(byte currentBit) {
-  if (currentBit == 1) {
-    delayMicroseconds(500-COMPENSATE);
+  if (TxSeg == 0) {
     TX_ON();
-    delayMicroseconds(1200 -20 - 500+COMPENSATE);
-  } else {
-    delayMicroseconds(900-COMPENSATE);
+    TxSeg++;
+    return TX433_PREAMBLE_US;
+  }
+  if (TxSeg < TX433_SEG_GAP) {
+    Bit = (Frame[(TxSeg - 1) / 16] >> (7 - ((TxSeg - 1) / 2) % 8)) & 1;
+    if (TxSeg++ & 1) {
+      TX_OFF();
+      return Bit ? TX433_OFF1_US : TX433_OFF0_US;
+    }
     TX_ON();
-    delayMicroseconds(1200-20 - 900+COMPENSATE);
+    return Bit ? TX433_BIT_US - TX433_OFF1_US : TX433_BIT_US - TX433_OFF0_US;
+  }
+  if (TxSeg == TX433_SEG_GAP) {
+    TX_OFF();
+    TxSeg++;
+    return TX433_GAP_US;
   }
-  TX_OFF();
-}
 
-void sendPrehamble() {
-  TX_ON();
-  delayMicroseconds(2600);
-  TX_OFF();
+  // Gap over: next frame, or next command
+  TxSeg = 0;
+  if (++TxRepeat == TX433_REPEAT) {
+    TxRepeat = 0;
+    TxHead = (TxHead + 1) % TX433_QUEUE;
+    if (--TxCount == 0)
+      return 0;
+  }
+  return TX433Step();
 }
 
-void sendON() {
-  byte bitNb, bitNbToSend;
-    sendPrehamble();
-    for (bitNb = 0; bitNb < NB_BITS; bitNb++) {
-      bitNbToSend = 7 - (bitNb % 8);
-      sendBit((onFrame[bitNb / 8] >> bitNbToSend) & 1);
-    }
+ISR(TIMER1_COMPA_vect) {
+  word Us = TX433Step();
+
+  if (Us == 0)
+    TIMSK1 &= ~_BV(OCIE1A);
+  else
+    OCR1A = Us * 2 - 1;
 }
 
-void sendOFF() {
-  byte bitNb, bitNbToSend;
-    sendPrehamble();
-    for (bitNb = 0; bitNb < NB_BITS; bitNb++) {
-      bitNbToSend = 7 - (bitNb % 8);
-      sendBit((offFrame[bitNb / 8] >> bitNbToSend) & 1);
+// Queue a command, dropped if the queue is full
+static void TX433Send(byte *Frame) {
+  byte OldSREG = SREG;
+
+  cli();
+  if (TxCount < TX433_QUEUE) {
+    TxQueue[(TxHead + TxCount) % TX433_QUEUE] = Frame;
+    if (TxCount++ == 0) {
+      // Start with the preamble on the next timer tick
+      TxSeg = TxRepeat = 0;
+      OCR1A = 1;
+      TCNT1 = 0;
+      TIFR1 = _BV(OCF1A);
+      TIMSK1 |= _BV(OCIE1A);
     }
+  }
+  SREG = OldSREG;
 }
 
 void switchON() {
-  for (byte i = 0; i < 5; i++) {
-    sendON();
-    delay(23); delayMicroseconds(800);
-  }
+  TX433Send(onFrame);
 }
 
 void switchOFF() {
-  for (byte i = 0; i < 5; i++) {
-    sendOFF();
-    delay(23); delayMicroseconds(800);
-  }
+  TX433Send(offFrame);
 }
-
-
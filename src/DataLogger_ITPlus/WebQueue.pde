@@ -0,0 +1,333 @@
+/**
+ * Temperature data logger.
+ *
+ * Store and forward of the WebSend reports.  Each period, the values of the
+ * DS1820 and of the registered IT+ sensors are queued as a sample stamped
+ * with its minute.  A sample only leaves the queue once the server answered
+ * 200 OK to the POST carrying it, so that no period is lost while the
+ * server or the ADSL box is down.
+ *
+ * The newest samples are kept in RAM, older ones spill to a ring at the top
+ * of the EEPROM, above the configuration of Misc.pde which starts at 0.
+ * When both are full the oldest sample is dropped.  The EEPROM ring is
+ * indexed from RAM: a reset loses the backlog.  Cells are written once per
+ * sample spilled or moved down a slot (see WebQueueRemoveSent()), that is
+ * only during outages longer than WEBQ_RAM_SLOTS periods.
+ *
+ * Samples are POSTed as "stream,timestamp,temp" records, the timestamp
+ * being ISO 8601 UTC, as many whole samples per POST as fit in ReportBuff,
+ * see src/webapp/README.rdoc.  The time comes from the Date header of the
+ * server answers.  Until one told it, only the newest sample is sent, as
+ * the usual "stream,temp" records (see PrintRecord()) stamped by the server
+ * on receipt, and the older ones are held.  Samples only leave the queue
+ * unsent when it overflows, counted in WebQueueDropped.
+ */
+
+#include "DataloggerDefs.h"
+#include "ConfigLayout.h"
+#include <avr/eeprom.h>
+
+#define WEBQ_RAM_SLOTS   4
+#define WEBQ_EEP_SLOTS   48
+#define WEBQ_EEP_BASE    ((Type_Sample *)(E2END + 1 - WEBQ_EEP_SLOTS * sizeof(Type_Sample)))
+#define WEBQ_NO_VALUE    0xff  // In DeciTemp: no valid temperature for that stream
+
+static Type_Sample RamSamples[WEBQ_RAM_SLOTS];
+static byte RamHead, RamCount, EepHead, EepCount;
+static byte BatchCount;  // Oldest samples in the POST waiting for its answer, if timed
+static boolean SentUntimed = false;  // Or the POST holds the then newest sample, of minute SentMinutes
+static word SentMinutes;
+word WebQueueDropped;
+
+// The ring must not overlap the configuration of Misc.pde
+typedef char WebQueueAboveConfig[(E2END + 1 - WEBQ_EEP_SLOTS * sizeof(Type_Sample) >=
+                                  CONFIG_EEPROM_END(sizeof(Type_ConfigRecord))) ? 1 : -1];
+
+// Server clock: Unix time at the start of minute ClockMinutes, valid if ClockSet
+static unsigned long ClockTime;
+static word ClockMinutes;
+static boolean ClockSet = false;
+
+byte WebQueueCount() {
+  return EepCount + RamCount;
+}
+
+// i-th oldest sample
+static void WebQueueGet(byte i, Type_Sample *Sample) {
+  if (i < EepCount)
+    eeprom_read_block(Sample, WEBQ_EEP_BASE + (EepHead + i) % WEBQ_EEP_SLOTS, sizeof(Type_Sample));
+  else
+    *Sample = RamSamples[(RamHead + i - EepCount) % WEBQ_RAM_SLOTS];
+}
+
+static void WebQueuePut(byte i, const Type_Sample *Sample) {
+  if (i < EepCount)
+    eeprom_write_block(Sample, WEBQ_EEP_BASE + (EepHead + i) % WEBQ_EEP_SLOTS, sizeof(Type_Sample));
+  else
+    RamSamples[(RamHead + i - EepCount) % WEBQ_RAM_SLOTS] = *Sample;
+}
+
+// Remove the Count oldest samples
+static void WebQueuePop(byte Count) {
+  for (; Count != 0 && EepCount != 0; Count--, EepCount--)
+    EepHead = (EepHead + 1) % WEBQ_EEP_SLOTS;
+  for (; Count != 0 && RamCount != 0; Count--, RamCount--)
+    RamHead = (RamHead + 1) % WEBQ_RAM_SLOTS;
+}
+
+/*
+ * Remove the sample of minute SentMinutes, spilled to the EEPROM since it
+ * was sent or not: the newer ones move down a slot.  Being the newest when
+ * sent, only the few queued since then move.
+ */
+static void WebQueueRemoveSent() {
+  Type_Sample Sample;
+  byte i;
+
+  for (i = WebQueueCount(); i != 0; i--) {
+    WebQueueGet(i - 1, &Sample);
+    if (Sample.Minutes == SentMinutes)
+      break;
+  }
+  if (i == 0)
+    return;  // Dropped meanwhile
+  for (; i < WebQueueCount(); i++) {
+    WebQueueGet(i, &Sample);
+    WebQueuePut(i - 1, &Sample);
+  }
+  if (RamCount != 0)
+    RamCount--;
+  else
+    EepCount--;
+}
+
+// Queue the current values, to be called once per period
+void WebQueuePush() {
+  Type_Sample *Sample;
+
+  if (RamCount == WEBQ_RAM_SLOTS) {
+    // Spill the oldest RAM sample, making room in the EEPROM first
+    if (EepCount == WEBQ_EEP_SLOTS) {
+      WebQueuePop(1);
+      WebQueueDropped++;
+      if (BatchCount != 0)
+        BatchCount--;
+    }
+    eeprom_write_block(&RamSamples[RamHead], WEBQ_EEP_BASE + (EepHead + EepCount) % WEBQ_EEP_SLOTS,
+                       sizeof(Type_Sample));
+    EepCount++;
+    RamHead = (RamHead + 1) % WEBQ_RAM_SLOTS;
+    RamCount--;
+  }
+
+  Sample = &RamSamples[(RamHead + RamCount++) % WEBQ_RAM_SLOTS];
+  Sample->Minutes = Minutes;
+  Sample->Temp[0] = (CentralTempSignBit ? 0x80 : 0) | CentralTempWhole;
+  Sample->DeciTemp[0] = CentralTempFract;
+  for (byte Channel = 0; Channel < ITPLUS_MAX_SENSORS; Channel++) {
+    Sample->Temp[Channel + 1] = ITPlusChannels[Channel].Temp;
+    // Same rule as PrintITPlusRecords()
+    if (ITPlusChannels[Channel].SensorID != 0xff && ITPlusChannels[Channel].LastReceiveTimer != 0)
+      Sample->DeciTemp[Channel + 1] = ITPlusChannels[Channel].DeciTemp;
+    else
+      Sample->DeciTemp[Channel + 1] = WEBQ_NO_VALUE;
+  }
+}
+
+/*
+ * Days from 1970-01-01 to a date and back, proleptic Gregorian calendar, for
+ * dates from 1970.  After H. Hinnant, "chrono-Compatible Low-Level Date
+ * Algorithms".
+ */
+static unsigned long DaysFromCivil(word y, byte m, byte d) {
+  y -= m <= 2;
+  word Era = y / 400, Yoe = y - Era * 400;
+  word Doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  unsigned long Doe = (unsigned long)Yoe * 365 + Yoe / 4 - Yoe / 100 + Doy;
+
+  return Era * 146097UL + Doe - 719468UL;
+}
+
+static void CivilFromDays(unsigned long z, word *y, byte *m, byte *d) {
+  z += 719468UL;
+  word Era = z / 146097UL;
+  unsigned long Doe = z - Era * 146097UL;
+  word Yoe = (Doe - Doe / 1460 + Doe / 36524 - Doe / 146096) / 365;
+  word Doy = Doe - (365UL * Yoe + Yoe / 4 - Yoe / 100);
+  byte Mp = (5 * Doy + 2) / 153;
+
+  *d = Doy - (153 * Mp + 2) / 5 + 1;
+  *m = Mp < 10 ? Mp + 3 : Mp - 9;
+  *y = Yoe + Era * 400 + (*m <= 2);
+}
+
+// Parse a number of up to Digits digits at *Pt, moving past it
+static word ParseNumber(const char **Pt, const char *End, byte Digits) {
+  word Value = 0;
+
+  for (; Digits != 0 && *Pt < End && **Pt >= '0' && **Pt <= '9'; Digits--)
+    Value = Value * 10 + *(*Pt)++ - '0';
+  return Value;
+}
+
+// Header line starting with Name in an HTTP answer, with at least Len bytes, NULL if none
+static const char *FindHeader(const char *Answer, const char *End, const char *Name, byte Len) {
+  byte NameLen = strlen_P(Name);
+
+  for (const char *Pt = Answer; Pt + Len <= End; Pt++) {
+    if (strncmp_P(Pt, Name, NameLen) == 0)
+      return Pt;
+  }
+  return NULL;
+}
+
+/*
+ * Headers of an HTTP answer of the server: its clock from the Date header,
+ * e.g. "Date: Sun, 17 Oct 2026 11:31:45 GMT".  The clock is kept as it was
+ * if there is none.
+ */
+void WebQueueAnswer(const char *Answer, word Len) {
+  static char Months[] PROGMEM = "JanFebMarAprMayJunJulAugSepOctNovDec";
+  const char *End = Answer + Len, *Pt;
+  word Year;
+  byte Day, Month, Hour, Minute, Second;
+
+  Pt = FindHeader(Answer, End, PSTR("\nDate: "), 32);  // "\nDate: Sun, 17 Oct 2026 11:31:45"
+  if (Pt == NULL)
+    return;
+  Pt += 12;  // "\nDate: Sun, "
+  Day = ParseNumber(&Pt, End, 2);
+  Pt++;
+  for (Month = 0; Month < 12 && strncmp_P(Pt, Months + 3 * Month, 3) != 0; Month++)
+    ;
+  Pt += 4;
+  Year = ParseNumber(&Pt, End, 4);
+  Pt++;
+  Hour = ParseNumber(&Pt, End, 2);
+  Pt++;
+  Minute = ParseNumber(&Pt, End, 2);
+  Pt++;
+  Second = ParseNumber(&Pt, End, 2);
+  if (Month == 12 || Day == 0 || Year < 1970)
+    return;
+
+  // Back to the start of the current minute of ours
+  ClockTime = DaysFromCivil(Year, Month + 1, Day) * 86400UL + Hour * 3600UL + Minute * 60 + Second - Seconds;
+  ClockMinutes = Minutes;
+  ClockSet = true;
+}
+
+// Reports are "stream,temp" records separated by CR/LF, written to Out as they are formatted.
+// Records counts the records written so far, start it at 0.
+void PrintRecord(Print &Out, byte Stream, byte Negative, byte Whole, byte Fract, byte *Records) {
+  if ((*Records)++ != 0)
+    Out.print("\r\n");
+  Out.print(Stream, DEC);
+  Out.print(',');
+  if (Negative)
+    Out.print('-');
+  Out.print(Whole, DEC);
+  Out.print('.');
+  Out.print(Fract, DEC);
+}
+
+// "stream,2026-10-17T11:31:00Z,-tt.d", see PrintRecord() for the separators
+static void PrintTimedRecord(Print &Out, byte Stream, unsigned long Time, byte Temp, byte DeciTemp,
+                             byte *Records) {
+  word Year;
+  byte Month, Day;
+  unsigned long Secs = Time % 86400UL;
+
+  CivilFromDays(Time / 86400UL, &Year, &Month, &Day);
+  if ((*Records)++ != 0)
+    Out.print("\r\n");
+  Out.print(Stream, DEC);
+  Out.print(',');
+  Out.print(Year, DEC);
+  Out.print('-');
+  if (Month < 10) Out.print('0');
+  Out.print(Month, DEC);
+  Out.print('-');
+  if (Day < 10) Out.print('0');
+  Out.print(Day, DEC);
+  Out.print('T');
+  if (Secs / 3600 < 10) Out.print('0');
+  Out.print(Secs / 3600, DEC);
+  Out.print(':');
+  if (Secs / 60 % 60 < 10) Out.print('0');
+  Out.print(Secs / 60 % 60, DEC);
+  Out.print(":00Z,");
+  if (Temp & 0x80)
+    Out.print('-');
+  Out.print(Temp & 0x7f, DEC);
+  Out.print('.');
+  Out.print(DeciTemp, DEC);
+}
+
+/*
+ * POST the oldest samples as timed records, or the newest one untimed, see
+ * the top of this file.  They stay queued until WebQueueSent().  Nothing is
+ * sent if the queue is empty.
+ */
+void WebQueueSend() {
+  StrPrint Report(ReportBuff, sizeof(ReportBuff));
+  Type_Sample Sample;
+  byte Records = 0;
+  word Length;
+
+  if (WebQueueCount() == 0)
+    return;
+
+  SentUntimed = !ClockSet;
+  if (SentUntimed) {
+    WebQueueGet(WebQueueCount() - 1, &Sample);
+    SentMinutes = Sample.Minutes;
+    for (byte Stream = 0; Stream <= ITPLUS_MAX_SENSORS; Stream++) {
+      if (Sample.DeciTemp[Stream] != WEBQ_NO_VALUE)
+        PrintRecord(Report, Stream, Sample.Temp[Stream] & 0x80, Sample.Temp[Stream] & 0x7f,
+                    Sample.DeciTemp[Stream], &Records);
+    }
+    BatchCount = 0;
+  } else {
+    for (BatchCount = 0; BatchCount < WebQueueCount(); BatchCount++) {
+      unsigned long Time;
+
+      WebQueueGet(BatchCount, &Sample);
+      Time = ClockTime + (int)(Sample.Minutes - ClockMinutes) * 60L;
+      Length = strlen(ReportBuff);
+      for (byte Stream = 0; Stream <= ITPLUS_MAX_SENSORS; Stream++) {
+        if (Sample.DeciTemp[Stream] != WEBQ_NO_VALUE)
+          PrintTimedRecord(Report, Stream, Time, Sample.Temp[Stream], Sample.DeciTemp[Stream], &Records);
+      }
+      // Only whole samples, ReportBuff holding at least one
+      if (Report.full()) {
+        ReportBuff[Length] = 0;
+        break;
+      }
+    }
+  }
+#if DEBUG_HTTP
+  DebugPrint_P(PSTR("POST "));
+  Serial.print(BatchCount, DEC);
+  Serial.print('/');
+  Serial.println(WebQueueCount(), DEC);
+  Serial.println(ReportBuff);
+#endif
+  WebSend(ReportBuff);
+}
+
+/*
+ * The server answered 200 OK to the last POST: true if more samples can be
+ * sent now.
+ */
+boolean WebQueueSent() {
+  if (SentUntimed) {
+    SentUntimed = false;
+    WebQueueRemoveSent();
+    // The held samples once they can be timed
+    return WebQueueCount() != 0 && ClockSet;
+  }
+  WebQueuePop(BatchCount);
+  BatchCount = 0;
+  return WebQueueCount() != 0;
+}
@@ -0,0 +1,71 @@
+/*
+ * Per interval summaries of the registered sensors, see Aggregate.h
+ *
+ * A TX29 sends 15 frames a minute: a 29 bytes summary per minute takes the
+ * place of 15 records of 14 bytes, or of 15 event log texts of about 200
+ * bytes, and the frames of the sensors that aren't registered are not sent
+ * at all.
+ */
+
+#include "Arduino.h"
+#include "PiWeather.h"
+#include "ITPlusRX_ext.h"
+#include "BinaryOutput.h"
+#include "Aggregate.h"
+
+#ifdef AGGREGATE_ON
+boolean AggregateOutput = true;
+#else
+boolean AggregateOutput = false;
+#endif
+word AggregateInterval = AGGREGATE_INTERVAL;
+#ifdef AGGREGATE_RAW
+boolean RawOutput = true;
+#else
+boolean RawOutput = false;
+#endif
+
+static Type_Aggregate Aggregates[ITPLUS_MAX_SENSORS];
+
+void
+AggregateAdd(byte Channel, int16_t Temp, byte Hygro, byte Flags) {
+    Type_Aggregate *a = &Aggregates[Channel];
+
+    if (a->Count == 0) {
+        a->TempMin = a->TempMax = Temp;
+        a->HygroMin = a->HygroMax = Hygro;
+    } else {
+        if (Temp < a->TempMin)
+            a->TempMin = Temp;
+        if (Temp > a->TempMax)
+            a->TempMax = Temp;
+        if (Hygro < a->HygroMin)
+            a->HygroMin = Hygro;
+        if (Hygro > a->HygroMax)
+            a->HygroMax = Hygro;
+    }
+    a->TempSum += Temp;
+    a->HygroSum += Hygro;
+    a->Count++;
+    a->Flags |= Flags;
+}
+
+void
+AggregateReset(byte Channel) {
+    memset(&Aggregates[Channel], 0, sizeof(Aggregates[Channel]));
+}
+
+/*
+ * Send the summary of each registered channel, then start the next
+ * interval.  Stamp is the micros() of the end of the interval.
+ */
+void
+AggregateSend(unsigned long Stamp) {
+    for (byte Channel = 0; Channel < ITPLUS_MAX_SENSORS; Channel++) {
+        if (ITPlusChannels[Channel].SensorID == 0xff)
+            continue;
+        SendSummaryRecord(ITPlusChannels[Channel].SensorID & ITPLUS_ID_MASK, &Aggregates[Channel],
+                AggregateInterval, Stamp);
+        AggregateReset(Channel);
+    }
+}
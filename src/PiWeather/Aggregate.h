@@ -0,0 +1,26 @@
+#ifndef Aggregate_H
+#define Aggregate_H
+
+#include "Arduino.h"
+#include "PiWeather.h"
+
+/*
+ * Aggregation mode: the frames of each registered sensor are folded into
+ * min/max/sum/count of temperature and hygro, and AggregateSend() sends one
+ * summary record per registered sensor at the end of each interval (see
+ * SensorRecord.h).  The per frame output (binary record or event log text)
+ * is then off, unless RawOutput is set.
+ */
+
+extern boolean AggregateOutput;
+extern word AggregateInterval;      // Seconds
+extern boolean RawOutput;
+
+// Whether each frame is sent as well
+#define FRAME_OUTPUT()  (!AggregateOutput || RawOutput)
+
+void AggregateAdd(byte Channel, int16_t Temp, byte Hygro, byte Flags);
+void AggregateReset(byte Channel);
+void AggregateSend(unsigned long Stamp);
+
+#endif
@@ -0,0 +1,111 @@
+/*
+ * Binary output mode: instead of the text lines of the event log, every IT+
+ * frame is sent to the host as a 14 bytes framed record, see SensorRecord.h
+ * for the format.  The text output of a decoded frame is about 200 bytes.
+ * The sync and aggregation summary records go the same way.
+ */
+
+#include "Arduino.h"
+#include "PiWeather.h"
+#include "ITPlusCRC.h"
+#include "BinaryOutput.h"
+
+#ifdef BINARY_OUTPUT_ON
+boolean BinaryOutput = true;
+#else
+boolean BinaryOutput = false;
+#endif
+
+/*
+ * Consistent Overhead Byte Stuffing of Len bytes (Len < 254): each 0 is
+ * replaced by the distance to the next one, the first distance leading.
+ * Out must hold COBS_LEN(Len) bytes, the encoded length is returned.
+ */
+static byte
+CobsEncode(const byte *In, byte Len, byte *Out) {
+    byte Code = 1, CodeAt = 0, o = 1;
+
+    for (byte i = 0; i < Len; i++) {
+        if (In[i] == 0) {
+            Out[CodeAt] = Code;
+            CodeAt = o++;
+            Code = 1;
+        } else {
+            Out[o++] = In[i];
+            Code++;
+        }
+    }
+    Out[CodeAt] = Code;
+    return o;
+}
+
+static void
+PutWord(byte *Out, word Value) {
+    Out[0] = Value & 0xff;
+    Out[1] = Value >> 8;
+}
+
+static void
+PutLong(byte *Out, unsigned long Value) {
+    Out[0] = Value & 0xff;
+    Out[1] = (Value >> 8) & 0xff;
+    Out[2] = (Value >> 16) & 0xff;
+    Out[3] = Value >> 24;
+}
+
+// Len bytes including the CRC, computed here
+static void
+SendRecord(byte *Record, byte Len) {
+    byte Encoded[COBS_LEN(REC_MAX_LEN)];
+
+    Record[Len - 1] = ITPlusCRC8<ITPLUS_CRC_IMPL>(Record, Len - 1, 0);
+    Serial.write(REC_DELIMITER);
+    Serial.write(Encoded, CobsEncode(Record, Len, Encoded));
+    Serial.write(REC_DELIMITER);
+}
+
+// Stamp is the micros() of the first byte of the frame, see rf12_itplusStamp()
+void
+SendSensorRecord(byte Flags, byte SensorID, int16_t Temp, byte Hygro, unsigned long Stamp) {
+    byte Record[REC_SENSOR_LEN];
+
+    Record[0] = REC_SENSOR;
+    Record[1] = SensorID;
+    Record[2] = Flags;
+    Record[3] = Temp & 0xff;
+    Record[4] = Temp >> 8;
+    Record[5] = Hygro;
+    PutLong(Record + 6, Stamp);
+    SendRecord(Record, REC_SENSOR_LEN);
+}
+
+void
+SendSyncRecord(unsigned long Uptime) {
+    byte Record[REC_SENSOR_LEN];
+
+    Record[0] = REC_SYNC;
+    PutLong(Record + 1, micros());
+    PutLong(Record + 5, Uptime);
+    Record[9] = 0;
+    SendRecord(Record, REC_SENSOR_LEN);
+}
+
+// Stamp is the micros() at the end of the interval
+void
+SendSummaryRecord(byte SensorID, const Type_Aggregate *Aggregate, word Interval, unsigned long Stamp) {
+    byte Record[REC_SUMMARY_LEN];
+
+    Record[0] = REC_SUMMARY;
+    Record[1] = SensorID;
+    Record[2] = REC_FLAG_CRC_OK | Aggregate->Flags;
+    PutWord(Record + 3, Interval);
+    PutWord(Record + 5, Aggregate->Count);
+    PutWord(Record + 7, Aggregate->TempMin);
+    PutWord(Record + 9, Aggregate->TempMax);
+    PutLong(Record + 11, Aggregate->TempSum);
+    Record[15] = Aggregate->HygroMin;
+    Record[16] = Aggregate->HygroMax;
+    PutLong(Record + 17, Aggregate->HygroSum);
+    PutLong(Record + 21, Stamp);
+    SendRecord(Record, REC_SUMMARY_LEN);
+}
@@ -0,0 +1,14 @@
+#ifndef BinaryOutput_H
+#define BinaryOutput_H
+
+#include "Arduino.h"
+#include "PiWeather.h"
+#include "SensorRecord.h"
+
+extern boolean BinaryOutput;
+
+void SendSensorRecord(byte Flags, byte SensorID, int16_t Temp, byte Hygro, unsigned long Stamp);
+void SendSyncRecord(unsigned long Uptime);
+void SendSummaryRecord(byte SensorID, const Type_Aggregate *Aggregate, word Interval, unsigned long Stamp);
+
+#endif
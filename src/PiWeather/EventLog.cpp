@@ -0,0 +1,164 @@
+/*
+ * Deferred debug log, see EventLog.h
+ *
+ * Printing a frame decode used to take several serial_printf() calls, each
+ * blocking on the UART at 57600 baud, right in the frame path.  Now the
+ * frame path stores 8 bytes records and loop() prints them when idle.
+ */
+
+#include "Arduino.h"
+#include <avr/pgmspace.h>
+#include "Misc.h"
+#include "PiWeather.h"
+#include "EventLog.h"
+
+// Records are written at LogHead and printed from LogTail, both only ever
+// incremented: LogHead - LogTail is the number of records waiting
+static Type_LogRecord LogRing[EVENT_LOG_RING];
+static byte LogHead, LogTail;
+
+// Cleared to stop recording, e.g. to measure the frame path without logging
+boolean EventLogEnabled = true;
+
+// Records lost because the ring was full
+word EventLogDropped = 0;
+
+void
+EventLog(byte Event, byte a0, byte a1, byte a2, byte a3, byte a4) {
+    Type_LogRecord *Record;
+
+    if (!EventLogEnabled)
+        return;
+    if ((byte)(LogHead - LogTail) == EVENT_LOG_RING) {
+        EventLogDropped++;
+        return;
+    }
+
+    Record = &LogRing[LogHead & (EVENT_LOG_RING - 1)];
+    Record->Event = Event;
+    Record->Arg[0] = a0;
+    Record->Arg[1] = a1;
+    Record->Arg[2] = a2;
+    Record->Arg[3] = a3;
+    Record->Arg[4] = a4;
+    Record->Stamp = millis();
+    LogHead++;
+}
+
+static void
+EventLogSend(const Type_LogRecord *Record) {
+#ifdef EVENT_LOG_BINARY
+    Serial.write(EVENT_LOG_SYNC);
+    Serial.write((const uint8_t *)Record, sizeof(*Record));
+#else
+    EventLogPrint(Record);
+#endif
+}
+
+/*
+ * Send up to Max records, returns how many were sent.  Lost records are
+ * reported once the ring has been emptied.
+ */
+byte
+EventLogDrain(byte Max) {
+    static word ReportedDropped = 0;
+    byte Count = 0;
+
+    while (Count < Max && LogTail != LogHead) {
+        EventLogSend(&LogRing[LogTail & (EVENT_LOG_RING - 1)]);
+        LogTail++;
+        Count++;
+    }
+
+    if (LogTail == LogHead && EventLogDropped != ReportedDropped) {
+        Type_LogRecord Record;
+        word Dropped = EventLogDropped - ReportedDropped;
+
+        memset(&Record, 0, sizeof(Record));
+        Record.Event = EV_DROPPED;
+        Record.Arg[0] = Dropped & 0xff;
+        Record.Arg[1] = Dropped >> 8;
+        Record.Stamp = millis();
+        EventLogSend(&Record);
+        ReportedDropped += Dropped;
+    }
+    return Count;
+}
+
+/*
+ * Print a record the way the frame path used to print it directly.  Also
+ * used by the host tools to expand binary logs.
+ */
+void
+EventLogPrint(const Type_LogRecord *Record) {
+    const byte *Arg = Record->Arg;
+    char TempC[8], TempF[8];
+    int16_t Temp;
+
+    switch (Record->Event) {
+    case EV_DROPPED:
+        serial_printf("Log: %u records dropped\n", Arg[0] | (Arg[1] << 8));
+        break;
+
+    case EV_FRAME:
+        serial_printf("GotIT+: %02x %02x %02x %02x %02x\n", Arg[0], Arg[1], Arg[2], Arg[3], Arg[4]);
+        break;
+
+    case EV_CRC:
+        serial_printf("CRC reg %02x\n", Arg[0]);
+        break;
+
+    case EV_BAD_CRC:
+        DebugPrintln_P(PSTR("BadCRC"));
+        break;
+
+    case EV_BAD_LENGTH:
+        serial_printf("ERROR: Message length != 9 (%d)\n", Arg[0]);
+        break;
+
+    case EV_DECODED:
+        if (Arg[1] & EV_FLAG_RESTART)
+            Serial.print("RESET!  ");
+
+        serial_printf("Len: 9 - Id: 0x%02x - Misc: %d - Batt: %d", Arg[0],
+                (Arg[1] & EV_FLAG_MISC) != 0, (Arg[1] & EV_FLAG_BATTERY) != 0);
+
+        Temp = Arg[2] | (Arg[3] << 8);
+        FormatDeci(TempC, Temp);
+        FormatDeci(TempF, DeciCelsiusToFahrenheit(Temp));
+        serial_printf(" - Temp: %sC (%sF)", TempC, TempF);
+
+        // Apparently 106 is invalid, but we are seeing 125 for bogus????
+        if (Arg[4] < 100) {
+            serial_printf(" Hygro: %d%%\n", Arg[4]);
+        } else {
+            serial_printf(" Temp channel: %02x\n", Arg[4]);
+        }
+        break;
+
+    case EV_REG_CHECK:
+        FormatDeci(TempC, Arg[1] | (Arg[2] << 8));
+        serial_printf("Checking IT+ Registration: id:%02x, temp:%s\n", Arg[0], TempC);
+        break;
+
+    case EV_REG_FOUND:
+        serial_printf("Found sensor in ITPlusChannels slot: %d\n", Arg[0]);
+        break;
+
+    case EV_REG_UPDATE:
+        serial_printf("Sensor isn't registred, updating DiscoveredITPlus slot: %d\n", Arg[0]);
+        break;
+
+    case EV_REG_ADD:
+        serial_printf("Sensor isn't known, adding it into DiscoveredITPlus slot: %d\n", Arg[0]);
+        break;
+
+    case EV_REG_EVICT:
+        serial_printf("Sensor overload! Re-using DiscoveredITPlus slot: %d\n", Arg[0]);
+        break;
+
+    default:
+        serial_printf("Log: unknown event %d\n", Record->Event);
+        break;
+    }
+}
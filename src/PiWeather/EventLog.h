@@ -0,0 +1,49 @@
+#ifndef EventLog_H
+#define EventLog_H
+
+#include "Arduino.h"
+
+/*
+ * Deferred debug log: the frame path only records an event id and a few
+ * byte arguments into a RAM ring, EventLogDrain() formats and prints them
+ * later from loop().  Not to be used from interrupt handlers.
+ */
+
+// Event ids, the meaning of Arg[] is given for each one
+enum {
+    EV_DROPPED = 1,     // Arg 0-1: records lost since the last report (word)
+    EV_FRAME,           // Arg 0-4: raw IT+ frame
+    EV_CRC,             // Arg 0: CRC register
+    EV_BAD_CRC,
+    EV_BAD_LENGTH,      // Arg 0: length nibble
+    EV_DECODED,         // Arg 0: sensor id, 1: EV_FLAG_*, 2-3: temp in tenths of degree (int16_t), 4: hygro
+    EV_REG_CHECK,       // Arg 0: id with restart flag, 1-2: temp in tenths of degree (int16_t)
+    EV_REG_FOUND,       // Arg 0: ITPlusChannels slot
+    EV_REG_UPDATE,      // Arg 0: DiscoveredITPlus slot
+    EV_REG_ADD,         // Arg 0: DiscoveredITPlus slot
+    EV_REG_EVICT,       // Arg 0: DiscoveredITPlus slot
+    EV_LAST = EV_REG_EVICT
+};
+
+// EV_DECODED flags
+#define EV_FLAG_RESTART 0x01
+#define EV_FLAG_MISC    0x02
+#define EV_FLAG_BATTERY 0x04
+
+// With EVENT_LOG_BINARY, records are sent as is after this byte
+#define EVENT_LOG_SYNC  0xa5
+
+typedef struct {
+    byte Event;
+    byte Arg[5];
+    word Stamp;     // millis() when recorded, low 16 bits
+} Type_LogRecord;
+
+extern boolean EventLogEnabled;
+extern word EventLogDropped;
+
+void EventLog(byte Event, byte a0 = 0, byte a1 = 0, byte a2 = 0, byte a3 = 0, byte a4 = 0);
+byte EventLogDrain(byte Max);
+void EventLogPrint(const Type_LogRecord *Record);
+
+#endif
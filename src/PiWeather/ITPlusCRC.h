@@ -0,0 +1,76 @@
+/**
+ * CRC-8 of La Crosse IT+ frames: polynomial x^8 + x^5 + x^4 + 1 (0x31),
+ * MSB first, initial value 0.  Computed over a whole frame including its
+ * trailing CRC byte, the result is 0 when the frame is valid.
+ *
+ * Three implementations giving the same result, picked at compile time by
+ * defining ITPLUS_CRC_IMPL before including this file:
+ *   ITPLUS_CRC_BITWISE   shift/xor loop, 8 iterations per byte, no table
+ *   ITPLUS_CRC_NIBBLE    2 lookups per byte into a 16 bytes flash table
+ *   ITPLUS_CRC_TABLE     1 lookup per byte into a 256 bytes flash table
+ *
+ * DataLogger_ITPlus has a copy of this file and of ITPlusCRC.cpp, the
+ * Arduino IDE only taking the sources of a sketch from its own folder.  Edit
+ * these and copy them over, the crc-copy tests of the host build fail when
+ * they differ.
+ */
+
+#ifndef ITPlusCRC_H
+#define ITPlusCRC_H
+
+#include <avr/pgmspace.h>
+#include <stdint.h>
+
+#define ITPLUS_CRC_POLY     0x31
+
+#define ITPLUS_CRC_BITWISE  0
+#define ITPLUS_CRC_NIBBLE   1
+#define ITPLUS_CRC_TABLE    2
+
+#ifndef ITPLUS_CRC_IMPL
+#define ITPLUS_CRC_IMPL     ITPLUS_CRC_NIBBLE
+#endif
+
+// CRC of the high nibble n followed by 4 zero bits, and CRC of byte n.  Defined once in ITPlusCRC.cpp,
+// so that the flash holds a single copy whatever the number of files including this one.
+extern const uint8_t ITPlusCRCNibble[16] PROGMEM;
+extern const uint8_t ITPlusCRCTable[256] PROGMEM;
+
+template <uint8_t Impl> struct ITPlusCRC;
+
+template <> struct ITPlusCRC<ITPLUS_CRC_BITWISE> {
+    static inline uint8_t Update(uint8_t crc, uint8_t data) {
+        crc ^= data;
+        for (uint8_t i = 0; i < 8; i++)
+            crc = (crc & 0x80) ? (crc << 1) ^ ITPLUS_CRC_POLY : crc << 1;
+        return crc;
+    }
+};
+
+template <> struct ITPlusCRC<ITPLUS_CRC_NIBBLE> {
+    static inline uint8_t Update(uint8_t crc, uint8_t data) {
+        crc ^= data;
+        crc = (crc << 4) ^ pgm_read_byte(&ITPlusCRCNibble[crc >> 4]);
+        crc = (crc << 4) ^ pgm_read_byte(&ITPlusCRCNibble[crc >> 4]);
+        return crc;
+    }
+};
+
+template <> struct ITPlusCRC<ITPLUS_CRC_TABLE> {
+    static inline uint8_t Update(uint8_t crc, uint8_t data) {
+        return pgm_read_byte(&ITPlusCRCTable[crc ^ data]);
+    }
+};
+
+/*
+ * CRC of len bytes at msg, continuing from crc.  Use ITPlusCRC8<ITPLUS_CRC_IMPL>
+ * unless a specific implementation is wanted.
+ */
+template <uint8_t Impl> inline uint8_t
+ITPlusCRC8(const uint8_t *msg, uint8_t len, uint8_t crc) {
+    while (len-- != 0)
+        crc = ITPlusCRC<Impl>::Update(crc, *msg++);
+    return crc;
+}
+
+#endif
@@ -13,163 +13,291 @@
 #include "Arduino.h"
 #include "RF12_IT_ext.h"
 #include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
 #include "Misc.h"
 #include "PiWeather.h"
+#include "ITPlusCRC.h"
+#include "SensorTimer.h"
+#include "EventLog.h"
+#include "BinaryOutput.h"
+#include "RadioStats.h"
+#include "Aggregate.h"
 
 extern byte SignalError; // From PiWeather.ino
+extern unsigned long FramesMissed; // From PiWeather.ino
 
-byte CheckITPlusRegistration(byte, byte, byte);
+byte CheckITPlusRegistration(byte, int16_t);
 Type_Discovered DiscoveredITPlus[ITPLUS_MAX_DISCOVER];
 Type_Channel ITPlusChannels[ITPLUS_MAX_SENSORS];
 
+/*
+ * Sensor IDs are 6 bits, so every possible ID gets an entry telling where the
+ * sensor lives: a ITPlusChannels index, a DiscoveredITPlus index with
+ * INDEX_DISCOVERED set, or INDEX_NONE.
+ */
+#define INDEX_NONE          0xff
+#define INDEX_DISCOVERED    0x80
+static byte SensorIndex[ITPLUS_ID_MASK + 1];
+
+/*
+ * Discovered slots in use, linked from the most (LruHead) to the least
+ * (LruTail) recently heard, so the one to evict is always LruTail.
+ */
+static byte LruPrev[ITPLUS_MAX_DISCOVER], LruNext[ITPLUS_MAX_DISCOVER];
+static byte LruHead, LruTail, DiscoveredCount;
+
+// Registered channels whose receive timer is 0, for the error LED
+byte StalledSensors;
+
+// Bitmap of the registered sensor IDs, for rf12_itplusFilter()
+byte ITPlusRegisteredIds[(ITPLUS_ID_MASK + 1) / 8];
+
 /* Initialization of this module */
 /* ----------------------------- */
 void 
 ITPlusRXSetup() {
     DebugPrintln_P(PSTR("Init IT+"));
 
-    for (byte i = 0; i < ITPLUS_MAX_SENSORS; i++)
+    for (byte i = 0; i < ITPLUS_MAX_SENSORS; i++) {
+        ITPlusChannels[i].SensorID = 0xff;
         ITPlusChannels[i].LastReceiveTimer = 0;
+    }
 
     for (byte i = 0; i < ITPLUS_MAX_DISCOVER; i++)
         DiscoveredITPlus[i].SensorID = 0xff;
+
+    for (byte i = 0; i <= ITPLUS_ID_MASK; i++)
+        SensorIndex[i] = INDEX_NONE;
+    for (byte i = 0; i < sizeof(ITPlusRegisteredIds); i++)
+        ITPlusRegisteredIds[i] = 0;
+    LruHead = LruTail = INDEX_NONE;
+    DiscoveredCount = 0;
+    StalledSensors = 0;
+    for (byte i = 0; i < ITPLUS_MAX_SENSORS; i++)
+        AggregateReset(i);
+    SensorTimerInit();
 }
 
-#define CRC_POLY 0x31
-boolean 
-CheckITPlusCRC(byte *msge, byte nbBytes) {
-    byte reg = 0;
-    short int i;
-    byte curByte, curbit, bitmask;
-    byte do_xor;
-
-    while (nbBytes-- != 0) {
-        curByte = *msge++; bitmask = 0b10000000;
-        while (bitmask != 0) {
-            curbit = ((curByte & bitmask) == 0) ? 0 : 1;
-            bitmask >>= 1;
-#ifdef DEBUG_CRC
-            serial_printf("byte %02x", curByte);
-#endif
-            do_xor = (reg & 0x80);
+/*
+ * Receive timeouts are kept in SensorTimer.cpp, LastReceiveTimer is only
+ * cleared here when the sensor timer expires.
+ */
+static void
+SensorTimerExpired(byte Timer) {
+    if (Timer < ITPLUS_MAX_SENSORS) {
+        ITPlusChannels[Timer].LastReceiveTimer = 0;
+        if (ITPlusChannels[Timer].SensorID != 0xff)
+            StalledSensors++;
+    } else {
+        DiscoveredITPlus[Timer - ITPLUS_MAX_SENSORS].LastReceiveTimer = 0;
+    }
+}
 
-            reg <<=1;
-            reg |= curbit;
-#ifdef DEBUG_CRC
-            serial_printf(" b=%d ", curbit);
-#endif
+/* To be called once a minute */
+void
+ITPlusMinuteTick() {
+    SensorTimerTick(SensorTimerExpired);
+}
 
-            if (do_xor)
-            {
-#ifdef DEBUG_CRC
-                serial_printf(" Xoring %02x", reg);
-#endif
-                reg ^= CRC_POLY;
-#ifdef DEBUG_CRC
-                serial_printf(" > %02x", reg);
-#endif
-            }
+/*
+ * Frame is valid when the CRC over all its bytes, CRC byte included, is 0.
+ * The implementation used is selected by ITPLUS_CRC_IMPL in PiWeather.h
+ */
+boolean 
+CheckITPlusCRC(byte *msge, byte nbBytes) {
+    byte reg = ITPlusCRC8<ITPLUS_CRC_IMPL>(msge, nbBytes, 0);
 
 #ifdef DEBUG_CRC
-            serial_printf(" reg %02x\n", reg);
+    EventLog(EV_CRC, reg);
 #endif
-        }
-    }
+    if (reg != 0)
+        STAT_INC(CrcErrors);
     return (reg == 0);
 }
 
 
 /*
  * This is the main function to decode and print out IT+ frames from 
- * La Crosse Technology sensors
+ * La Crosse Technology sensors.  Stamp is the micros() the frame started at.
  */
 void 
-ProcessITPlusFrame() {
-    byte Length, SensorID, Temp, DeciTemp, Hygro, Channel;
-    boolean RestartFlag, WeakBatt, MiscFlag, Battery;
-
-#ifdef ITPLUS_DEBUG
-    float TempF;
-    char FloatBuff[6];
-#endif 
+ProcessITPlusFrame(const byte *Frame, unsigned long Stamp) {
+    byte Length, SensorID, Hygro, Channel, Flags;
+    int16_t Temp;
+    boolean RestartFlag, MiscFlag, Battery;
 
     // Here, there are chance that the frame just received is an IT+ one (flag ITPlusFrame set), but not sure.
     // So, check CRC, and decode if OK.
 #ifdef ITPLUS_DEBUG_FRAME
-    serial_printf("GotIT+: %02x %02x %02x %02x %02x\n", 
-            rf12_buf[0], rf12_buf[1], rf12_buf[2], rf12_buf[3], rf12_buf[4]);
+    EventLog(EV_FRAME, Frame[0], Frame[1], Frame[2], Frame[3], Frame[4]);
 #endif
 
     // If bad CRC, then just return
-    if (! CheckITPlusCRC((byte *)rf12_buf, 5)) {
+    if (! CheckITPlusCRC((byte *)Frame, ITPLUS_FRAME_LEN)) {
 #ifdef ITPLUS_DEBUG_FRAME
-        DebugPrintln_P(PSTR("BadCRC"));
+        EventLog(EV_BAD_CRC);
 #endif
+        if (BinaryOutput && FRAME_OUTPUT())
+            SendSensorRecord(0, 0, 0, 0, Stamp);
         return;
     }
 
     // OK, CRC is valid, we do have an IT+ valid frame 
 
-    Length        = (rf12_buf[0] & 0xf0) >> 4;
+    Length        = (Frame[0] & 0xf0) >> 4;
 
     if (Length != 9) {
-        serial_printf("ERROR: Message length != 9 (%d)\n", Length);
+        STAT_INC(BadLength);
+        EventLog(EV_BAD_LENGTH, Length);
         return;
     }
-    SensorID      = ((rf12_buf[0] & 0x0f) << 4) + ((rf12_buf[1] & 0b11000000) >> 6);
-    RestartFlag   = (rf12_buf[1] & 0x20) >> 5;
-    MiscFlag      = (rf12_buf[1] & 0x10) >> 4;         // Seems to indicate when sensorID has two different temp sensors
-    Temp          = ((rf12_buf[1] & 0x0f) * 10);       // T10 field
-    Temp         += ((rf12_buf[2] & 0xf0) >> 4);       // T1 field
-    DeciTemp      = rf12_buf[2] & 0x0f;                // T.1 field
-    Battery       = (rf12_buf[3] & 0x80) >> 7;
-    Hygro         = rf12_buf[3] & 0x7f;
-
-
-    // Sign bit is stored into bit #7 of temperature. IT+ add a 40° offset to temp, so < 40 means negative
-    if (Temp >= 40) {
-        Temp -= 40;
-    } else {
-        if (DeciTemp == 0) {
-            Temp = 40 - Temp;
-        } else {
-            Temp = 39 - Temp;
-            DeciTemp = 10 - DeciTemp;
-        }
-        Temp |= 0b10000000;
-    }
-
+    SensorID      = ((Frame[0] & 0x0f) << 2) + ((Frame[1] & 0b11000000) >> 6);
+    RestartFlag   = (Frame[1] & 0x20) >> 5;
+    MiscFlag      = (Frame[1] & 0x10) >> 4;         // Seems to indicate when sensorID has two different temp sensors
+    Temp          = (Frame[1] & 0x0f) * 100;        // T10 field
+    Temp         += ((Frame[2] & 0xf0) >> 4) * 10;  // T1 field
+    Temp         += Frame[2] & 0x0f;                // T.1 field
+    Battery       = (Frame[3] & 0x80) >> 7;
+    Hygro         = Frame[3] & 0x7f;
+
+    // IT+ add a 40° offset to temp, keep tenths of degree from now on
+    Temp -= 400;
 
 #ifdef ITPLUS_DEBUG
-    if (RestartFlag) {
-        Serial.print("RESET!  ");
+    // Printed later from loop(), see EventLog.cpp
+    EventLog(EV_DECODED, SensorID,
+            (RestartFlag ? EV_FLAG_RESTART : 0) | (MiscFlag ? EV_FLAG_MISC : 0) | (Battery ? EV_FLAG_BATTERY : 0),
+            Temp & 0xff, Temp >> 8, Hygro);
+#endif
+    Flags = REC_FLAG_CRC_OK | (RestartFlag ? REC_FLAG_RESTART : 0) | (MiscFlag ? REC_FLAG_MISC : 0) |
+            (Battery ? REC_FLAG_WEAK_BATT : 0);
+    if (BinaryOutput && FRAME_OUTPUT())
+        SendSensorRecord(Flags, SensorID, Temp, Hygro, Stamp);
+
+    // Process received measures (only if sensor is registered)
+    if ((Channel = CheckITPlusRegistration((SensorID | (RestartFlag << 6)), Temp)) != 0xff) {
+        ITPlusChannels[Channel].Temp = Temp;
+        if (AggregateOutput)
+            AggregateAdd(Channel, Temp, Hygro, Flags);
     }
+}
 
-    serial_printf("Len: %d - Id: 0x%02x - Misc: %d - Batt: %d", Length, SensorID, MiscFlag, Battery);
+/*
+ * IT+ sensors send a frame every ITPLUS_TX_PERIOD, so the time elapsed since
+ * the last frame of a sensor tells how many of its frames we did not get.
+ * Gaps longer than the receive timeout mean the sensor was gone, not missed.
+ */
+static void
+CountMissedFrames(unsigned long *LastReceiveMillis) {
+    unsigned long now = millis(), periods;
+
+    if (*LastReceiveMillis != 0 && now - *LastReceiveMillis < SENSORS_RX_TIMEOUT * 60000L) {
+        periods = (now - *LastReceiveMillis + ITPLUS_TX_PERIOD / 2) / ITPLUS_TX_PERIOD;
+        if (periods > 1)
+            FramesMissed += periods - 1;
+    }
+    *LastReceiveMillis = now;
+}
 
+static void
+LruUnlink(byte i) {
+    if (LruPrev[i] != INDEX_NONE)
+        LruNext[LruPrev[i]] = LruNext[i];
+    else
+        LruHead = LruNext[i];
+    if (LruNext[i] != INDEX_NONE)
+        LruPrev[LruNext[i]] = LruPrev[i];
+    else
+        LruTail = LruPrev[i];
+}
 
-    // is value negative?
-    if (Temp & 0b10000000)
-        Serial.print("-");
+static void
+LruPushFront(byte i) {
+    LruPrev[i] = INDEX_NONE;
+    LruNext[i] = LruHead;
+    if (LruHead != INDEX_NONE)
+        LruPrev[LruHead] = i;
+    else
+        LruTail = i;
+    LruHead = i;
+}
 
-    // calc temp in Farenhiet
-    TempF = (((float)Temp + ((float)DeciTemp * 0.1)) * 1.8) + 32;
+/*
+ * Register sensor id on Channel, or free Channel when id is 0xff.  A sensor
+ * left in the discovered table stays there until evicted, lookups find the
+ * registered channel first.  Once unregistered, lookups find that slot again
+ * instead of adding the sensor to the table a second time.
+ */
+void
+ITPlusRegister(byte Channel, byte id) {
+    byte Old = ITPlusChannels[Channel].SensorID;
+
+    if (Old != 0xff) {
+        Old &= ITPLUS_ID_MASK;
+        // Unless registered on another channel too
+        if (SensorIndex[Old] == Channel) {
+            SensorIndex[Old] = INDEX_NONE;
+            ITPlusRegisteredIds[Old >> 3] &= ~(1 << (Old & 7));
+            for (byte i = 0; i < DiscoveredCount; i++) {
+                if ((DiscoveredITPlus[i].SensorID & ITPLUS_ID_MASK) == Old) {
+                    SensorIndex[Old] = i | INDEX_DISCOVERED;
+                    break;
+                }
+            }
+        }
+        if (ITPlusChannels[Channel].LastReceiveTimer == 0)
+            StalledSensors--;
+    }
 
-    // we don't store it as a float!
-    serial_printf(" - Temp: %02d.%dC (%sF)", Temp & 0x7F, DeciTemp, ftoa(FloatBuff, TempF, 1));
+    // Stalled until we hear from it
+    ITPlusChannels[Channel].SensorID = id;
+    ITPlusChannels[Channel].LastReceiveTimer = 0;
+    SensorTimerCancel(CHANNEL_TIMER(Channel));
+    AggregateReset(Channel);
+    if (id != 0xff) {
+        SensorIndex[id & ITPLUS_ID_MASK] = Channel;
+        ITPlusRegisteredIds[(id & ITPLUS_ID_MASK) >> 3] |= 1 << (id & 7);
+        StalledSensors++;
+    }
+}
 
-    // Apparently 106 is invalid, but we are seeing 125 for bogus????
-    if (Hygro < 100) {
-        serial_printf(" Hygro: %d%%\n", Hygro);
-    } else {
-        serial_printf(" Temp channel: %02x\n", Hygro);
+/*
+ * Registrations in EEPROM at ITPLUS_EEPROM_ADDR: the SensorID of each
+ * channel, then their CRC-16 so that a blank EEPROM registers nothing.
+ * Only the bytes that changed are written.
+ */
+void
+ITPlusSaveRegistrations() {
+    uint16_t crc = ~0;
+    byte i;
+
+    for (i = 0; i < ITPLUS_MAX_SENSORS; i++) {
+        if (eeprom_read_byte(ITPLUS_EEPROM_ADDR + i) != ITPlusChannels[i].SensorID)
+            eeprom_write_byte(ITPLUS_EEPROM_ADDR + i, ITPlusChannels[i].SensorID);
+        crc = _crc16_update(crc, ITPlusChannels[i].SensorID);
     }
-#endif
+    if (eeprom_read_byte(ITPLUS_EEPROM_ADDR + i) != (crc & 0xff))
+        eeprom_write_byte(ITPLUS_EEPROM_ADDR + i, crc & 0xff);
+    if (eeprom_read_byte(ITPLUS_EEPROM_ADDR + i + 1) != (crc >> 8))
+        eeprom_write_byte(ITPLUS_EEPROM_ADDR + i + 1, crc >> 8);
+}
 
-    // Process received measures (only if sensor is registered)
-    if ((Channel = CheckITPlusRegistration((SensorID | RestartFlag), Temp, DeciTemp)) != 0xff) {
-        ITPlusChannels[Channel].Temp = Temp;
-        ITPlusChannels[Channel].DeciTemp = DeciTemp;
+// Register the sensors saved above, at boot after ITPlusRXSetup()
+void
+ITPlusLoadRegistrations() {
+    uint16_t crc = ~0;
+    byte i;
+
+    for (i = 0; i < ITPLUS_MAX_SENSORS; i++)
+        crc = _crc16_update(crc, eeprom_read_byte(ITPLUS_EEPROM_ADDR + i));
+    if (crc != (eeprom_read_byte(ITPLUS_EEPROM_ADDR + i) | eeprom_read_byte(ITPLUS_EEPROM_ADDR + i + 1) << 8))
+        return;
+    for (i = 0; i < ITPLUS_MAX_SENSORS; i++) {
+        byte id = eeprom_read_byte(ITPLUS_EEPROM_ADDR + i);
+
+        if (id != 0xff)
+            ITPlusRegister(i, id);
     }
 }
 
@@ -179,75 +307,92 @@ ProcessITPlusFrame() {
  * ID was generated. This flag is held on for about 4h30mn, enabling sensor / receiver peering.
  * This function should be passed the "raw ID", including the flag (in bit #6) in order to store it
  * into the discovered table with the sensor id to distinguish lists in display later on.
- * If the ID is not found, the sensor is added to the discovered IDs table (if not already there).
+ * If the ID is not found, the sensor is added to the discovered IDs table (if not already there),
+ * replacing the least recently heard discovered sensor when the table is full.
  * When ID not found, return 0xff
  */
 byte 
-CheckITPlusRegistration(byte id, byte Temp, byte DeciTemp) {
-    byte i, FreeIndex;
-    unsigned int MaxTime;
+CheckITPlusRegistration(byte id, int16_t Temp) {
+    byte Slot = SensorIndex[id & ITPLUS_ID_MASK];
 
 #ifdef ITPLUS_DEBUG 
-    serial_printf("Checking IT+ Registration: id:%02x, temp:%d, decitemp:%d\n", id, Temp, DeciTemp);
+    EventLog(EV_REG_CHECK, id, Temp & 0xff, Temp >> 8);
 #endif 
 
-    for (i = 0; i < ITPLUS_MAX_SENSORS; i++) {
-        if (ITPlusChannels[i].SensorID == (id & ITPLUS_ID_MASK)) {  // Do the search without reset flag
-            // OK Found, reset receive timer & return channel = index
-            ITPlusChannels[i].LastReceiveTimer = SENSORS_RX_TIMEOUT;
+    if (Slot < ITPLUS_MAX_SENSORS) {
+        // OK Found, reset receive timer & return channel = index
+        STAT_INC(RegistryHits);
+        if (ITPlusChannels[Slot].LastReceiveTimer == 0)
+            StalledSensors--;
+        ITPlusChannels[Slot].LastReceiveTimer = SENSORS_RX_TIMEOUT;
+        SensorTimerSet(CHANNEL_TIMER(Slot), SENSORS_RX_TIMEOUT);
+        CountMissedFrames(&ITPlusChannels[Slot].LastReceiveMillis);
 #ifdef ITPLUS_DEBUG 
-            serial_printf("Found sensor in ITPlusChannels slot: %d\n", i);
+        EventLog(EV_REG_FOUND, Slot);
 #endif
-            return i;
-        }
+        return Slot;
     }
 
-    // The sensor is not registered, try to find it into discovered table
-    for (i = 0; i < ITPLUS_MAX_DISCOVER; i++) {
-        if ((DiscoveredITPlus[i].SensorID & ITPLUS_ID_MASK) == (id & ITPLUS_ID_MASK)) {
-            // Found! Update the last receive timer
-            DiscoveredITPlus[i].LastReceiveTimer = ITPLUS_DISCOVERY_PERIOD;
-            DiscoveredITPlus[i].Temp = Temp;
-            DiscoveredITPlus[i].DeciTemp = DeciTemp;
-
+    if (Slot != INDEX_NONE) {
+        // The sensor is not registered but known: update the discovered slot
+        STAT_INC(RegistryKnown);
+        Slot &= ~INDEX_DISCOVERED;
+        DiscoveredITPlus[Slot].LastReceiveTimer = ITPLUS_DISCOVERY_PERIOD;
+        SensorTimerSet(DISCOVERED_TIMER(Slot), ITPLUS_DISCOVERY_PERIOD);
+        DiscoveredITPlus[Slot].Temp = Temp;
+        CountMissedFrames(&DiscoveredITPlus[Slot].LastReceiveMillis);
+        LruUnlink(Slot);
+        LruPushFront(Slot);
 #ifdef ITPLUS_DEBUG 
-            serial_printf("Sensor isn't registred, updating DiscoveredITPlus slot: %d\n", i);
+        EventLog(EV_REG_UPDATE, Slot);
 #endif
-            // And return "NOT Found"
-            return 0xff;
-        }
+        // And return "NOT Found"
+        return 0xff;
     }
 
-    // Not found: insert into a free slot, including the reset flag.
-    for (i = 0; i < ITPLUS_MAX_DISCOVER; i++) {	// Find a free slot
-        if (DiscoveredITPlus[i].SensorID == 0xff) {
-            DiscoveredITPlus[i].SensorID = id;
-            DiscoveredITPlus[i].LastReceiveTimer = ITPLUS_DISCOVERY_PERIOD;
-            DiscoveredITPlus[i].Temp = Temp;
-            DiscoveredITPlus[i].DeciTemp = DeciTemp;
+    // Not found: insert into a free slot, or reuse the least recently heard one.
+    STAT_INC(RegistryNew);
+    if (DiscoveredCount < ITPLUS_MAX_DISCOVER) {
+        Slot = DiscoveredCount++;
 #ifdef ITPLUS_DEBUG 
-            serial_printf("Sensor isn't known, adding it into DiscoveredITPlus slot: %d\n", i);
+        EventLog(EV_REG_ADD, Slot);
 #endif
-            return 0xff;
-        }
-    }
-
-    // No free slot found. Use the one with oldest receiving time.
-    MaxTime = ITPLUS_DISCOVERY_PERIOD;
-    FreeIndex = 0;
-    for (i = 0; i < ITPLUS_DISCOVERY_PERIOD; i++) {
-        if (DiscoveredITPlus[i].LastReceiveTimer < MaxTime) {
-            MaxTime = DiscoveredITPlus[i].LastReceiveTimer;
-            FreeIndex = i;
-        }
-    }
-    DiscoveredITPlus[FreeIndex].SensorID = id;
-    DiscoveredITPlus[FreeIndex].LastReceiveTimer = ITPLUS_DISCOVERY_PERIOD;
-    DiscoveredITPlus[FreeIndex].Temp = Temp;
-    DiscoveredITPlus[FreeIndex].DeciTemp = DeciTemp;
+    } else {
+        Slot = LruTail;
+        LruUnlink(Slot);
+        STAT_INC(RegistryEvictions);
+        // Only forget the evicted ID if it wasn't registered since
+        if (SensorIndex[DiscoveredITPlus[Slot].SensorID & ITPLUS_ID_MASK] == (Slot | INDEX_DISCOVERED))
+            SensorIndex[DiscoveredITPlus[Slot].SensorID & ITPLUS_ID_MASK] = INDEX_NONE;
 #ifdef ITPLUS_DEBUG 
-            serial_printf("Sensor overload! Re-using DiscoveredITPlus slot: %d\n", FreeIndex);
+        EventLog(EV_REG_EVICT, Slot);
 #endif
+    }
+
+    // Store including the reset flag
+    DiscoveredITPlus[Slot].SensorID = id;
+    DiscoveredITPlus[Slot].LastReceiveTimer = ITPLUS_DISCOVERY_PERIOD;
+    SensorTimerSet(DISCOVERED_TIMER(Slot), ITPLUS_DISCOVERY_PERIOD);
+    DiscoveredITPlus[Slot].Temp = Temp;
+    DiscoveredITPlus[Slot].LastReceiveMillis = millis();
+    SensorIndex[id & ITPLUS_ID_MASK] = Slot | INDEX_DISCOVERED;
+    LruPushFront(Slot);
     return 0xff;
 }
 
+/*
+ * Write the report records of the registered channels we have a valid
+ * temperature for, see PrintRecord().  DataStream 1 to ITPLUS_MAX_SENSORS
+ * are IT+ Sensors.
+ */
+void
+PrintITPlusRecords(Print &Out, byte *Records) {
+    for (byte Channel = 0; Channel < ITPLUS_MAX_SENSORS; Channel++) {
+        if (ITPlusChannels[Channel].SensorID != 0xff) {  // Send only if registered
+            if (ITPlusChannels[Channel].LastReceiveTimer != 0) {  // Send only if valid temp received
+                //                        "1,-tt.dNL2,-tt.dNL3,-tt.d"
+                PrintRecord(Out, Channel + 1, ITPlusChannels[Channel].Temp, Records);
+            }
+        }
+    }
+}
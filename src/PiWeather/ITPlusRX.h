@@ -4,8 +4,13 @@
 // Note: Don't include this file, include ITPlusRX_ext.h instead
 
 void ITPlusRXSetup();
-boolean CheckITPlusCRC();
-void ProcessITPlusFrame();
-byte CheckITPlusRegistration(byte id, byte Temp, byte DeciTemp);
+boolean CheckITPlusCRC(byte *msge, byte nbBytes);
+void ProcessITPlusFrame(const byte *Frame, unsigned long Stamp);
+byte CheckITPlusRegistration(byte id, int16_t Temp);
+void ITPlusRegister(byte Channel, byte id);
+void ITPlusSaveRegistrations();
+void ITPlusLoadRegistrations();
+void ITPlusMinuteTick();
+void PrintITPlusRecords(Print &Out, byte *Records);
 
 #endif
@@ -5,5 +5,7 @@
 
 extern Type_Channel ITPlusChannels[ITPLUS_MAX_SENSORS];
 extern Type_Discovered DiscoveredITPlus[ITPLUS_MAX_DISCOVER];
+extern byte StalledSensors;
+extern byte ITPlusRegisteredIds[(ITPLUS_ID_MASK + 1) / 8];
 
 #endif
@@ -1,7 +1,6 @@
 #include "Arduino.h"
 #include <avr/pgmspace.h>
 #include "PiWeather.h"
-#include <stdlib.h> // needed for ftoa()
 #define MAX_SPRINTF 128
 
 /* 
@@ -44,24 +43,60 @@ serial_printf(char *fmt, ... ) {
 
 
 /*
- * Float to ascii
- * Since the sprintf() of the Arduino doesn't support floating point
- * converstion, #include <stdlib.h> for itoa() and then use this function
- * to do the conversion manually
+ * Temperatures are kept in tenths of degree.  Write Deci as "-12.3" into Buff
+ * and return a pointer to the terminating null, so that more can be appended.
+ * Buff must hold at least 8 chars.
  */
-char 
-*ftoa(char *a, double f, int precision)
-{
-  long p[] = {
-    0,10,100,1000,10000,100000,1000000,10000000,100000000  };
+char *
+FormatDeci(char *Buff, int16_t Deci) {
+    char Digits[5];
+    byte n = 0;
+    word Value = Deci;
 
-  char *ret = a;
-  long heiltal = (long)f;
-  itoa(heiltal, a, 10);
-  while (*a != '\0') a++;
-  *a++ = '.';
-  long desimal = abs((long)((f - heiltal) * p[precision]));
-  itoa(desimal, a, 10);
-  return ret;
+    if (Deci < 0) {
+        *Buff++ = '-';
+        Value = -Value;
+    }
+
+    // Least significant first, at least one digit before the point
+    do {
+        Digits[n++] = '0' + Value % 10;
+        Value /= 10;
+    } while (Value != 0 || n < 2);
+
+    while (n > 1)
+        *Buff++ = Digits[--n];
+    *Buff++ = '.';
+    *Buff++ = Digits[0];
+    *Buff = '\0';
+    return Buff;
 }
 
+/*
+ * F = C * 1.8 + 32, in tenths of degree and rounded to the nearest.  Deci * 9
+ * + 1600 is five times the result, so there are never ties to break.
+ */
+int16_t
+DeciCelsiusToFahrenheit(int16_t Deci) {
+    long Five = (long)Deci * 9 + 1600;
+
+    if (Five >= 0)
+        return (Five + 2) / 5;
+    return -((-Five + 2) / 5);
+}
+
+/*
+ * Reports are "stream,temp" records separated by CR/LF, written to Out as
+ * they are formatted so that no buffer has to hold the whole report.
+ * *Records counts the records written so far, start it at 0.
+ */
+void
+PrintRecord(Print &Out, byte Stream, int16_t Deci, byte *Records) {
+    char Buff[8];
+
+    if ((*Records)++ != 0)
+        Out.write((const uint8_t *)"\r\n", 2);
+    Out.print(Stream);
+    Out.write(',');
+    Out.write((const uint8_t *)Buff, FormatDeci(Buff, Deci) - Buff);
+}
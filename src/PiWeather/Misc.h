@@ -6,7 +6,9 @@ void DebugPrint_P(const char *addr);
 void DebugPrintln_P(const char *addr);
 void printHex(byte data);
 void serial_printf(char *fmt, ... );
-char *ftoa(char *a, double f, int precision);
+char *FormatDeci(char *Buff, int16_t Deci);
+int16_t DeciCelsiusToFahrenheit(int16_t Deci);
+void PrintRecord(Print &Out, byte Stream, int16_t Deci, byte *Records);
 
 
 #endif
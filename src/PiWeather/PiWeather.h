@@ -16,15 +16,59 @@
 #define RF12_FRAME_DEBUG // Debug RF12 frames 
 // #define DEBUG_CRC
 
+// Counters of the radio and decode path, printed on the serial 's' command,
+// see RadioStats.h.  Takes Timer1 to count the interrupt handler cycles.
+#define RADIO_STATS
+
+// IT+ CRC implementation, see ITPlusCRC.h: ITPLUS_CRC_BITWISE (no table),
+// ITPLUS_CRC_NIBBLE (16 bytes of flash) or ITPLUS_CRC_TABLE (256 bytes of flash)
+#define ITPLUS_CRC_IMPL ITPLUS_CRC_NIBBLE
+
 #define ITPLUS_DEBUG 
 #define ITPLUS_DEBUG_FRAME
+
+// The IT+ debug output above is recorded into a RAM ring and printed from
+// loop() when there is nothing else to do, see EventLog.cpp
+#define EVENT_LOG_RING 16  // Records of 8 bytes, power of 2 up to 128
+#define EVENT_LOG_DRAIN 2  // Records printed per loop() pass
+// #define EVENT_LOG_BINARY  // Send raw records, expand with "itplus-replay log"
 #define ITPLUS_MAX_SENSORS 15 
 #define ITPLUS_MAX_DISCOVER  ITPLUS_MAX_SENSORS
 #define ITPLUS_DISCOVERY_PERIOD 255
 #define ITPLUS_ID_MASK	0b00111111
+#define ITPLUS_TX_PERIOD 4000L  // TX29 sensors send a frame every ~4s
+#define ITPLUS_RX_RING 8  // IT+ frames queued between rf12_interrupt() and loop(), power of 2
+
+// Registered-only receive: rf12_interrupt() drops the frames of other sensor
+// IDs after their second byte, sparing the 3 bytes left and their decoding.
+// Nothing gets discovered then, not even a registered sensor with a new ID.
+// #define ITPLUS_REGISTERED_ONLY
+
+// Registered sensor IDs kept in EEPROM, serial command "<channel>,<id>a",
+// after the RF12 config: a byte per channel then their CRC-16
+#define ITPLUS_EEPROM_ADDR ((uint8_t*) 0x50)
 
 #define SENSORS_RX_TIMEOUT 5
 
+// Send every IT+ frame as a binary record rather than the event log text,
+// see BinaryOutput.cpp and SensorRecord.h
+// #define BINARY_OUTPUT_ON
+
+// Aggregation: rather than every frame, send one summary record per
+// registered sensor every AGGREGATE_INTERVAL seconds (serial command
+// "<seconds>i"), see Aggregate.cpp.  The frame output can be kept with
+// AGGREGATE_RAW (serial command 'r' toggles it).
+// #define AGGREGATE_ON
+#define AGGREGATE_INTERVAL 60
+// #define AGGREGATE_RAW
+
+// Print the temperature of the registered sensors every minute
+#define MINUTE_REPORT
+
+// Sleep in idle mode at the end of loop(), any interrupt (RFM12B, timer0, UART)
+// wakes us up again
+#define LOOP_IDLE_SLEEP
+
 
 // Define if you want to compile in sending support
 // #define INCLUDE_RF12_SEND  
@@ -37,17 +81,38 @@
 #endif
 
 // Radio Sensor structure (both RF12 & IT+)
+// LastReceiveTimer is set to the timeout on receive and cleared when it expires,
+// see SensorTimer.cpp for the minutes left
 typedef struct {
-  char SensorID;
-  char LastReceiveTimer;
-  char Temp, DeciTemp;
+  byte SensorID;
+  byte LastReceiveTimer;
+  int16_t Temp;  // Tenths of degree Celsius
+  unsigned long LastReceiveMillis;  // millis() of the last frame, for missed frames stats
 } Type_Channel;
 
 // Radio Sensor structure for IT+ Sensors discovery process
 typedef struct {
-  char SensorID;
-  char LastReceiveTimer;
-  char Temp, DeciTemp;
+  byte SensorID;
+  byte LastReceiveTimer;
+  int16_t Temp;
+  unsigned long LastReceiveMillis;
 } Type_Discovered;
 
+// Frames of a registered sensor over an aggregation interval, see Aggregate.cpp
+typedef struct {
+  int16_t TempMin, TempMax;
+  int32_t TempSum;
+  byte HygroMin, HygroMax;
+  uint32_t HygroSum;
+  word Count;
+  byte Flags;  // REC_FLAG_* of all the frames
+} Type_Aggregate;
+
+// Housekeeping task run from loop() every Interval ms
+typedef struct {
+  unsigned long Interval;
+  unsigned long LastRun;
+  void (*Run)(void);
+} Type_Task;
+
 #endif
@@ -7,10 +7,15 @@
  */
 
 #include <avr/pgmspace.h>
+#include <avr/sleep.h>
 #include "PiWeather.h"
 #include "RF12_IT_ext.h"
 #include "Misc.h"
 #include "ITPlusRX_ext.h"
+#include "EventLog.h"
+#include "BinaryOutput.h"
+#include "RadioStats.h"
+#include "Aggregate.h"
 
 /***********************************************
  * Globals 
@@ -18,17 +23,30 @@
 // SignalError tells if an error has to be signaled on LED, 0=No, 1&2=yes, 2 values for blinking
 byte SignalError = 1;
 boolean ErrorCondition = false;
-unsigned long previousMillis = 0;
 
 uint8_t Seconds = 0;
-word Minutes = 0;
-boolean ANewMinute = false;
+unsigned long Minutes = 0;
+unsigned long Uptime = 0;  // Seconds since reset, sent in the sync records
+
+// Capture statistics: complete IT+ frames handed over by the driver, and frames
+// sent by known sensors that we never got (estimated in ITPlusRX.cpp)
+unsigned long FramesReceived = 0;
+unsigned long FramesMissed = 0;
 
 /* Forward declare */
 void RF12Init();
+void CheckRF12Recv();
+void CheckSerialCommand();
+void RunTasks();
+void SecondTask();
+void MinuteTask();
 
-
-char CommonStrBuff[50], *PtData;
+// Housekeeping, the radio itself is serviced on every loop() pass
+Type_Task Tasks[] = {
+    { 1000L, 0, SecondTask },
+    { 60000L, 0, MinuteTask },
+};
+#define NB_TASKS (sizeof(Tasks) / sizeof(Tasks[0]))
 
 /***********************************************
  * setup() 
@@ -38,6 +56,13 @@ setup() {
     Serial.begin(57600);
     RF12Init();
     ITPlusRXSetup();
+    ITPlusLoadRegistrations();
+#ifdef ITPLUS_REGISTERED_ONLY
+    rf12_itplusFilter(ITPlusRegisteredIds);
+#endif
+
+    // The binary records or the summaries replace the per frame text
+    EventLogEnabled = !BinaryOutput && FRAME_OUTPUT();
 }
 
 /***********************************************
@@ -45,77 +70,150 @@ setup() {
  ***********************************************/
 void 
 loop() {
-    // Check if a new second elapsed
-    if (millis() - previousMillis > 1000L) {
-        previousMillis = millis();
-        Seconds++;
-        if (Seconds == 60) {
-            Seconds = 0;
-            Minutes++;
-            ANewMinute = true;
-        }
+    // A completed frame is held in rf12_buf with the RFM12B idle until the
+    // next call to rf12_recvDone(), so don't let it wait for a timed task
+    CheckRF12Recv();
 
-        // If one minute elapsed, check what we have to do
-        if (ANewMinute) {
-            ANewMinute = false;
-            // Decrement LastReceiveTimer for all channels every mn...
-            for (byte Channel = 0; Channel < ITPLUS_MAX_SENSORS; Channel++) {
-                if (ITPlusChannels[Channel].LastReceiveTimer != 0) ITPlusChannels[Channel].LastReceiveTimer--;
-            }
-            for (byte Channel = 0; Channel < ITPLUS_MAX_DISCOVER; Channel++) {
-                if (DiscoveredITPlus[Channel].LastReceiveTimer != 0) DiscoveredITPlus[Channel].LastReceiveTimer--;
-            }
+    RunTasks();
+    CheckSerialCommand();
 
-            PtData = CommonStrBuff;
-
-            // DataStream 1 to ITPLUS_MAX_SENSORS are IT+ Sensors
-            for (byte Channel = 0; Channel < ITPLUS_MAX_SENSORS; Channel++) {
-                if (ITPlusChannels[Channel].SensorID != 0xff) {  // Send only if registered
-                    if (ITPlusChannels[Channel].LastReceiveTimer != 0) {  // Send only if valid temp received
-                        //                        "0,-tt.dNL1,-tt.dNL2,-tt.dNL3,-tt.dNL0"
-                        PtData += sprintf(PtData, "%d,", Channel + 1);
-                        if (ITPlusChannels[Channel].Temp & 0x80)
-                            *PtData++ = '-';
-                        PtData += sprintf(PtData, "%d.%d\r\n", ITPlusChannels[Channel].Temp & 0x7f, ITPlusChannels[Channel].DeciTemp);
-                    }
-                }
-            }
+    // Debug output of the frames handled above, a few records at a time
+    // as printing blocks once the UART buffer is full.  Don't sleep while
+    // some are left.
+    if (EventLogDrain(EVENT_LOG_DRAIN) == EVENT_LOG_DRAIN)
+        return;
 
-            // Remove last CR/LF
-            *(PtData - 2) = 0;
-        }
+#ifdef LOOP_IDLE_SLEEP
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_mode();
+#endif
+}
+
+/***********************************************
+ * Timed tasks
+ ***********************************************/
 
-        //  CheckProcessBrowserRequest();
-        CheckRF12Recv();
+/*
+ * Run each task whose interval elapsed.  LastRun is advanced by the interval
+ * rather than set to now so the schedule doesn't drift.
+ */
+void
+RunTasks() {
+    unsigned long now = millis();
 
-        // Check error condition for signaling through LED
-        ErrorCondition = false;
-        for (byte Channel = 0; Channel < ITPLUS_MAX_SENSORS; Channel++) {
-            if (ITPlusChannels[Channel].SensorID != 0xff &&  // La Crosse receive OK check, only if registered
-                    ITPlusChannels[Channel].LastReceiveTimer == 0) {
-                ErrorCondition = true;
-                break;
-            }
+    for (byte i = 0; i < NB_TASKS; i++) {
+        if (now - Tasks[i].LastRun >= Tasks[i].Interval) {
+            Tasks[i].LastRun += Tasks[i].Interval;
+            Tasks[i].Run();
         }
-        /* xx Check removed as RF12 "enabling" was removed, always on error condition
-           if (!ErrorCondition) {
-           for (byte Channel = 0; Channel < MAX_JEENODE; Channel++) {
-           if (RF12Channels[Channel].LastReceiveTimer == 0) {  // RF12 receive OK check
-           ErrorCondition = true;
-           break;
-           }
-           }
-           }
-           */
+    }
+}
+
+void
+SecondTask() {
+    if (++Seconds == 60)
+        Seconds = 0;
 
+    // Lets the host rebase the micros() stamps of the frames, see SensorRecord.h
+    if (++Uptime % REC_SYNC_PERIOD == 0 && (BinaryOutput || AggregateOutput))
+        SendSyncRecord(Uptime);
+    if (AggregateOutput && Uptime % AggregateInterval == 0)
+        AggregateSend(micros());
 
-    }
+    // Check error condition for signaling through LED: La Crosse receive OK
+    // check, only for registered sensors
+    ErrorCondition = StalledSensors != 0;
+    /* xx Check removed as RF12 "enabling" was removed, always on error condition
+       if (!ErrorCondition) {
+       for (byte Channel = 0; Channel < MAX_JEENODE; Channel++) {
+       if (RF12Channels[Channel].LastReceiveTimer == 0) {  // RF12 receive OK check
+       ErrorCondition = true;
+       break;
+       }
+       }
+       }
+       */
+}
+
+void
+MinuteTask() {
+    Minutes++;
+
+    // Expire the receive timers of sensors we didn't hear from
+    ITPlusMinuteTick();
+
+#ifdef MINUTE_REPORT
+    byte Records = 0;
+    PrintITPlusRecords(Serial, &Records);
+    if (Records != 0)
+        Serial.println();
+#endif
+
+#ifdef RF12_DEBUG
+    uint32_t Overflows, Filtered;
+
+    // Updated by the interrupt handler, 4 bytes each
+    noInterrupts();
+    Overflows = rf12_ringOverflows;
+    Filtered = rf12_itplusFiltered;
+    interrupts();
+    serial_printf("Frames: %lu rcvd, %lu missed, %lu ring overflows, %lu filtered (%lu ms of receive saved)\n",
+            FramesReceived, FramesMissed, (unsigned long)Overflows, (unsigned long)Filtered,
+            (unsigned long)Filtered * (ITPLUS_FRAME_LEN - 2) * ITPLUS_BYTE_US / 1000);
+#endif
 }
 
 /***********************************************
  * Other Code
  ***********************************************/
 
+/*
+ * Single character commands from the host, some taking the number typed
+ * before them:
+ *   s   print the radio counters, see RadioStats.h
+ *   i   set the aggregation interval to that many seconds, see Aggregate.h
+ *   r   toggle the per frame output in aggregation mode
+ *   a   "<channel>,<id>a" registers the sensor id (0 to 63) on channel,
+ *       "<channel>a" frees it, saved to EEPROM
+ */
+void
+CheckSerialCommand() {
+    static word Number = 0, Channel = 0;
+    static boolean HasChannel = false;
+    int c;
+
+    while ((c = Serial.read()) >= 0) {
+        switch (c) {
+        case 's':
+            PrintRadioStats();
+            break;
+        case 'i':
+            if (Number != 0)
+                AggregateInterval = Number;
+            break;
+        case 'r':
+            RawOutput = !RawOutput;
+            EventLogEnabled = !BinaryOutput && FRAME_OUTPUT();
+            break;
+        case ',':
+            Channel = Number;
+            HasChannel = true;
+            break;
+        case 'a':
+            if (!HasChannel)
+                Channel = Number;
+            if (Channel < ITPLUS_MAX_SENSORS && (!HasChannel || Number <= ITPLUS_ID_MASK)) {
+                ITPlusRegister(Channel, HasChannel ? Number : 0xff);
+                ITPlusSaveRegistrations();
+            }
+            break;
+        }
+        if (c != ',' && (c < '0' || c > '9'))
+            HasChannel = false;
+        Number = c >= '0' && c <= '9' ? Number * 10 + c - '0' : 0;
+    }
+}
+
 /*
  * Init our RF12 module 
  */
@@ -137,22 +235,27 @@ RF12Init() {
 
 void 
 CheckRF12Recv() {
+    const byte *Frame;
+
+    // Drain every IT+ frame queued by the interrupt handler since last pass,
+    // the receiver was re-armed as soon as each one was complete
+    while ((Frame = rf12_itplusFrame()) != 0) {
+        FramesReceived++;
+        ProcessITPlusFrame(Frame, rf12_itplusStamp());  // Keep IT+ logic outside this source files
+        rf12_itplusRelease();
+    }
+
     if (rf12_recvDone()) {
         // If a "Receive Done" condition is signaled, we can safely use the RF12 library buffer up to the next call to
         // rf12_recvDone: RF12 tranceiver is held in idle state up to the next call.
-        // Is it IT+ or Jeenode frame ?
-        if (ITPlusFrame) {
-            ProcessITPlusFrame();  // Keep IT+ logic outside this source files
-        } else {
-            if (rf12_crc == 0) {  // Valid RF12 Jeenode frame received
+        if (rf12_crc == 0) {  // Valid RF12 Jeenode frame received
 #ifdef RF12_DEBUG
-                DebugPrint_P(PSTR("RF12 rcv: "));
-                for (byte i = 0; i < rf12_len; ++i) {
-                    Serial.print(rf12_data[i], HEX); Serial.print(' ');
-                }
-                Serial.println();
-#endif
+            DebugPrint_P(PSTR("RF12 rcv: "));
+            for (byte i = 0; i < rf12_len; ++i) {
+                Serial.print(rf12_data[i], HEX); Serial.print(' ');
             }
+            Serial.println();
+#endif
         }
     }
 }
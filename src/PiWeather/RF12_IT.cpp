@@ -11,6 +11,7 @@
 #include <WProgram.h> // Arduino 0022
 #endif
 #include "RF12_IT.h"
+#include "RadioStats.h"
 
 // #define OPTIMIZE_SPI 1  // uncomment this to write to the RFM12B @ 8 Mhz
 
@@ -103,6 +104,7 @@
 #define RF_TXREG_WRITE  0xB800
 #define RF_RX_FIFO_READ 0xB000
 #define RF_WAKEUP_TIMER 0xE000
+#define RF_FIFO_FILL    0x0002      // FIFO fill after sync, clear & set to restart sync detection
 
 // RF12 status bits
 #define RF_LBD_BIT      0x0400
@@ -124,6 +126,19 @@ static uint8_t nodeid;              // address of this node
 static uint8_t group;               // network group
 static volatile uint8_t rxfill;     // number of data bytes in rf12_buf
 static volatile int8_t rxstate;     // current transceiver state
+static uint16_t fifoCmd;            // FIFO and reset mode command in use
+
+// Completed IT+ frames, filled by rf12_interrupt() at ringHead and drained by
+// loop() at ringTail.  Each index has a single writer, so no locking needed.
+#define RING_MASK   (ITPLUS_RX_RING - 1)
+static volatile uint8_t ring[ITPLUS_RX_RING][ITPLUS_FRAME_LEN];
+static volatile uint32_t ringStamp[ITPLUS_RX_RING];
+static volatile uint8_t ringHead, ringTail;
+volatile uint32_t rf12_ringOverflows;
+
+// Sensor IDs to queue frames for, all if 0, see rf12_itplusFilter()
+static const uint8_t *idFilter;
+volatile uint32_t rf12_itplusFiltered;
 
 #define RETRIES     8               // stop retrying after 8 times
 #define RETRY_MS    1000            // resend packet every second until ack'ed
@@ -249,8 +264,16 @@ rf12_control(uint16_t cmd) {
     return r;
 }
 
-static void 
-rf12_interrupt() {
+// restart sync pattern detection, the receiver stays on
+static void
+rf12_rearm() {
+    rxfill = 0;
+    rf12_xfer(fifoCmd & ~RF_FIFO_FILL);
+    rf12_xfer(fifoCmd);
+}
+
+static inline void
+rf12_service() {
     // a transfer of 2x 16 bits @ 2 MHz over SPI takes 2x 8 us inside this ISR
     // correction: now takes 2 + 8 µs, since sending can be done at 8 MHz
     rf12_xfer(0x0000);
@@ -266,29 +289,56 @@ rf12_interrupt() {
             else
                 ITPlusFrame = false;
         }
-
-#ifdef INCLUDE_JEENODE
-        if (rxfill == 0 && group != 0 && !ITPlusFrame) /* GCR : added  && !ITPlusFrame */
-            rf12_buf[rxfill++] = group;
-#endif
-        rf12_buf[rxfill++] = in;
+        if (rxfill == 0) {
+            if (ITPlusFrame)
+                STAT_INC(ITPlusFrames);
+            else
+                STAT_INC(OtherFrames);
+        }
 
         if (ITPlusFrame) {
-            if (rxfill == 5) {	// IT+ Frames always has 5 bytes
-                rf12_xfer(RF_IDLE_MODE);
+            if (rxfill == 0 && ((ringHead + 1) & RING_MASK) == ringTail) {
+                // loop() is late and the ring is full, drop this frame
+                rf12_ringOverflows++;
+                rf12_rearm();
+                return;
+            }
+            if (rxfill == 0) {
+                // Interrupts are off, micros() accounts for a pending
+                // timer0 overflow
+                ringStamp[ringHead] = micros();
+            }
+            ring[ringHead][rxfill++] = in;
+            if (rxfill == 2 && idFilter != 0 && !rf12_itplusAccept(idFilter, ring[ringHead][0], in)) {
+                // The sensor ID is complete and not one we want, skip the
+                // 3 bytes left of the frame
+                rf12_itplusFiltered++;
+                rf12_rearm();
+            } else if (rxfill == ITPLUS_FRAME_LEN) {
+                // Hand the frame over and listen for the next one right away,
+                // CRC will be computed later
+                ringHead = (ringHead + 1) & RING_MASK;
+                rf12_rearm();
             }
-            // CRC will be computed later
-        } 
+        }
 #ifdef INCLUDE_JEENODE
         else {
+            if (rxfill == 0 && group != 0)
+                rf12_buf[rxfill++] = group;
+            rf12_buf[rxfill++] = in;
             rf12_crc = _crc16_update(rf12_crc, in);
 
             if (rxfill >= rf12_len + 5 || rxfill >= RF_MAX) {
                 rf12_xfer(RF_IDLE_MODE);
             }
-        } 
+        }
+#else
+        else {
+            // Not an IT+ frame and JeeNode support not compiled in
+            rf12_rearm();
+        }
 #endif
-    } 
+    }
 #ifdef INCLUDE_JEENODE
     else {
         uint8_t out;
@@ -312,6 +362,20 @@ rf12_interrupt() {
 #endif
 }
 
+static void
+rf12_interrupt() {
+#ifdef RADIO_STATS
+    // Timer1 counts CPU cycles, see rf12_initialize()
+    uint16_t start = TCNT1;
+
+    rf12_service();
+    STAT_INC(IsrCalls);
+    STAT_ADD(IsrCycles, (uint16_t)(TCNT1 - start));
+#else
+    rf12_service();
+#endif
+}
+
 #if PINCHG_IRQ
 #if RFM_IRQ < 8
 ISR(PCINT2_vect) {
@@ -345,15 +409,9 @@ rf12_recvStart() {
 
 uint8_t 
 rf12_recvDone() {
-    // Two different receive conditions depending on frame type RFM12/Jeenode or RFM01/IT+
-    if (ITPlusFrame) {
-        if (rxstate == TXRECV && rxfill == 5) {	// IT+ Frames always has 5 bytes
-            rxstate = TXIDLE;
-            return 1;	// Got full IT+ frame
-        }
-    } 
+    // IT+ frames are queued by the interrupt handler, see rf12_itplusFrame()
 #ifdef INCLUDE_JEENODE 
-    else {	// RFM12/Jeenode normal processing
+    if (!ITPlusFrame) {	// RFM12/Jeenode normal processing
         if (rxstate == TXRECV && (rxfill >= rf12_len + 5 || rxfill >= RF_MAX)) {
             rxstate = TXIDLE;
             if (rf12_len > RF12_MAXDATA) {
@@ -378,6 +436,32 @@ rf12_recvDone() {
     return 0;
 }
 
+const uint8_t *
+rf12_itplusFrame() {
+    if (ringTail == ringHead)
+        return 0;
+    return (const uint8_t *) ring[ringTail];
+}
+
+uint32_t
+rf12_itplusStamp() {
+    return ringStamp[ringTail];
+}
+
+void
+rf12_itplusRelease() {
+    ringTail = (ringTail + 1) & RING_MASK;
+}
+
+void
+rf12_itplusFilter(const uint8_t *Ids) {
+    // A pointer is 2 bytes on AVR
+    uint8_t sreg = SREG;
+    cli();
+    idFilter = Ids;
+    SREG = sreg;
+}
+
 #ifdef INCLUDE_RF12_SEND
 uint8_t 
 rf12_canSend() {
@@ -472,10 +556,12 @@ rf12_initialize(uint8_t id, uint8_t band, uint8_t g) {
     rf12_xfer(0x94A2); // VDI,FAST,134kHz,0dBm,-91dBm 
     rf12_xfer(0xC2AC); // AL,!ml,DIG,DQD4 
     if (group != 0) {
-        rf12_xfer(0xCA83); // FIFO8,2-SYNC,!ff,DR 
+        fifoCmd = 0xCA83; // FIFO8,2-SYNC,!ff,DR 
+        rf12_xfer(fifoCmd);
         rf12_xfer(0xCE00 | group); // SYNC=2DXX； 
     } else {
-        rf12_xfer(0xCA8B); // FIFO8,1-SYNC,!ff,DR 
+        fifoCmd = 0xCA8B; // FIFO8,1-SYNC,!ff,DR 
+        rf12_xfer(fifoCmd);
         rf12_xfer(0xCE2D); // SYNC=2D； 
     }
     rf12_xfer(0xC483); // @PWR,NO RSTRIC,!st,!fi,OE,EN 
@@ -485,6 +571,13 @@ rf12_initialize(uint8_t id, uint8_t band, uint8_t g) {
     rf12_xfer(0xC800); // NOT USE 
     rf12_xfer(0xC049); // 1.66MHz,3.1V 
 
+#ifdef RADIO_STATS
+    // Timer1 free running at the CPU clock, to count the cycles spent in
+    // rf12_interrupt().  This takes away its PWM pins (9 and 10).
+    TCCR1A = 0;
+    TCCR1B = _BV(CS10);
+#endif
+
     rxstate = TXIDLE;
 #if PINCHG_IRQ
 #if RFM_IRQ < 8
@@ -639,6 +732,8 @@ rf12_easyPoll() {
         }
     }
     return ezPending ? -1 : 0;
+#else
+    return 0;
 #endif
 }
 
@@ -25,6 +25,8 @@
 
 #define RF12_MAXDATA    66
 
+#define ITPLUS_FRAME_LEN 5          // IT+ frames always have 5 bytes
+
 #define RF12_433MHZ     1
 #define RF12_868MHZ     2
 #define RF12_915MHZ     3
@@ -47,6 +49,11 @@
 extern volatile uint16_t rf12_crc;  // running crc value, should be zero at end
 extern volatile uint8_t rf12_buf[]; // recv/xmit buf including hdr & crc bytes
 extern long rf12_seq;               // seq number of encrypted packet (or -1)
+extern volatile uint32_t rf12_ringOverflows; // IT+ frames dropped, receive ring was full
+extern volatile uint32_t rf12_itplusFiltered; // IT+ frames cut short by rf12_itplusFilter()
+
+// IT+ bytes at 17.241 kbps, for the receive time saved by rf12_itplusFilter()
+#define ITPLUS_BYTE_US   464
 
 // only needed if you want to init the SPI bus before rf12_initialize does it
 void rf12_spiInit(void);
@@ -61,9 +68,31 @@ void rf12_initialize_overide_ITP (uint16_t speed);
 // returns the node ID as 1..31 value (1..26 correspond to nodes 'A'..'Z')
 uint8_t rf12_config(uint8_t show =1);
 
-// call this frequently, returns true if a packet has been received
+// call this frequently, returns true if a JeeNode packet has been received
 uint8_t rf12_recvDone(void);
 
+// oldest IT+ frame queued by the interrupt handler (ITPLUS_FRAME_LEN bytes),
+// or 0 if none.  The frame stays valid until rf12_itplusRelease() is called.
+const uint8_t *rf12_itplusFrame(void);
+// micros() when the first byte of that frame came in
+uint32_t rf12_itplusStamp(void);
+void rf12_itplusRelease(void);
+
+// only queue IT+ frames whose sensor ID has its bit set in the 64 bits of Ids
+// (ID 0 is bit 0 of Ids[0]), or all of them when Ids is 0.  The interrupt
+// handler checks the ID after the second byte and re-arms the receiver right
+// away for the others.  Ids is read from the interrupt handler, update it a
+// byte at a time.
+void rf12_itplusFilter(const uint8_t *Ids);
+
+// whether the first two bytes of an IT+ frame pass the filter Ids
+static inline uint8_t
+rf12_itplusAccept(const uint8_t *Ids, uint8_t Byte0, uint8_t Byte1) {
+    uint8_t id = ((Byte0 & 0x0f) << 2) | (Byte1 >> 6);
+
+    return Ids[id >> 3] & (1 << (id & 7));
+}
+
 #ifdef INCLUDE_RF12_SEND
 // call this to check whether a new transmission can be started
 // returns true when a new transmission may be started with rf12_sendStart()
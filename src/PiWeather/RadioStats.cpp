@@ -0,0 +1,38 @@
+/*
+ * Radio receive and IT+ decode path counters, see RadioStats.h
+ */
+
+#include "Arduino.h"
+#include "PiWeather.h"
+#include "RadioStats.h"
+#include "Misc.h"
+
+#ifdef RADIO_STATS
+volatile Type_RadioStats RadioStats;
+
+void
+PrintRadioStats() {
+    Type_RadioStats Copy;
+    uint32_t Overflows, Filtered;
+
+    // The interrupt handler updates the first counters, take them at once
+    noInterrupts();
+    Copy = *(Type_RadioStats *)&RadioStats;
+    Overflows = rf12_ringOverflows;
+    Filtered = rf12_itplusFiltered;
+    interrupts();
+
+    // serial_printf() lines are limited to 128 chars
+    serial_printf("Stats: isr=%lu cyc=%lu itp=%lu jee=%lu crc=%lu len=%lu ", (unsigned long)Copy.IsrCalls,
+            (unsigned long)Copy.IsrCycles, (unsigned long)Copy.ITPlusFrames, (unsigned long)Copy.OtherFrames,
+            (unsigned long)Copy.CrcErrors, (unsigned long)Copy.BadLength);
+    serial_printf("ovf=%lu flt=%lu hit=%lu known=%lu new=%lu evict=%lu\n", (unsigned long)Overflows,
+            (unsigned long)Filtered, (unsigned long)Copy.RegistryHits, (unsigned long)Copy.RegistryKnown,
+            (unsigned long)Copy.RegistryNew, (unsigned long)Copy.RegistryEvictions);
+}
+#else
+void
+PrintRadioStats() {
+    DebugPrintln_P(PSTR("Stats: off"));
+}
+#endif
@@ -0,0 +1,54 @@
+#ifndef RadioStats_H
+#define RadioStats_H
+
+#include "Arduino.h"
+#include "PiWeather.h"
+
+/*
+ * Counters of the radio receive and IT+ decode path, with RADIO_STATS
+ * defined in PiWeather.h.  Each one is a plain RAM increment of a few
+ * cycles, from the interrupt handler or loop().  They are 32 bits, as 16
+ * bits counting every frame wrap within hours with a few sensors around,
+ * and readers look at the difference between two dumps, cyc wrapping in a
+ * few hours of a busy channel.  Without RADIO_STATS the STAT_* macros
+ * compile to nothing.
+ *
+ * PrintRadioStats() sends them as one line, on the serial 's' command:
+ *
+ *   Stats: isr=812 cyc=117301 itp=310 jee=2 crc=6 len=0 ovf=0 flt=0 hit=280 known=20 new=4 evict=0
+ *
+ *   isr, cyc       rf12_interrupt() calls and CPU cycles spent in it
+ *   itp, jee       frames classified as IT+ or JeeNode/other on their first byte
+ *   crc, len       IT+ frames failing the CRC, or with a length nibble other than 9
+ *   ovf, flt       IT+ frames dropped as the receive ring was full (rf12_ringOverflows),
+ *                  or cut short by rf12_itplusFilter() (rf12_itplusFiltered)
+ *   hit, known,    CheckITPlusRegistration() lookups: registered sensor, known
+ *   new, evict     discovered sensor, new discovered sensor, which evicted another
+ */
+
+#ifdef RADIO_STATS
+typedef struct {
+    uint32_t IsrCalls;
+    uint32_t IsrCycles;
+    uint32_t ITPlusFrames;
+    uint32_t OtherFrames;
+    uint32_t CrcErrors;
+    uint32_t BadLength;
+    uint32_t RegistryHits;
+    uint32_t RegistryKnown;
+    uint32_t RegistryNew;
+    uint32_t RegistryEvictions;
+} Type_RadioStats;
+
+extern volatile Type_RadioStats RadioStats;
+
+#define STAT_INC(Counter)       (RadioStats.Counter++)
+#define STAT_ADD(Counter, n)    (RadioStats.Counter += (n))
+#else
+#define STAT_INC(Counter)       do {} while (0)
+#define STAT_ADD(Counter, n)    do {} while (0)
+#endif
+
+void PrintRadioStats();
+
+#endif
@@ -0,0 +1,72 @@
+/**
+ * Binary output mode records, see BinaryOutput.cpp.  Also used by the host
+ * side decoder, so only relies on stdint.h.
+ *
+ * Each record is COBS encoded, so it contains no 0 byte, and sent between
+ * two 0 delimiters.  Anything else on the link (debug text) ends up between
+ * delimiters too and is rejected by the length and CRC checks.
+ *
+ * Record layouts, multi-byte fields little endian:
+ *   0       record type, REC_SENSOR
+ *   1       sensor id, 6 bits
+ *   2       REC_FLAG_*
+ *   3-4     temperature in tenths of degree Celsius, int16_t
+ *   5       hygro in %, or 100 and up for sensors without hygrometer
+ *   6-9     micros() when the first byte of the frame was received
+ *   10      CRC-8 of bytes 0-9, IT+ polynomial (see ITPlusCRC.h)
+ *
+ * When REC_FLAG_CRC_OK is clear the frame was corrupted and only the
+ * timestamp is meaningful.
+ *
+ *   0       record type, REC_SYNC
+ *   1-4     micros() when the record was sent
+ *   5-8     seconds since reset
+ *   9       0
+ *   10      CRC-8 of bytes 0-9
+ *
+ * Sync records are sent every REC_SYNC_PERIOD seconds, so that the host can
+ * follow micros() across its wraps (every 71 minutes) and rebase the frame
+ * timestamps to its own clock.
+ *
+ *   0       record type, REC_SUMMARY
+ *   1       sensor id
+ *   2       REC_FLAG_CRC_OK and the REC_FLAG_* of any of the frames
+ *   3-4     interval in seconds
+ *   5-6     number of frames
+ *   7-8     minimum temperature, int16_t
+ *   9-10    maximum temperature, int16_t
+ *   11-14   sum of the temperatures, int32_t
+ *   15      minimum hygro
+ *   16      maximum hygro
+ *   17-20   sum of the hygros
+ *   21-24   micros() at the end of the interval
+ *   25      CRC-8 of bytes 0-24
+ *
+ * Summary records are sent in aggregation mode at the end of each interval,
+ * for each registered sensor, heard or not (no frames, the rest is 0).
+ */
+
+#ifndef SensorRecord_H
+#define SensorRecord_H
+
+#include <stdint.h>
+
+#define REC_SENSOR          1
+#define REC_SYNC            2
+#define REC_SUMMARY         3
+#define REC_SENSOR_LEN      11      // REC_SYNC too
+#define REC_SUMMARY_LEN     26
+#define REC_MAX_LEN         REC_SUMMARY_LEN
+#define REC_SYNC_PERIOD     10
+
+#define REC_FLAG_CRC_OK     0x01
+#define REC_FLAG_RESTART    0x02    // Sensor is in its peering period after a battery change
+#define REC_FLAG_MISC       0x04
+#define REC_FLAG_WEAK_BATT  0x08
+
+#define REC_DELIMITER       0x00
+
+// COBS adds one byte to records shorter than 254 bytes
+#define COBS_LEN(n)         ((n) + 1)
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * Sensor receive timeouts, kept in a two level timing wheel so that the
+ * per-minute housekeeping only touches the timers that actually expire.
+ *
+ * Timers are keyed on their absolute expiry minute.  Level 0 has one slot per
+ * minute of the current 16 minutes block, level 1 one slot per 16 minutes
+ * block.  When a new block starts, its level 1 slot is moved down to level 0.
+ * Timeouts can be up to 255 minutes.
+ */
+
+#include "SensorTimer.h"
+
+#define WHEEL_BITS  4
+#define WHEEL_SIZE  (1 << WHEEL_BITS)
+#define WHEEL_MASK  (WHEEL_SIZE - 1)
+#define NO_TIMER    0xff
+
+static word Now;                            // minutes since SensorTimerInit()
+static byte Wheel[2 * WHEEL_SIZE];          // list heads, level 0 then level 1
+static byte Next[SENSOR_TIMERS], Prev[SENSOR_TIMERS];
+static byte Slot[SENSOR_TIMERS];            // Wheel index the timer is in, or NO_TIMER
+static word Expiry[SENSOR_TIMERS];
+
+void
+SensorTimerInit() {
+    Now = 0;
+    for (byte i = 0; i < 2 * WHEEL_SIZE; i++)
+        Wheel[i] = NO_TIMER;
+    for (byte i = 0; i < SENSOR_TIMERS; i++)
+        Slot[i] = NO_TIMER;
+}
+
+static void
+Insert(byte Timer) {
+    byte s;
+
+    if ((Expiry[Timer] >> WHEEL_BITS) == (Now >> WHEEL_BITS))
+        s = Expiry[Timer] & WHEEL_MASK;
+    else
+        s = WHEEL_SIZE + ((Expiry[Timer] >> WHEEL_BITS) & WHEEL_MASK);
+
+    Slot[Timer] = s;
+    Prev[Timer] = NO_TIMER;
+    Next[Timer] = Wheel[s];
+    if (Wheel[s] != NO_TIMER)
+        Prev[Wheel[s]] = Timer;
+    Wheel[s] = Timer;
+}
+
+void
+SensorTimerCancel(byte Timer) {
+    if (Slot[Timer] == NO_TIMER)
+        return;
+    if (Prev[Timer] != NO_TIMER)
+        Next[Prev[Timer]] = Next[Timer];
+    else
+        Wheel[Slot[Timer]] = Next[Timer];
+    if (Next[Timer] != NO_TIMER)
+        Prev[Next[Timer]] = Prev[Timer];
+    Slot[Timer] = NO_TIMER;
+}
+
+/*
+ * (Re)start Timer to expire Minutes from now, Minutes must be 1..255
+ */
+void
+SensorTimerSet(byte Timer, byte Minutes) {
+    SensorTimerCancel(Timer);
+    Expiry[Timer] = Now + Minutes;
+    Insert(Timer);
+}
+
+/*
+ * Minutes left before Timer expires, 0 if expired or never set
+ */
+byte
+SensorTimerLeft(byte Timer) {
+    if (Slot[Timer] == NO_TIMER)
+        return 0;
+    return Expiry[Timer] - Now;
+}
+
+/*
+ * To be called once a minute.  Expired is called for each timer reaching 0.
+ */
+void
+SensorTimerTick(void (*Expired)(byte Timer)) {
+    byte Timer, NextTimer;
+
+    Now++;
+
+    if ((Now & WHEEL_MASK) == 0) {
+        // New block: move its timers down to level 0
+        Timer = Wheel[WHEEL_SIZE + ((Now >> WHEEL_BITS) & WHEEL_MASK)];
+        Wheel[WHEEL_SIZE + ((Now >> WHEEL_BITS) & WHEEL_MASK)] = NO_TIMER;
+        for (; Timer != NO_TIMER; Timer = NextTimer) {
+            NextTimer = Next[Timer];
+            Insert(Timer);
+        }
+    }
+
+    Timer = Wheel[Now & WHEEL_MASK];
+    Wheel[Now & WHEEL_MASK] = NO_TIMER;
+    for (; Timer != NO_TIMER; Timer = NextTimer) {
+        NextTimer = Next[Timer];
+        Slot[Timer] = NO_TIMER;
+        Expired(Timer);
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef SensorTimer_H
+#define SensorTimer_H
+
+#include <Arduino.h>
+#include "PiWeather.h"
+
+// One timer per ITPlusChannels entry, then one per DiscoveredITPlus entry
+#define SENSOR_TIMERS        (ITPLUS_MAX_SENSORS + ITPLUS_MAX_DISCOVER)
+#define CHANNEL_TIMER(i)     (i)
+#define DISCOVERED_TIMER(i)  (ITPLUS_MAX_SENSORS + (i))
+
+void SensorTimerInit();
+void SensorTimerSet(byte Timer, byte Minutes);
+void SensorTimerCancel(byte Timer);
+byte SensorTimerLeft(byte Timer);
+void SensorTimerTick(void (*Expired)(byte Timer));
+
+#endif
@@ -0,0 +1,121 @@
+/*
+ * Check of the DataLogger DS1820 state machine (DS1820.pde) against the
+ * simulated 1-Wire bus of shim/OneWire.h, the sketch file being compiled
+ * as is into this program.
+ *
+ *   datalogger-ds1820
+ *
+ * Steps Start1820Tmp() and Poll1820Tmp() through a missing sensor, a
+ * conversion polled before its 750 ms are over, its scratchpad read and
+ * converted, then a scratchpad failing its CRC and a sensor unplugged
+ * during the conversion, which must both leave the last temperature as it
+ * was.
+ */
+
+#include "Arduino.h"
+#include "OneWire.h"
+
+void DebugPrint_P(const char *s) { Serial.print(s); }
+void DebugPrintln_P(const char *s) { Serial.println(s); }
+
+#include "DS1820.pde"
+
+static unsigned Errors;
+
+static void
+Check(bool ok, const char *what) {
+    if (!ok) {
+        printf("%s: failed\n", what);
+        Errors++;
+    }
+}
+
+// DS18B20 scratchpad for a temperature in 1/16 C, with its CRC
+static void
+SetScratchpad(int16_t Sixteenths) {
+    uint8_t *sp = HostOneWire.scratchpad;
+
+    sp[0] = Sixteenths & 0xff;
+    sp[1] = Sixteenths >> 8;
+    sp[2] = 0x4b;           // TH, TL and configuration: power up values
+    sp[3] = 0x46;
+    sp[4] = 0x7f;
+    sp[5] = 0xff;
+    sp[6] = 0x0c;
+    sp[7] = 0x10;
+    sp[8] = OneWire::crc8(sp, 8);
+}
+
+// Poll from loop() every ms up to Until, stopping when the sensor is read
+static void
+PollUntil(unsigned long Until) {
+    unsigned reads = HostOneWire.scratchpadReads;
+
+    while (millis() < Until && HostOneWire.scratchpadReads == reads) {
+        Poll1820Tmp();
+        HostClockSet((millis() + 1) * 1000ULL);
+    }
+}
+
+int
+main() {
+    unsigned long start;
+
+    HostClockSet(1000000);
+    Serial.setSink(NULL);
+
+    // Nothing answers the reset
+    HostOneWire.present = false;
+    Start1820Tmp();
+    Check(DS1820State == DS1820_IDLE && HostOneWire.conversions == 0, "no sensor");
+    Poll1820Tmp();
+    Check(HostOneWire.scratchpadReads == 0, "no sensor, poll");
+
+    // Start, the bus left powered for the conversion
+    HostOneWire.present = true;
+    HostOneWire.converting = true;
+    SetScratchpad(25 * 16 + 8);     // 25.5 C
+    start = millis();
+    Start1820Tmp();
+    Check(DS1820State == DS1820_CONVERTING && HostOneWire.conversions == 1 && HostOneWire.power, "start");
+
+    // Not ready: no second conversion, nothing read before 750 ms
+    Start1820Tmp();
+    Check(HostOneWire.conversions == 1, "start while converting");
+    PollUntil(start + DS1820_CONVERSION_MS - 1);
+    Check(DS1820State == DS1820_CONVERTING && HostOneWire.scratchpadReads == 0, "not ready");
+
+    // Ready: over at 750 ms, read on the next loop()
+    HostOneWire.converting = false;
+    HostClockSet((start + DS1820_CONVERSION_MS) * 1000ULL);
+    Poll1820Tmp();
+    Check(DS1820State == DS1820_READ && HostOneWire.scratchpadReads == 0, "ready");
+    Poll1820Tmp();
+    Check(DS1820State == DS1820_IDLE && HostOneWire.scratchpadReads == 1, "read");
+    Check(CentralTempSignBit == 0 && CentralTempWhole == 25 && CentralTempFract == 5, "temperature");
+    Poll1820Tmp();
+    Check(HostOneWire.scratchpadReads == 1, "idle after the read");
+
+    // CRC error: the temperature is kept, the next conversion can start
+    start = millis();
+    SetScratchpad(12 * 16);
+    HostOneWire.scratchpad[8] ^= 0x01;
+    Start1820Tmp();
+    PollUntil(start + 2 * DS1820_CONVERSION_MS);
+    Poll1820Tmp();
+    Check(HostOneWire.scratchpadReads == 2 && DS1820State == DS1820_IDLE, "CRC error, read");
+    Check(CentralTempWhole == 25 && CentralTempFract == 5, "CRC error, temperature kept");
+    Start1820Tmp();
+    Check(HostOneWire.conversions == 3, "start after a CRC error");
+
+    // Unplugged during the conversion: nothing read, the temperature kept
+    start = millis();
+    HostOneWire.present = false;
+    PollUntil(start + 2 * DS1820_CONVERSION_MS);
+    Poll1820Tmp();
+    Check(HostOneWire.scratchpadReads == 2 && DS1820State == DS1820_IDLE, "unplugged, not read");
+    Check(CentralTempWhole == 25 && CentralTempFract == 5, "unplugged, temperature kept");
+
+    printf("%u errors\n", Errors);
+    return Errors != 0;
+}
@@ -0,0 +1,422 @@
+/*
+ * EEPROM configuration store benchmark of the DataLogger, on the emulated
+ * EEPROM of shim/avr/eeprom.h.
+ *
+ *   datalogger-eeprom [edits] [cuts] [seed]
+ *       Apply edits (default 100000) web interface edits to the
+ *       configuration, a reboot after each checking the configuration
+ *       loads back, then cuts (default 10000) edits each interrupted by a
+ *       power cut after a random number of writes.  This runs once with the
+ *       former layout (config struct rewritten whole, 8 bits additive
+ *       checksum of the EEPROM) and once with the journal of ConfigStore.h,
+ *       reporting the writes and reads per edit, the wear of the most
+ *       written cell, the reads per boot and what the boots after a power
+ *       cut found.  Then migrates 200 configurations of the former layout
+ *       to the journal, each twice: once whole, once cut by a power cut
+ *       after a random number of writes.
+ *
+ * The journal side runs the ConfigLayout.h code LoadConfig() and
+ * SaveConfig() of Misc.pde call.  The former layout and the string setting
+ * code of Network.pde are mirrored here, the sketch not building on the
+ * host.  Times
+ * are those of an ATmega328 at 16 MHz: 3.3 ms per write, about 1 us per
+ * read and 1.5 us per byte of CRC-16 with _crc_xmodem_update().  The boot
+ * reads count what LoadConfig() reads, not the strings read back to check
+ * them.
+ */
+
+#include "../DataLogger_ITPlus/ConfigLayout.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WRITE_MS        3.3
+#define READ_US         1.0
+#define CRC_US          1.5
+
+// Type_Config of DataloggerDefs.h with ITPLUS_MAX_SENSORS 5
+#define CONFIG_LEN      18
+#define CONFIG_PERIOD   12
+#define CONFIG_IDS      13
+#define MAX_SENSORS     5
+
+// SRV_HOST_EEPROM, SRV_URL_EEPROM and SRV_HDR_EEPROM
+#define STRINGS         3
+static const unsigned stringLen[STRINGS] = { CONFIG_HOST_LEN, CONFIG_URL_LEN, CONFIG_HDR_LEN };
+
+static const uint8_t defaultConfig[CONFIG_LEN] = {
+    192, 168, 1, 5, 192, 168, 1, 1, 0, 0, 0, 0, 15, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
+struct Settings {
+    uint8_t config[CONFIG_LEN];
+    char strings[STRINGS][91];
+};
+
+static bool
+SameConfig(const Settings &a, const Settings &b) {
+    return memcmp(a.config, b.config, CONFIG_LEN) == 0;
+}
+
+static bool
+SameSettings(const Settings &a, const Settings &b) {
+    for (unsigned w = 0; w < STRINGS; w++) {
+        if (strcmp(a.strings[w], b.strings[w]) != 0)
+            return false;
+    }
+    return SameConfig(a, b);
+}
+
+static void
+DefaultSettings(Settings &s) {
+    memset(&s, 0, sizeof(s));
+    memcpy(s.config, defaultConfig, CONFIG_LEN);
+}
+
+class Layout {
+public:
+    virtual ~Layout() {}
+    virtual const char *name() const = 0;
+    // LoadConfig(), false if the EEPROM was reinitialized.  Only the config struct is read.
+    virtual bool load(Settings &s) = 0;
+    virtual void readStrings(Settings &s) const = 0;
+    virtual void save(const Settings &s) = 0;
+    virtual void setString(Settings &s, unsigned which, const char *text) = 0;
+    virtual double crcUsPerRead() const = 0;
+
+protected:
+    // The strings are in front in both layouts
+    uint8_t *stringAddr(unsigned which, unsigned base) const {
+        for (unsigned i = 0; i < which; i++)
+            base += stringLen[i];
+        return (uint8_t *)(uintptr_t)base;
+    }
+
+    void readStrings(Settings &s, unsigned base) const {
+        for (unsigned w = 0; w < STRINGS; w++) {
+            uint8_t *pt = stringAddr(w, base);
+            unsigned i;
+
+            for (i = 0; i < stringLen[w] && (s.strings[w][i] = eeprom_read_byte(pt + i)) != 0; i++)
+                ;
+            s.strings[w][i] = 0;
+        }
+    }
+};
+
+/*
+ * The former layout: config struct, strings, then a checksum of all that
+ * (CONFIG_CKS_EEPROM).
+ */
+class AdditiveLayout : public Layout {
+public:
+    const char *name() const { return "additive"; }
+    double crcUsPerRead() const { return 0; }
+    void readStrings(Settings &s) const { Layout::readStrings(s, CONFIG_LEN); }
+
+    bool load(Settings &s) {
+        uint8_t cks = CKS_INIT_SEED;
+
+        for (unsigned i = 0; i < CKS_ADDR; i++)
+            cks += eeprom_read_byte((uint8_t *)(uintptr_t)i);
+        if (cks != eeprom_read_byte((uint8_t *)CKS_ADDR)) {
+            DefaultSettings(s);
+            for (unsigned w = 0; w < STRINGS; w++)
+                eeprom_write_byte(stringAddr(w, CONFIG_LEN), 0);
+            save(s);
+            return false;
+        }
+        for (unsigned i = 0; i < CONFIG_LEN; i++)
+            s.config[i] = eeprom_read_byte((uint8_t *)(uintptr_t)i);
+        return true;
+    }
+
+    void save(const Settings &s) {
+        for (unsigned i = 0; i < CONFIG_LEN; i++)
+            eeprom_write_byte((uint8_t *)(uintptr_t)i, s.config[i]);
+        writeCks();
+    }
+
+    void setString(Settings &s, unsigned which, const char *text) {
+        uint8_t *pt = stringAddr(which, CONFIG_LEN);
+        unsigned i;
+
+        for (i = 0; text[i] != 0 && i < stringLen[which] - 1; i++)
+            eeprom_write_byte(pt + i, text[i]);
+        eeprom_write_byte(pt + i, 0);
+        writeCks();
+        memcpy(s.strings[which], text, i);
+        s.strings[which][i] = 0;
+    }
+
+private:
+    enum { CKS_INIT_SEED = 33, CKS_ADDR = CONFIG_LEN + CONFIG_HOST_LEN + CONFIG_URL_LEN + CONFIG_HDR_LEN };
+
+    void writeCks() {
+        uint8_t cks = CKS_INIT_SEED;
+
+        for (unsigned i = 0; i < CKS_ADDR; i++)
+            cks += eeprom_read_byte((uint8_t *)(uintptr_t)i);
+        eeprom_write_byte((uint8_t *)CKS_ADDR, cks);
+    }
+};
+
+// The strings, then the journal of Type_ConfigRecord, see ConfigLayout.h
+class JournalLayout : public Layout {
+public:
+    JournalLayout() : migrated(false) {
+        layout.Journal.Base = ConfigAddr(JOURNAL_ADDR);
+        layout.Journal.Slots = SLOTS;
+        layout.Journal.Size = RECORD_LEN;
+        layout.Journal.Seed = SEED;
+        layout.Strings = 0;
+        for (unsigned w = 0; w < STRINGS; w++)
+            layout.StringLen[w] = stringLen[w];
+    }
+
+    const char *name() const { return "journal"; }
+    double crcUsPerRead() const { return CRC_US; }
+    void readStrings(Settings &s) const { Layout::readStrings(s, 0); }
+
+    // As LoadConfig(), migrated telling the configuration came from the former layout
+    bool load(Settings &s) {
+        uint8_t record[RECORD_LEN];
+        uint8_t result = ConfigLoad(&layout, record);
+
+        migrated = result == CONFIG_MIGRATED;
+        if (result == CONFIG_NONE) {
+            DefaultSettings(s);
+            ConfigClearStrings(&layout);
+            save(s);
+            return false;
+        }
+        memcpy(s.config, record, CONFIG_LEN);
+        return true;
+    }
+
+    void save(const Settings &s) {
+        uint8_t record[RECORD_LEN];
+
+        memcpy(record, s.config, CONFIG_LEN);
+        ConfigSave(&layout, record);
+    }
+
+    void setString(Settings &s, unsigned which, const char *text) {
+        uint8_t *pt = stringAddr(which, 0);
+        unsigned i;
+
+        for (i = 0; text[i] != 0 && i < stringLen[which] - 1; i++)
+            ConfigUpdateByte(pt + i, text[i]);
+        ConfigUpdateByte(pt + i, 0);
+        memcpy(s.strings[which], text, i);
+        s.strings[which][i] = 0;
+        save(s);
+    }
+
+    bool migrated;
+
+private:
+    enum { SLOTS = CONFIG_SLOTS, RECORD_LEN = CONFIG_LEN + 2, SEED = 0x3321,
+           JOURNAL_ADDR = CONFIG_HOST_LEN + CONFIG_URL_LEN + CONFIG_HDR_LEN };
+
+    ConfigLayout layout;
+};
+
+// xorshift64*
+static uint64_t
+Random(uint64_t &state) {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545f4914f6cdd1dULL;
+}
+
+/*
+ * One edit from the web interface, as the handlers of Network.pde do it:
+ * registering or removing sensors most of the time, sometimes the period,
+ * the local address or a server string, or the same value sent again.
+ */
+static void
+Edit(Layout &layout, Settings &s, uint64_t &state) {
+    unsigned kind = Random(state) % 100;
+
+    if (kind < 45) {
+        s.config[CONFIG_IDS + Random(state) % MAX_SENSORS] = Random(state) % 3 ? Random(state) % 64 : 0xff;
+        layout.save(s);
+    } else if (kind < 55) {
+        s.config[CONFIG_PERIOD] = 1 + Random(state) % 60;
+        layout.save(s);
+    } else if (kind < 60) {
+        s.config[3] = 2 + Random(state) % 250;
+        layout.save(s);
+    } else if (kind < 75) {
+        unsigned which = Random(state) % STRINGS;
+        unsigned len = Random(state) % stringLen[which];
+        char text[91];
+
+        for (unsigned i = 0; i < len; i++)
+            text[i] = "abcdefghijklmnopqrstuvwxyz0123456789./-"[Random(state) % 39];
+        text[len] = 0;
+        layout.setString(s, which, text);
+    } else {
+        layout.save(s);
+    }
+}
+
+// False if an edit didn't load back, nbBad being the boots after a cut loading neither before nor after it
+static bool
+Run(Layout &layout, unsigned long edits, unsigned long cuts, uint64_t seed, unsigned long &nbBad) {
+    uint64_t state = seed;
+    Settings s, loaded;
+    unsigned long long saveWrites = 0, saveReads = 0, bootReads = 0, mark;
+    unsigned long maxCell = 0, nbNew = 0, nbOld = 0, nbStrings = 0, nbReset = 0, nbWhole = 0;
+    bool ok = true;
+
+    nbBad = 0;
+    HostEepromErase();
+    layout.load(s);
+    layout.readStrings(s);
+
+    for (unsigned long i = 0; i < edits; i++) {
+        unsigned long long reads = HostEeprom.reads;
+
+        mark = HostEeprom.writes;
+        Edit(layout, s, state);
+        saveWrites += HostEeprom.writes - mark;
+        saveReads += HostEeprom.reads - reads;
+
+        reads = HostEeprom.reads;
+        ok = layout.load(loaded);
+        bootReads += HostEeprom.reads - reads;
+        layout.readStrings(loaded);
+        if (!ok || !SameSettings(loaded, s)) {
+            fprintf(stderr, "%s: edit %lu not loaded back\n", layout.name(), i);
+            ok = false;
+            break;
+        }
+    }
+    for (unsigned i = 0; i <= E2END; i++) {
+        if (HostEeprom.cellWrites[i] > maxCell)
+            maxCell = HostEeprom.cellWrites[i];
+    }
+
+    for (unsigned long i = 0; i < cuts; i++) {
+        Settings before = s;
+        bool cleared = true, reset;
+
+        HostEeprom.writesLeft = Random(state) % 24;
+        Edit(layout, s, state);
+        if (HostEeprom.writesLeft > 0)
+            nbWhole++;
+        HostEeprom.writesLeft = -1;
+
+        reset = !layout.load(loaded);
+        layout.readStrings(loaded);
+        if (reset) {
+            nbReset++;
+        } else if (SameSettings(loaded, s)) {
+            nbNew++;
+        } else if (SameSettings(loaded, before)) {
+            nbOld++;
+        } else {
+            // Strings cleared after a cut while writing them, the config struct from before or after it
+            for (unsigned w = 0; w < STRINGS; w++)
+                cleared = cleared && loaded.strings[w][0] == 0;
+            if (cleared && (SameConfig(loaded, s) || SameConfig(loaded, before)))
+                nbStrings++;
+            else
+                nbBad++;
+        }
+        s = loaded;
+    }
+
+    printf("%-9s %7.2f %9.1f %8.1f %9lu %8.1f %8.3f   %5lu %5lu %7lu %6lu %4lu (%lu not cut)\n", layout.name(),
+            (double)saveWrites / edits, (double)saveReads / edits, saveWrites * WRITE_MS / edits, maxCell,
+            (double)bootReads / edits, bootReads * (READ_US + layout.crcUsPerRead()) / edits / 1000,
+            nbNew, nbOld, nbStrings, nbReset, nbBad, nbWhole);
+    return ok;
+}
+
+/*
+ * Configurations edited with the former layout, then loaded by the journal
+ * code: whole, and with a power cut during the migration followed by
+ * another boot.  The config struct must survive the cut, the strings being
+ * either moved or cleared.
+ */
+static bool
+Migrate(AdditiveLayout &additive, JournalLayout &journal, unsigned runs, uint64_t seed) {
+    uint64_t state = seed;
+    Settings s, loaded;
+    unsigned long long writes = 0, mark;
+    unsigned long nbWhole = 0, nbCut = 0, nbStrings = 0, nbBad = 0;
+
+    for (unsigned i = 0; i < runs; i++) {
+        for (int cut = 0; cut < 2; cut++) {
+            HostEepromErase();
+            additive.load(s);
+            additive.readStrings(s);
+            for (unsigned e = 0; e < 20; e++)
+                Edit(additive, s, state);
+
+            if (!cut) {
+                mark = HostEeprom.writes;
+                if (!journal.load(loaded) || !journal.migrated) {
+                    fprintf(stderr, "migrate: run %u not migrated\n", i);
+                    return false;
+                }
+                writes += HostEeprom.writes - mark;
+            } else {
+                HostEeprom.writesLeft = Random(state) % 64;
+                journal.load(loaded);
+                if (HostEeprom.writesLeft > 0)
+                    nbWhole++;
+                HostEeprom.writesLeft = -1;
+                journal.load(loaded);
+                nbCut++;
+            }
+            journal.readStrings(loaded);
+
+            bool cleared = true;
+            for (unsigned w = 0; w < STRINGS; w++)
+                cleared = cleared && loaded.strings[w][0] == 0;
+            if (SameSettings(loaded, s))
+                continue;
+            if (cut && cleared && SameConfig(loaded, s))
+                nbStrings++;
+            else
+                nbBad++;
+        }
+    }
+    printf("migrate   %lu runs, %.1f writes each, %lu cut (%lu not cut): %lu strings cleared, %lu bad\n",
+            (unsigned long)runs, (double)writes / runs, nbCut, nbWhole, nbStrings, nbBad);
+    return nbBad == 0;
+}
+
+static void
+Usage() {
+    fprintf(stderr, "usage: datalogger-eeprom [edits] [cuts] [seed]\n");
+}
+
+int
+main(int argc, char **argv) {
+    unsigned long edits = argc > 1 ? strtoul(argv[1], NULL, 0) : 100000;
+    unsigned long cuts = argc > 2 ? strtoul(argv[2], NULL, 0) : 10000;
+    uint64_t seed = argc > 3 ? strtoull(argv[3], NULL, 0) : 1;
+    AdditiveLayout additive;
+    JournalLayout journal;
+    unsigned long nbBad;
+    bool ok;
+
+    if (argc > 4 || edits == 0 || seed == 0) {
+        Usage();
+        return 2;
+    }
+    printf("%lu edits, %lu power cuts\n", edits, cuts);
+    printf("          ---------------- per edit ---------------- - per boot --   ------- after a power cut -------\n");
+    printf("layout     writes     reads       ms max/cell    reads       ms     new   old strings  reset  bad\n");
+    // The former layout can load garbage after a cut, when the checksum matches by chance
+    ok = Run(additive, edits, cuts, seed, nbBad);
+    ok = Run(journal, edits, cuts, seed, nbBad) && nbBad == 0 && ok;
+    ok = Migrate(additive, journal, 200, seed) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,193 @@
+/*
+ * Check of the DataLogger pages sent over several packets (PageStream.pde),
+ * the sketch file being compiled as is into this program, against the
+ * simulated network of shim/EtherCard.h.
+ *
+ *   datalogger-stream
+ *
+ * A browser acknowledges each segment carrying data or a FIN, as a TCP
+ * stack does, and can lose an ACK or reset the connection.  Streams pages
+ * whose parts are empty here and there, checking the segments sent: their
+ * sequence numbers follow each other from the ACK of the request, none is
+ * empty without a FIN, only the last has the FIN, and no part waits for an
+ * ACK that never comes.
+ */
+
+#include "Arduino.h"
+#include <EtherCard.h>
+#include <string>
+#include <vector>
+
+#include "DataloggerDefs.h"
+
+byte buf[ETH_BUFFER_LEN];
+EtherCard eth;
+
+void DebugPrint_P(const char *s) { Serial.print(s); }
+void DebugPrintln_P(const char *s) { Serial.println(s); }
+
+#include "PageStream.pde"
+
+// The browser, 192.168.1.20:40000, asking us, 192.168.1.5:80
+#define REQ_SEQ     1000UL      // Of the first byte of the request
+#define REQ_LEN     120
+#define PAGE_SEQ    5000UL      // Of the first byte of the page
+
+struct Segment {
+    unsigned long seq;
+    byte flags;
+    std::string data;
+};
+
+static std::vector<Segment> Segments;
+static unsigned LoseAcks;       // ACKs of the next data segments lost
+static bool ResetNext;          // Answer the next data segment with a RST
+
+static unsigned Errors;
+
+static void
+Check(bool ok, const char *what) {
+    if (!ok) {
+        printf("%s: failed\n", what);
+        Errors++;
+    }
+}
+
+// Browser to us segment, ack and flags given
+static std::vector<uint8_t>
+FromBrowser(unsigned long seq, unsigned long ack, byte flags, word dataLen) {
+    static const byte Browser[4] = { 192, 168, 1, 20 }, Us[4] = { 192, 168, 1, 5 };
+    std::vector<uint8_t> p(TCP_OPTIONS_P + dataLen, 0);
+
+    p[ETH_TYPE_H_P] = ETH_TYPE_IP_H_V;
+    p[ETH_TYPE_L_P] = ETH_TYPE_IP_L_V;
+    p[IP_PROTO_P] = IP_PROTO_TCP_V;
+    p[IP_TOTLEN_H_P] = (IP_HEADER_LEN + TCP_HEADER_LEN_PLAIN + dataLen) >> 8;
+    p[IP_TOTLEN_L_P] = (IP_HEADER_LEN + TCP_HEADER_LEN_PLAIN + dataLen) & 0xff;
+    memcpy(&p[IP_SRC_P], Browser, 4);
+    memcpy(&p[IP_DST_P], Us, 4);
+    p[TCP_SRC_PORT_H_P] = 40000 >> 8;
+    p[TCP_SRC_PORT_H_P + 1] = 40000 & 0xff;
+    p[TCP_DST_PORT_H_P + 1] = 80;
+    PutSeq(&p[TCP_SEQ_H_P], seq);
+    PutSeq(&p[TCP_SEQACK_H_P], ack);
+    p[TCP_HEADER_LEN_P] = TCP_HEADER_LEN_PLAIN << 2;
+    p[TCP_FLAGS_P] = flags;
+    return p;
+}
+
+static void
+Sent(const uint8_t *packet, uint16_t dataLen) {
+    Segment s;
+    unsigned long end;
+
+    s.seq = GetSeq(&packet[TCP_SEQ_H_P]);
+    s.flags = packet[TCP_FLAGS_P];
+    s.data.assign((const char *)packet + TCP_OPTIONS_P, dataLen);
+    if (dataLen == 0 && !(s.flags & TCP_FLAGS_FIN_V))
+        Check(Segments.empty(), "ACK of the request first, no empty segment after it");
+    Segments.push_back(s);
+
+    // Nothing to acknowledge
+    if (dataLen == 0 && !(s.flags & TCP_FLAGS_FIN_V))
+        return;
+    end = s.seq + dataLen + (s.flags & TCP_FLAGS_FIN_V ? 1 : 0);
+    if (ResetNext) {
+        ResetNext = false;
+        HostEther.received.push_back(FromBrowser(REQ_SEQ + REQ_LEN, end, TCP_FLAGS_RST_V, 0));
+    } else if (LoseAcks != 0) {
+        LoseAcks--;
+    } else {
+        HostEther.received.push_back(FromBrowser(REQ_SEQ + REQ_LEN, end, TCP_FLAGS_ACK_V, 0));
+    }
+}
+
+// Parts of the page: text, "" for an empty one, the last one ending the page
+static const char *Parts[4];
+static byte NbParts;
+
+static boolean
+Page(BufferFiller &Out, byte Part) {
+    Out.emit_p(PSTR("$S"), Parts[Part]);
+    return Part + 1 < NbParts;
+}
+
+// Stream the page of the parts given in answer to a request of REQ_LEN bytes, answering the ms it took
+static unsigned long
+Stream(const char *P0, const char *P1, const char *P2, const char *P3) {
+    const char *Given[] = { P0, P1, P2, P3 };
+    std::vector<uint8_t> Request = FromBrowser(REQ_SEQ, PAGE_SEQ, TCP_FLAGS_ACK_V | TCP_FLAGS_PUSH_V, REQ_LEN);
+    unsigned long Start = millis();
+
+    for (NbParts = 0; NbParts < 4 && Given[NbParts] != NULL; NbParts++)
+        Parts[NbParts] = Given[NbParts];
+    Segments.clear();
+    HostEther.received.clear();
+    memcpy(buf, Request.data(), Request.size());
+    StreamPage(Page, REQ_LEN);
+    return millis() - Start;
+}
+
+// The segments after the ACK of the request, from PAGE_SEQ on, the FIN on the last one
+static bool
+SegmentsFollow(const std::string &Text) {
+    unsigned long Seq = PAGE_SEQ;
+    std::string Got;
+
+    if (Segments.empty() || Segments[0].seq != PAGE_SEQ || Segments[0].flags != TCP_FLAGS_ACK_V)
+        return false;
+    for (size_t i = 1; i < Segments.size(); i++) {
+        const Segment &s = Segments[i];
+
+        // A part sent again has the same sequence number
+        if (s.seq != Seq && !(s.seq == Segments[i - 1].seq && s.data == Segments[i - 1].data))
+            return false;
+        if (!(s.flags & TCP_FLAGS_ACK_V) || ((s.flags & TCP_FLAGS_FIN_V) != 0) != (i + 1 == Segments.size()))
+            return false;
+        if (s.seq == Seq) {
+            Got += s.data;
+            Seq += s.data.size();
+        }
+    }
+    return Got == Text;
+}
+
+int
+main() {
+    unsigned long Took;
+
+    HostClockSet(1000000);
+    Serial.setSink(NULL);
+    HostEther.sent = Sent;
+
+    Took = Stream("HTTP/1.0 200 OK\r\n\r\n<h1>", "Title", "</h1>", NULL);
+    Check(SegmentsFollow("HTTP/1.0 200 OK\r\n\r\n<h1>Title</h1>") && Segments.size() == 4, "three parts");
+    Check(Took < STREAM_ACK_MS, "three parts, no wait");
+
+    // Empty parts are skipped, an empty last one still carries the FIN
+    Took = Stream("HTTP/1.0 200 OK\r\n\r\n", "", "<br/>", "");
+    Check(SegmentsFollow("HTTP/1.0 200 OK\r\n\r\n<br/>") && Segments.size() == 4, "empty parts");
+    Check(Segments.back().data.empty(), "empty last part: FIN alone");
+    Check(Took < STREAM_ACK_MS, "empty parts, no wait");
+    Took = Stream("HTTP/1.0 200 OK\r\n\r\n", "", "", "end");
+    Check(SegmentsFollow("HTTP/1.0 200 OK\r\n\r\nend") && Segments.size() == 3, "empty parts in a row");
+    Check(Took < STREAM_ACK_MS, "empty parts in a row, no wait");
+
+    // A lost ACK: the part is sent again
+    LoseAcks = 1;
+    Took = Stream("HTTP/1.0 200 OK\r\n\r\n", "a", NULL, NULL);
+    Check(SegmentsFollow("HTTP/1.0 200 OK\r\n\r\na") && Segments.size() == 4, "lost ACK");
+    Check(Took >= STREAM_ACK_MS && Took < 2 * STREAM_ACK_MS, "lost ACK, one wait");
+
+    // Never acknowledged or reset: the page is cut
+    LoseAcks = STREAM_TRIES;
+    Stream("HTTP/1.0 200 OK\r\n\r\n", "a", NULL, NULL);
+    Check(Segments.size() == 1 + STREAM_TRIES, "never acknowledged, cut");
+    LoseAcks = 0;
+    ResetNext = true;
+    Stream("HTTP/1.0 200 OK\r\n\r\n", "a", NULL, NULL);
+    Check(Segments.size() == 2, "reset, cut");
+
+    printf("%u errors\n", Errors);
+    return Errors != 0;
+}
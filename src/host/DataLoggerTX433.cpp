@@ -0,0 +1,178 @@
+/*
+ * Check of the DataLogger 433 MHz plug commands (TX433.pde), sent from the
+ * Timer1 compare interrupt, the sketch file being compiled as is into this
+ * program.
+ *
+ *   datalogger-tx433
+ *
+ * Timer1 is simulated in CTC mode at clk/8: each compare match calls the
+ * ISR, which sets PD7 and OCR1A for the next segment, the match after it
+ * coming OCR1A + 1 ticks of 0.5 us later.  The PD7 levels are recorded and
+ * compared with the waveform of the former bit-banged code, 5 frames of
+ * a 2600 us preamble, 52 bits and a 23800 us gap per command.  The bits are
+ * also decoded back from the ON widths.  Commands queued while one is sent
+ * follow it, those beyond the queue are dropped.
+ */
+
+#include "Arduino.h"
+#include <vector>
+
+#include "TX433.pde"
+
+// Waveform of the bit-banged code: delays plus 20 us of loop per bit
+#define REF_PREAMBLE_US  2600
+#define REF_GAP_US       (23 * 1000 + 800)
+#define REF_ON1_US       (1200 - 20 - 500 + COMPENSATE)
+#define REF_ON0_US       (1200 - 20 - 900 + COMPENSATE)
+#define REF_OFF1_US      (500 - COMPENSATE + 20)
+#define REF_OFF0_US      (900 - COMPENSATE + 20)
+
+struct Segment {
+    bool on;
+    unsigned long us;
+};
+
+static unsigned Errors;
+
+static void
+Check(bool ok, const char *what) {
+    if (!ok) {
+        printf("%s: failed\n", what);
+        Errors++;
+    }
+}
+
+static void
+AddSegment(std::vector<Segment> &w, bool on, unsigned long us) {
+    Segment s = { on, us };
+
+    w.push_back(s);
+}
+
+static void
+AddCommand(std::vector<Segment> &w, const byte *Frame) {
+    for (int r = 0; r < TX433_REPEAT; r++) {
+        AddSegment(w, true, REF_PREAMBLE_US);
+        for (int b = 0; b < NB_BITS; b++) {
+            bool one = (Frame[b / 8] >> (7 - b % 8)) & 1;
+
+            AddSegment(w, false, one ? REF_OFF1_US : REF_OFF0_US);
+            AddSegment(w, true, one ? REF_ON1_US : REF_ON0_US);
+        }
+        AddSegment(w, false, REF_GAP_US);
+    }
+}
+
+/*
+ * Run Timer1 until the ISR disables its interrupt, returning the PD7
+ * segments from the first match, in 0.5 us ticks
+ */
+static std::vector<Segment>
+RunTimer(void (*Queue)()) {
+    std::vector<Segment> w;
+    unsigned long long ticks = 0, edge = 0;
+    bool level = false, started = false;
+
+    while (TIMSK1 & _BV(OCIE1A)) {
+        ticks += OCR1A + 1;
+        TIMER1_COMPA_vect();
+        if (!started) {
+            // The preamble starts on the first match
+            started = true;
+            edge = ticks;
+            level = PORTD & _BV(PORTD7);
+        } else if ((bool)(PORTD & _BV(PORTD7)) != level) {
+            AddSegment(w, level, ticks - edge);
+            edge = ticks;
+            level = !level;
+        }
+        if (Queue != NULL && w.size() == 10) {
+            Queue();
+            Queue = NULL;
+        }
+    }
+    // The last gap ends with the last match
+    AddSegment(w, level, ticks - edge);
+    for (size_t i = 0; i < w.size(); i++)
+        w[i].us /= 2;
+    return w;
+}
+
+static bool
+SameWaveform(const std::vector<Segment> &got, const std::vector<Segment> &want, const char *what) {
+    if (got.size() != want.size()) {
+        printf("%s: %zu segments, want %zu\n", what, got.size(), want.size());
+        return false;
+    }
+    for (size_t i = 0; i < got.size(); i++) {
+        if (got[i].on != want[i].on || got[i].us != want[i].us) {
+            printf("%s: segment %zu %s %lu us, want %s %lu us\n", what, i, got[i].on ? "ON" : "OFF", got[i].us,
+                    want[i].on ? "ON" : "OFF", want[i].us);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Bits of the first frame, a 1 being the ON longer than half a bit
+static bool
+DecodeFrame(const std::vector<Segment> &w, const byte *Frame) {
+    for (int b = 0; b < NB_BITS; b++) {
+        bool one = w[2 + 2 * b].us > TX433_BIT_US / 2;
+
+        if (one != (bool)((Frame[b / 8] >> (7 - b % 8)) & 1))
+            return false;
+    }
+    return true;
+}
+
+static void
+QueueOff() {
+    switchOFF();
+}
+
+static void
+QueueFive() {
+    for (int i = 0; i < 5; i++)
+        switchON();
+}
+
+int
+main() {
+    std::vector<Segment> want, got;
+    unsigned long long total = 0;
+
+    TX433Init();
+    Check(TCCR1B == (_BV(WGM12) | _BV(CS11)) && (DDRD & _BV(DDD7)) && !(PORTD & _BV(PORTD7)), "init");
+
+    // One command
+    switchON();
+    AddCommand(want, onFrame);
+    got = RunTimer(NULL);
+    Errors += !SameWaveform(got, want, "switchON");
+    Check(DecodeFrame(got, onFrame), "switchON bits");
+    Check(!(PORTD & _BV(PORTD7)), "output OFF after the command");
+    for (size_t i = 0; i < got.size(); i++)
+        total += got[i].us;
+    printf("switchON:    %zu segments, %.1f ms, ON of a 1 %u us, of a 0 %u us\n", got.size(), total / 1e3,
+            REF_ON1_US, REF_ON0_US);
+
+    // switchOFF() while switchON() is on the air: sent right after it
+    switchON();
+    got = RunTimer(QueueOff);
+    want.clear();
+    AddCommand(want, onFrame);
+    AddCommand(want, offFrame);
+    Errors += !SameWaveform(got, want, "switchON then switchOFF");
+
+    // 6 commands: the first one and 3 more queued, 2 dropped
+    switchON();
+    got = RunTimer(QueueFive);
+    want.clear();
+    for (int i = 0; i < TX433_QUEUE; i++)
+        AddCommand(want, onFrame);
+    Errors += !SameWaveform(got, want, "full queue");
+
+    printf("%u errors\n", Errors);
+    return Errors != 0;
+}
@@ -0,0 +1,273 @@
+/*
+ * Check of the DataLogger store and forward of the WebSend reports
+ * (WebQueue.pde), the sketch file being compiled as is into this program.
+ *
+ *   datalogger-webqueue
+ *
+ * Queues samples while the server is down and answers the POSTs with and
+ * without a Date header: until an answer told the time, only the newest
+ * sample goes out, untimed, the older ones being held.  Then the held
+ * samples go as timed records, whole samples per POST, every minute once
+ * and in order, the ones spilled to the emulated EEPROM included.  The
+ * sample sent untimed is not sent again, even when it spilled to the
+ * EEPROM before the answer to its POST came.  A full queue must leave
+ * the configuration journal of Misc.pde, up to CONFIG_EEPROM_END() of
+ * ConfigLayout.h, as it was.
+ */
+
+#include "Arduino.h"
+#include <avr/eeprom.h>
+#include <string>
+#include <vector>
+
+#include "DataloggerDefs.h"
+
+word Minutes;
+byte Seconds;
+byte CentralTempSignBit, CentralTempWhole, CentralTempFract;
+Type_Channel ITPlusChannels[ITPLUS_MAX_SENSORS];
+char ReportBuff[REPORT_BATCH_LEN + 1];
+
+void DebugPrint_P(const char *s) { Serial.print(s); }
+void DebugPrintln_P(const char *s) { Serial.println(s); }
+
+static std::vector<std::string> Posts;
+
+void WebSend(char *StrBuff) {
+  Posts.push_back(StrBuff);
+}
+
+#include "WebQueue.pde"
+
+// Server time at our minute 0: Wed, 14 Oct 2026 12:00:00 GMT
+#define CLOCK_TIME  1791979200UL
+
+// Server answers
+#define DATE     0
+#define NO_DATE  1
+
+static unsigned Errors;
+
+static void
+Check(bool ok, const char *what) {
+    if (!ok) {
+        printf("%s: failed\n", what);
+        Errors++;
+    }
+}
+
+static void
+Reset() {
+    HostEepromErase();
+    RamHead = RamCount = EepHead = EepCount = BatchCount = 0;
+    SentUntimed = ClockSet = false;
+    WebQueueDropped = 0;
+    Posts.clear();
+}
+
+// A sample per minute, all streams valid and the temperature telling the minute: Minutes % 100 degrees
+static void
+Push(word Minute, byte Streams) {
+    Minutes = Minute;
+    CentralTempSignBit = Minute & 1;
+    CentralTempWhole = Minute % 100;
+    CentralTempFract = 9;
+    for (byte i = 0; i < ITPLUS_MAX_SENSORS; i++) {
+        ITPlusChannels[i].SensorID = i < Streams ? i : 0xff;
+        ITPlusChannels[i].LastReceiveTimer = 1;
+        ITPlusChannels[i].Temp = Minute % 100;
+        ITPlusChannels[i].DeciTemp = 5;
+    }
+    WebQueuePush();
+}
+
+// Answer 200 OK to the last POST, true if the queue asks for another one
+static bool
+Answer(int Kind) {
+    static const char *Months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov",
+                                    "Dec" };
+    unsigned long Time = CLOCK_TIME + Minutes * 60UL + Seconds;
+    char Text[128];
+    word Year;
+    byte Month, Day;
+
+    CivilFromDays(Time / 86400, &Year, &Month, &Day);
+    snprintf(Text, sizeof(Text), "HTTP/1.1 200 OK\r\nDate: Wed, %02u %s %u %02lu:%02lu:%02lu GMT\r\n\r\n",
+             Day, Months[Month - 1], Year, Time / 3600 % 24, Time / 60 % 60, Time % 60);
+    if (Kind == NO_DATE)
+        strcpy(Text, "HTTP/1.1 200 OK\r\nServer: Apache\r\n\r\n");
+    WebQueueAnswer(Text, strlen(Text));
+    return WebQueueSent();
+}
+
+// Minutes of the records of stream 0 of a POST, timed or not
+static std::vector<unsigned long>
+StreamZero(const std::string &Post, bool Timed) {
+    std::vector<unsigned long> Found;
+    size_t Pos = 0;
+
+    while (Pos < Post.size()) {
+        size_t End = Post.find("\r\n", Pos);
+        std::string Record = Post.substr(Pos, End == std::string::npos ? std::string::npos : End - Pos);
+        int Year, Month, Day, Hour, Minute;
+
+        if (Record.compare(0, 2, "0,") == 0) {
+            if (!Timed) {
+                Found.push_back(strtoul(Record.c_str() + 2 + (Record[2] == '-'), NULL, 10));
+            } else if (sscanf(Record.c_str(), "0,%d-%d-%dT%d:%d:00Z,", &Year, &Month, &Day, &Hour, &Minute) == 5) {
+                Found.push_back(DaysFromCivil(Year, Month, Day) * 86400UL + Hour * 3600UL + Minute * 60UL);
+            }
+        }
+        Pos = End == std::string::npos ? Post.size() : End + 2;
+    }
+    return Found;
+}
+
+// Send until the queue is empty, answering with Kind, the minutes of stream 0 of the timed records
+static std::vector<unsigned long>
+SendAll(int Kind) {
+    std::vector<unsigned long> Times;
+    unsigned Posted = 0;
+
+    WebQueueSend();
+    while (Posted++ < 100) {
+        std::vector<unsigned long> Found = StreamZero(Posts.back(), true);
+
+        Times.insert(Times.end(), Found.begin(), Found.end());
+        if (!Answer(Kind))
+            break;
+        WebQueueSend();
+    }
+    return Times;
+}
+
+static void
+CheckNoDate() {
+    Reset();
+    for (word m = 100; m < 103; m++)
+        Push(m, ITPLUS_MAX_SENSORS);
+    WebQueueSend();
+    Check(Posts.size() == 1 && StreamZero(Posts[0], false) == std::vector<unsigned long>(1, 2),
+          "no date: newest sample untimed");
+    // A sample queued before the answer came stays
+    Push(103, ITPLUS_MAX_SENSORS);
+    Check(!Answer(NO_DATE), "no date: nothing more to send");
+    Check(WebQueueCount() == 3 && WebQueueDropped == 0, "no date: older samples held");
+
+    // Still no date: the newest again, nothing dropped
+    Push(104, ITPLUS_MAX_SENSORS);
+    WebQueueSend();
+    Check(StreamZero(Posts.back(), false) == std::vector<unsigned long>(1, 4), "no date: newest again");
+    Check(!Answer(NO_DATE) && WebQueueCount() == 3 && WebQueueDropped == 0, "no date: held again");
+}
+
+static void
+CheckHeld() {
+    std::vector<unsigned long> Times;
+
+    Reset();
+    for (word m = 200; m < 203; m++)
+        Push(m, ITPLUS_MAX_SENSORS);
+    Seconds = 30;
+    WebQueueSend();
+    Check(Posts.size() == 1 && StreamZero(Posts[0], false) == std::vector<unsigned long>(1, 2),
+          "held: newest sample untimed");
+
+    // The clock known: the held samples go timed, one whole sample per POST at most
+    Check(Answer(DATE), "held: samples to send");
+    Check(WebQueueCount() == 2, "held: newest sent");
+    Times = SendAll(DATE);
+    Check(Times.size() == 2 && Times[0] == CLOCK_TIME + 200 * 60 && Times[1] == CLOCK_TIME + 201 * 60,
+          "held: timed records of the held samples");
+    Check(WebQueueCount() == 0 && WebQueueDropped == 0, "held: all sent");
+}
+
+// The sample sent untimed spills to the EEPROM before its answer comes
+static void
+CheckSpilledSent() {
+    std::vector<unsigned long> Times;
+
+    Reset();
+    Seconds = 0;
+    for (word m = 300; m < 300 + WEBQ_RAM_SLOTS + 2; m++)
+        Push(m, ITPLUS_MAX_SENSORS);
+    WebQueueSend();
+    Check(StreamZero(Posts.back(), false) == std::vector<unsigned long>(1, 5), "spilled: newest sample untimed");
+    for (word m = 300 + WEBQ_RAM_SLOTS + 2; m < 300 + 2 * WEBQ_RAM_SLOTS + 2; m++)
+        Push(m, ITPLUS_MAX_SENSORS);
+    Check(EepCount == WEBQ_RAM_SLOTS + 2, "spilled: sent sample in the EEPROM");
+
+    Check(Answer(DATE) && WebQueueCount() == 2 * WEBQ_RAM_SLOTS + 1, "spilled: sent sample removed");
+    Times = SendAll(DATE);
+    Check(Times.size() == 2 * WEBQ_RAM_SLOTS + 1, "spilled: every other sample sent once");
+    for (unsigned i = 0, m = 300; i < Times.size(); i++, m++) {
+        if (m == 300 + WEBQ_RAM_SLOTS + 1)
+            m++;
+        Check(Times[i] == CLOCK_TIME + m * 60, "spilled: in order");
+    }
+}
+
+static void
+CheckBacklog() {
+    std::vector<unsigned long> Times;
+    unsigned Posted = 0;
+
+    Reset();
+    Seconds = 0;
+    Minutes = 0;
+    Answer(DATE);
+    // Over the RAM slots, with all streams then just the DS1820, so that several samples fit a POST
+    for (word m = 1; m <= 40; m++)
+        Push(m, m <= 20 ? ITPLUS_MAX_SENSORS : 0);
+    Check(EepCount == 40 - WEBQ_RAM_SLOTS, "backlog: spilled to the EEPROM");
+    WebQueueSend();
+    while (WebQueueCount() != 0 && Posted++ < 100) {
+        std::vector<unsigned long> Found = StreamZero(Posts.back(), true);
+
+        Check(strlen(ReportBuff) < REPORT_BATCH_LEN, "backlog: POST not cut");
+        Check(Found.size() == BatchCount, "backlog: whole samples");
+        Times.insert(Times.end(), Found.begin(), Found.end());
+        if (Answer(DATE))
+            WebQueueSend();
+    }
+    Check(Times.size() == 40, "backlog: every sample sent");
+    for (unsigned i = 0; i < Times.size(); i++)
+        Check(Times[i] == CLOCK_TIME + (i + 1) * 60, "backlog: in order");
+    Check(Posted < 40, "backlog: several samples per POST");
+}
+
+// A full queue leaves the configuration of Misc.pde as it was, every journal slot written
+static void
+CheckConfigKept() {
+    // Newest and Seq set by ConfigLoad()
+    ConfigLayout Layout = {
+        { ConfigAddr(CONFIG_HOST_LEN + CONFIG_URL_LEN + CONFIG_HDR_LEN), CONFIG_SLOTS, sizeof(Type_ConfigRecord),
+          0x3321, 0, 0 },
+        0, { CONFIG_HOST_LEN, CONFIG_URL_LEN, CONFIG_HDR_LEN }
+    };
+    Type_ConfigRecord Record, Loaded;
+
+    Reset();
+    ConfigLoad(&Layout, &Loaded);   // As at boot, nothing there
+    memset(&Record, 0x5a, sizeof(Record));
+    for (byte i = 0; i < CONFIG_SLOTS; i++) {
+        Record.Config.WebSendPeriod = i;
+        ConfigSave(&Layout, &Record);
+    }
+    for (word m = 0; m < 2 * (WEBQ_RAM_SLOTS + WEBQ_EEP_SLOTS); m++)
+        Push(m, ITPLUS_MAX_SENSORS);
+    Check(WebQueueCount() == WEBQ_RAM_SLOTS + WEBQ_EEP_SLOTS, "config: queue full");
+    Check(ConfigLoad(&Layout, &Loaded) == CONFIG_LOADED && memcmp(&Loaded, &Record, sizeof(Record)) == 0,
+          "config: kept");
+}
+
+int
+main() {
+    CheckNoDate();
+    CheckHeld();
+    CheckSpilledSent();
+    CheckBacklog();
+    CheckConfigKept();
+    printf("webqueue: %u errors\n", Errors);
+    return Errors != 0;
+}
@@ -0,0 +1,54 @@
+/*
+ * Firmware to host clock mapping, see FirmwareClock.h
+ */
+
+#include "FirmwareClock.h"
+#include <time.h>
+
+FirmwareClock::FirmwareClock()
+    : lastExtended(0), lastMicros(0), lastUptime(0), offsetUs(0), nbSyncs(0), nbResets(0) {
+}
+
+void
+FirmwareClock::sync(uint32_t micros, uint32_t uptime, uint64_t hostUs) {
+    int64_t sample;
+
+    if (nbSyncs != 0 && uptime < lastUptime) {
+        nbResets++;
+        nbSyncs = 0;
+    }
+
+    if (nbSyncs == 0) {
+        lastExtended = micros;
+    } else {
+        uint32_t delta = micros - lastMicros;
+        int64_t elapsed = (int64_t)(uptime - lastUptime) * 1000000;
+
+        // Whole wraps missed, the uptime being good to a second
+        lastExtended += delta + (uint64_t)((elapsed - (int64_t)delta + (1LL << 31)) >> 32 << 32);
+    }
+    lastMicros = micros;
+    lastUptime = uptime;
+
+    sample = (int64_t)(hostUs - lastExtended);
+    if (nbSyncs == 0 || sample < offsetUs)
+        offsetUs = sample;
+    else
+        offsetUs += (sample - offsetUs) / 16;
+    nbSyncs++;
+}
+
+uint64_t
+FirmwareClock::toHost(uint32_t micros) const {
+    if (nbSyncs == 0)
+        return 0;
+    return lastExtended + (int32_t)(micros - lastMicros) + offsetUs;
+}
+
+uint64_t
+HostWallClockUs() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
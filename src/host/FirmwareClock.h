@@ -0,0 +1,54 @@
+/*
+ * Host wall clock time of the firmware micros() stamps, from the sync
+ * records the JeeLink sends every REC_SYNC_PERIOD seconds (see
+ * SensorRecord.h).
+ *
+ * micros() wraps every 71 minutes.  Each sync extends it to 64 bits from
+ * the previous one, using the uptime seconds to count the wraps when syncs
+ * were missed, and stamps are taken relative to the last sync.
+ *
+ * The offset between the two clocks is the host arrival time of a sync
+ * minus its stamp, which adds the UART queue, USB and scheduling latency.
+ * The lowest offset seen is kept, rising by 1/16 of the difference at each
+ * higher one to follow the drift of the JeeLink crystal.  Absolute times are
+ * thus good to about the latency jitter (milliseconds), while the time
+ * between two stamps keeps the micros() resolution.
+ *
+ * A JeeLink reset, seen as the uptime going backwards, starts over.
+ */
+
+#ifndef FirmwareClock_h
+#define FirmwareClock_h
+
+#include <stdint.h>
+
+class FirmwareClock {
+public:
+    FirmwareClock();
+
+    // A sync record that arrived at host wall clock hostUs
+    void sync(uint32_t micros, uint32_t uptime, uint64_t hostUs);
+
+    bool synced() const { return nbSyncs != 0; }
+
+    // Host wall clock of a micros() stamp, within 35 minutes of the last
+    // sync.  0 before the first sync.
+    uint64_t toHost(uint32_t micros) const;
+
+    // Host minus firmware clock, in us
+    int64_t offset() const { return offsetUs; }
+
+    unsigned long long syncs() const { return nbSyncs; }
+    unsigned long long resets() const { return nbResets; }
+
+private:
+    uint64_t lastExtended;      // lastMicros extended to 64 bits
+    uint32_t lastMicros, lastUptime;
+    int64_t offsetUs;
+    unsigned long long nbSyncs, nbResets;
+};
+
+// CLOCK_REALTIME in us
+uint64_t HostWallClockUs();
+
+#endif
@@ -0,0 +1,165 @@
+/*
+ * Emulation of a fleet of TX29 IT+ sensors, see FleetEmulator.h
+ */
+
+#include "FleetEmulator.h"
+#include "ITPlusCRC.h"
+#include "PiWeather.h"
+
+FleetConfig::FleetConfig()
+    : sensors(16), jitterMs(50), collisionRate(0), bitErrorRate(0), restartsPerDay(0),
+      duplicateIdRate(0), hygroShare(0.5), seed(1) {
+}
+
+FleetEmulator::FleetEmulator(const FleetConfig &c)
+    : config(c), fleet(c.sensors), state(c.seed ^ 0x9e3779b97f4a7c15ULL),
+      nbSent(0), nbLost(0), nbCollisions(0), nbBitErrors(0), nbRestarts(0) {
+    // Not drawn yet
+    for (unsigned i = 0; i < fleet.size(); i++)
+        fleet[i].id = 0xff;
+    for (unsigned i = 0; i < fleet.size(); i++) {
+        Sensor &s = fleet[i];
+
+        s.id = newId(i);
+        s.hygro = uniform() < config.hygroShare;
+        s.weakBatt = uniform() < 0.05;
+        s.temp = random() % 300;
+        s.humidity = 40 + random() % 40;
+        // Crystal drift of up to 0.5%
+        s.periodUs = ITPLUS_TX_PERIOD * 1000UL + random() % 40001 - 20000;
+        s.nextUs = random() % s.periodUs;
+        s.restartUntilUs = 0;
+    }
+}
+
+// xorshift64*
+uint64_t
+FleetEmulator::random() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545f4914f6cdd1dULL;
+}
+
+// Random ID, unused by the other sensors unless a duplicate is drawn
+uint8_t
+FleetEmulator::newId(unsigned sensor) {
+    bool used[64] = { false };
+    unsigned nbUsed = 0;
+    uint8_t id;
+
+    for (unsigned i = 0; i < fleet.size(); i++) {
+        if (i != sensor && fleet[i].id != 0xff && !used[fleet[i].id]) {
+            used[fleet[i].id] = true;
+            nbUsed++;
+        }
+    }
+    if (nbUsed > 0 && (nbUsed == 64 || uniform() < config.duplicateIdRate)) {
+        do
+            id = random() % 64;
+        while (!used[id]);
+    } else {
+        do
+            id = random() % 64;
+        while (used[id]);
+    }
+    return id;
+}
+
+unsigned
+FleetEmulator::earliest() const {
+    unsigned first = 0;
+
+    for (unsigned i = 1; i < fleet.size(); i++) {
+        if (fleet[i].nextUs < fleet[first].nextUs)
+            first = i;
+    }
+    return first;
+}
+
+void
+FleetEmulator::makeFrame(uint8_t *frame, uint8_t sensorId, bool restart, bool misc, int16_t temp,
+        bool weakBatt, uint8_t hygro) {
+    int raw = temp + 400;
+
+    frame[0] = 0x90 | (sensorId >> 2);
+    frame[1] = ((sensorId & 0x03) << 6) | (restart ? 0x20 : 0) | (misc ? 0x10 : 0) | raw / 100;
+    frame[2] = ((raw / 10 % 10) << 4) | (raw % 10);
+    frame[3] = (weakBatt ? 0x80 : 0) | (hygro & 0x7f);
+    frame[4] = ITPlusCRC8<ITPLUS_CRC_IMPL>(frame, 4, 0);
+}
+
+// Next frame of a sensor, which is then scheduled for the following one
+void
+FleetEmulator::transmit(unsigned sensor, FleetFrame &f) {
+    Sensor &s = fleet[sensor];
+    long jitterUs = config.jitterMs ? (long)(random() % (2 * config.jitterMs * 1000 + 1)) - config.jitterMs * 1000L : 0;
+
+    if (config.restartsPerDay > 0 && uniform() < config.restartsPerDay * s.periodUs / 86400e6) {
+        s.id = newId(sensor);
+        s.restartUntilUs = s.nextUs + FLEET_RESTART_US;
+        nbRestarts++;
+    }
+    if (random() % 10 == 0 && s.temp > -400 && s.temp < 599)
+        s.temp += random() % 2 ? 1 : -1;
+    if (s.hygro && random() % 20 == 0 && s.humidity > 1 && s.humidity < 99)
+        s.humidity += random() % 2 ? 1 : -1;
+
+    f.timeUs = s.nextUs;
+    f.sensor = sensor;
+    f.sensorId = s.id;
+    f.restart = s.nextUs < s.restartUntilUs;
+    f.weakBatt = s.weakBatt;
+    f.temp = s.temp;
+    f.hygro = s.hygro ? s.humidity : 106;
+    f.garbled = false;
+    makeFrame(f.frame, f.sensorId, f.restart, false, f.temp, f.weakBatt, f.hygro);
+    nbSent++;
+
+    s.nextUs += s.periodUs + jitterUs;
+}
+
+void
+FleetEmulator::next(FleetFrame &f) {
+    unsigned from = 5;
+
+    transmit(earliest(), f);
+
+    // Receiving, the JeeLink misses frames starting on the air meanwhile
+    for (;;) {
+        unsigned other = earliest();
+        unsigned long long overlap = fleet[other].nextUs - f.timeUs;
+        FleetFrame lost;
+
+        if (fleet[other].nextUs >= f.timeUs + FLEET_AIR_US)
+            break;
+        // Garbled from the byte on the air when the other one started
+        if (overlap * 5 / FLEET_AIR_US < from)
+            from = overlap * 5 / FLEET_AIR_US;
+        transmit(other, lost);
+        nbLost++;
+    }
+    if (from == 5 && uniform() < config.collisionRate)
+        from = random() % 5;
+    if (from < 5) {
+        for (unsigned i = from; i < 5; i++)
+            f.frame[i] ^= (uint8_t)(random() % 255 + 1);
+        f.garbled = true;
+        nbCollisions++;
+    }
+
+    if (config.bitErrorRate > 0) {
+        bool flipped = false;
+
+        for (unsigned i = 0; i < 40; i++) {
+            if (uniform() < config.bitErrorRate) {
+                f.frame[i / 8] ^= 0x80 >> (i % 8);
+                flipped = true;
+            }
+        }
+        if (flipped) {
+            f.garbled = true;
+            nbBitErrors++;
+        }
+    }
+}
@@ -0,0 +1,96 @@
+/*
+ * Emulation of a fleet of La Crosse TX29 IT+ sensors, as heard by the
+ * JeeLink, for load testing the receive and decode path.
+ *
+ * Each sensor sends a 5 bytes frame every ITPLUS_TX_PERIOD give or take its
+ * own crystal drift and a per frame jitter:
+ *
+ *   byte 0   length nibble (9), ID bits 5-2
+ *   byte 1   ID bits 1-0, restart flag, misc flag, T10 BCD digit
+ *   byte 2   T1 and T.1 BCD digits, temperature + 40 C
+ *   byte 3   weak battery flag, hygro (106 for temperature only sensors)
+ *   byte 4   CRC-8, polynomial 0x31
+ *
+ * Frames overlapping on the air collide: the first one is garbled, the
+ * second one lost.  On top of that, frames can be garbled by a foreign
+ * transmitter (collision rate) and have bits flipped (bit error rate).  A
+ * battery change gives a sensor a new random ID, possibly one already in
+ * use, and sets its restart flag for 4h30.
+ */
+
+#ifndef FleetEmulator_h
+#define FleetEmulator_h
+
+#include <stdint.h>
+#include <vector>
+
+#define FLEET_AIR_US        4200        // Preamble, sync and frame at 17.241 kbps
+#define FLEET_RESTART_US    (270 * 60 * 1000000ULL)
+
+struct FleetConfig {
+    unsigned sensors;
+    unsigned jitterMs;          // Each frame +- up to this
+    double collisionRate;       // Frames garbled by foreign transmitters
+    double bitErrorRate;
+    double restartsPerDay;      // Battery changes per sensor
+    double duplicateIdRate;     // Sensors taking an ID already in use
+    double hygroShare;          // TX29DTH-IT among TX29-IT
+    unsigned long seed;
+
+    FleetConfig();
+};
+
+// A frame received by the JeeLink, with what the sensor really sent
+struct FleetFrame {
+    unsigned long long timeUs;
+    uint8_t frame[5];
+    unsigned sensor;
+    uint8_t sensorId;
+    bool restart, weakBatt;
+    int16_t temp;
+    uint8_t hygro;
+    bool garbled;               // Collision or bit errors
+};
+
+class FleetEmulator {
+public:
+    FleetEmulator(const FleetConfig &config);
+
+    // Next frame heard, in time order
+    void next(FleetFrame &frame);
+
+    // Sensor ids at the start, to register some of them
+    uint8_t sensorId(unsigned sensor) const { return fleet[sensor].id; }
+
+    unsigned long long sent() const { return nbSent; }
+    unsigned long long lost() const { return nbLost; }
+    unsigned long long collisions() const { return nbCollisions; }
+    unsigned long long bitErrors() const { return nbBitErrors; }
+    unsigned long long restarts() const { return nbRestarts; }
+
+    static void makeFrame(uint8_t *frame, uint8_t sensorId, bool restart, bool misc, int16_t temp,
+            bool weakBatt, uint8_t hygro);
+
+private:
+    struct Sensor {
+        uint8_t id;
+        bool hygro, weakBatt;
+        int16_t temp;
+        uint8_t humidity;
+        unsigned long periodUs;
+        unsigned long long nextUs, restartUntilUs;
+    };
+
+    uint64_t random();
+    double uniform() { return (random() >> 11) * (1.0 / 9007199254740992.0); }
+    uint8_t newId(unsigned sensor);
+    unsigned earliest() const;
+    void transmit(unsigned sensor, FleetFrame &frame);
+
+    FleetConfig config;
+    std::vector<Sensor> fleet;
+    uint64_t state;
+    unsigned long long nbSent, nbLost, nbCollisions, nbBitErrors, nbRestarts;
+};
+
+#endif
@@ -0,0 +1,121 @@
+/*
+ * IT+ frame replay benchmark.
+ *
+ *   itplus-replay extract <corpus.bin> <trace.txt>...
+ *       Pull the raw frames out of "GotIT+" debug dumps (sample.txt,
+ *       lcd-id-vs-arduino-id.txt or a capture of the JeeLink serial output)
+ *       into a binary corpus of 5 bytes records.
+ *
+ *   itplus-replay run <corpus.bin> [frames]
+ *       Push frames (default 5000000) from the corpus, round robin, through
+ *       ProcessITPlusFrame() and report throughput, time per frame, serial
+ *       output volume and heap allocations, once with the event log off and
+ *       once with it on.  The log is drained after each frame, as loop()
+ *       would, but that time is reported apart from the frame path.
+ *
+ *   itplus-replay registry [lookups]
+ *       Check a sensor unregistered goes back to its discovered entry, then
+ *       time CheckITPlusRegistration() with 1 to 64 sensors on the air, the
+ *       first ITPLUS_MAX_SENSORS of them registered, the others discovered.
+ *
+ *   itplus-replay temps [conversions]
+ *       Check every temperature a TX29 can send, -40.0 to +59.9 C, through
+ *       ProcessITPlusFrame(), FormatDeci() and DeciCelsiusToFahrenheit()
+ *       against double precision references, then time the formatting.
+ *
+ *   itplus-replay report [reports]
+ *       Time the per-minute report with 0 to ITPLUS_MAX_SENSORS registered
+ *       sensors heard from, then print the full one.
+ *
+ *   itplus-replay crc [frames]
+ *       Check the 3 implementations of ITPlusCRC.h agree on every update
+ *       step and that single bit errors are caught, then time each one
+ *       over frames (default 10000000) random frames.
+ *
+ *   itplus-replay binary <corpus.bin> [frames]
+ *       Compare the serial output of the text and binary output modes for
+ *       the corpus frames, then time RecordDecoder over the binary output.
+ *
+ *   itplus-replay ingest <corpus.bin> [frames]
+ *       Make the firmware text and binary output for the corpus frames,
+ *       then time IngestParser over it, in memory and through a pty in raw
+ *       mode, checking every frame comes out as a reading.
+ *
+ *   itplus-replay log <capture>
+ *       Expand the binary records of a serial capture made with
+ *       EVENT_LOG_BINARY, other output is copied as is.
+ *
+ *   itplus-replay fleet [-n sensors] [-t hours] [-j jitter ms] [-c collision rate]
+ *           [-e bit error rate] [-r restarts per day] [-d duplicate ID rate]
+ *           [-s seed] [-a seconds] [-f] [-x] [-o output] [-w corpus.bin]
+ *       Push what a fleet of emulated TX29 (see FleetEmulator.h, default 16
+ *       sensors) sends in hours (default 24) through ProcessITPlusFrame(),
+ *       the first ITPLUS_MAX_SENSORS sensors registered, and check the
+ *       binary output against what was sent, or parse the text output with
+ *       -x.  Reports decode throughput and where frames were lost.  The
+ *       binary output, with a sync record every REC_SYNC_PERIOD, arrives at
+ *       the host with 2.4 to 18.4 ms of latency, checking how close to the
+ *       true start of the frames FirmwareClock puts them.  -f drops
+ *       the frames of unregistered IDs as rf12_itplusFilter() does with
+ *       ITPLUS_REGISTERED_ONLY.  -a aggregates the frames of the registered
+ *       sensors over intervals of that many seconds (see Aggregate.h), the
+ *       frame records kept to check each summary against them and to
+ *       compare the output sizes.  -o saves the firmware output ("-" for
+ *       stdout) to feed piweatherd, -w the frames heard as a corpus for the
+ *       other modes.
+ *
+ * The host clock is frozen and advanced so that a whole pass over the corpus
+ * takes ITPLUS_TX_PERIOD, as if each frame came from a different sensor.
+ *
+ * The modes live in the Replay*.cpp files, on the helpers of Replay.h.
+ */
+
+#include "Replay.h"
+#include <string.h>
+
+static void
+Usage() {
+    fprintf(stderr,
+            "usage: itplus-replay extract <corpus.bin> <trace.txt>...\n"
+            "       itplus-replay run <corpus.bin> [frames]\n"
+            "       itplus-replay registry [lookups]\n"
+            "       itplus-replay temps [conversions]\n"
+            "       itplus-replay report [reports]\n"
+            "       itplus-replay crc [frames]\n"
+            "       itplus-replay binary <corpus.bin> [frames]\n"
+            "       itplus-replay ingest <corpus.bin> [frames]\n"
+            "       itplus-replay log <capture>\n"
+            "       itplus-replay fleet [-n sensors] [-t hours] [-j jitter ms] [-c collision rate]\n"
+            "               [-e bit error rate] [-r restarts per day] [-d duplicate ID rate]\n"
+            "               [-s seed] [-a seconds] [-f] [-x] [-o output] [-w corpus.bin]\n");
+}
+
+int
+main(int argc, char **argv) {
+    if (argc >= 4 && strcmp(argv[1], "extract") == 0)
+        return Extract(argc - 2, argv + 2);
+    if (argc >= 3 && strcmp(argv[1], "run") == 0)
+        return Run(argc - 2, argv + 2);
+    if (argc >= 2 && strcmp(argv[1], "registry") == 0)
+        return Registry(argc - 2, argv + 2);
+    if (argc >= 2 && strcmp(argv[1], "temps") == 0)
+        return Temps(argc - 2, argv + 2);
+    if (argc >= 2 && strcmp(argv[1], "report") == 0)
+        return Report(argc - 2, argv + 2);
+    if (argc >= 2 && strcmp(argv[1], "crc") == 0)
+        return CRC(argc - 2, argv + 2);
+    if (argc >= 3 && strcmp(argv[1], "binary") == 0)
+        return Binary(argc - 2, argv + 2);
+    if (argc >= 3 && strcmp(argv[1], "ingest") == 0)
+        return IngestBench(argc - 2, argv + 2);
+    if (argc >= 3 && strcmp(argv[1], "log") == 0)
+        return Log(argv + 2);
+    if (argc >= 2 && strcmp(argv[1], "fleet") == 0) {
+        int status = Fleet(argc - 1, argv + 1);
+
+        if (status != 2)
+            return status;
+    }
+    Usage();
+    return 1;
+}
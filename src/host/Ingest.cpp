@@ -0,0 +1,360 @@
+/*
+ * Ingest of the JeeLink serial output, see Ingest.h
+ */
+
+#include "Ingest.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+const char *const RadioStatNames[RADIO_STAT_COUNT] = {
+    "isr", "cyc", "itp", "jee", "crc", "len", "ovf", "flt", "hit", "known", "new", "evict",
+};
+
+unsigned long
+RadioStatsLine::since(const RadioStatsLine &previous, unsigned counter) const {
+    return (value[counter] - previous.value[counter]) & 0xffffffffUL;
+}
+
+IngestParser::IngestParser(Handler handler, void *context)
+    : handler(handler), context(context), statsHandler(NULL), statsContext(NULL),
+      summaryHandler(NULL), summaryContext(NULL), nbText(0), nbBinary(0), nbSync(0), nbSummary(0),
+      nbCrcErrors(0), nbStats(0), nbOtherLines(0), nbNoise(0) {
+    hostUs = HostWallClockUs();
+}
+
+void
+IngestParser::setStatsHandler(StatsHandler handler, void *context) {
+    statsHandler = handler;
+    statsContext = context;
+}
+
+void
+IngestParser::setSummaryHandler(SummaryHandler handler, void *context) {
+    summaryHandler = handler;
+    summaryContext = context;
+}
+
+/*
+ * Records start either with a 0 (binary) or anything else (a text line up
+ * to \n).  A 0 not starting a valid binary record is skipped as noise, what
+ * follows is then taken as text: debug output can't desynchronize us.
+ */
+size_t
+IngestParser::parse(const uint8_t *data, size_t len, bool end) {
+    const size_t maxFrame = COBS_LEN(REC_MAX_LEN);
+    size_t p = 0;
+
+    while (p < len) {
+        if (data[p] == REC_DELIMITER) {
+            size_t avail = len - p - 1, frameLen;
+            const uint8_t *close = (const uint8_t *)memchr(data + p + 1, REC_DELIMITER,
+                    avail < maxFrame + 1 ? avail : maxFrame + 1);
+            LinkRecord r;
+
+            if (close == NULL) {
+                if (avail <= maxFrame && !end)
+                    break;      // Wait for the rest of the record
+                nbNoise++;
+                p++;
+                continue;
+            }
+
+            frameLen = close - (data + p + 1);
+            if (frameLen == 0) {
+                p++;            // Closing delimiter followed by an opening one
+                continue;
+            }
+
+            switch (RecordDecoder::decode(data + p + 1, frameLen, r)) {
+            case RecordDecoder::RECORD:
+                nbBinary++;
+                r.sensor.timeUs = firmwareClock.toHost(r.sensor.stamp);
+                handler(r.sensor, context);
+                p += frameLen + 2;
+                break;
+            case RecordDecoder::SYNC:
+                nbSync++;
+                firmwareClock.sync(r.sync.micros, r.sync.uptime, hostUs);
+                p += frameLen + 2;
+                break;
+            case RecordDecoder::SUMMARY:
+                nbSummary++;
+                if (summaryHandler != NULL) {
+                    r.summary.timeUs = firmwareClock.toHost(r.summary.stamp);
+                    summaryHandler(r.summary, summaryContext);
+                }
+                p += frameLen + 2;
+                break;
+            case RecordDecoder::CRC_ERROR:
+                nbCrcErrors++;
+                p += frameLen + 2;
+                break;
+            case RecordDecoder::NOT_A_RECORD:
+                nbNoise++;
+                p++;
+                break;
+            }
+            continue;
+        }
+
+        size_t e = p, limit = len - p > INGEST_MAX_LINE ? p + INGEST_MAX_LINE : len;
+
+        while (e < limit && data[e] != '\n' && data[e] != REC_DELIMITER)
+            e++;
+        if (e == limit) {
+            if (e - p == INGEST_MAX_LINE) {
+                nbNoise += e - p;
+                p = e;
+                continue;
+            }
+            if (!end)
+                break;          // Wait for the end of the line
+        }
+
+        parseLine((const char *)data + p, e > p && data[e - 1] == '\r' ? e - p - 1 : e - p);
+        p = e < len && data[e] == '\n' ? e + 1 : e;
+    }
+    return p;
+}
+
+/*
+ * Number parsing within a line, which isn't null terminated.  Each returns
+ * false when there is no number at s.
+ */
+static bool
+ParseUnsigned(const char *&s, const char *end, int base, unsigned &value) {
+    const char *start = s;
+
+    value = 0;
+    for (; s < end; s++) {
+        int d;
+
+        if (*s >= '0' && *s <= '9')
+            d = *s - '0';
+        else if (base == 16 && *s >= 'a' && *s <= 'f')
+            d = *s - 'a' + 10;
+        else if (base == 16 && *s >= 'A' && *s <= 'F')
+            d = *s - 'A' + 10;
+        else
+            break;
+        value = value * base + d;
+    }
+    return s != start;
+}
+
+// "-12.3" into -123
+static bool
+ParseDeci(const char *&s, const char *end, int &deci) {
+    bool negative = s < end && *s == '-';
+    unsigned whole, tenth = 0;
+
+    if (negative)
+        s++;
+    if (!ParseUnsigned(s, end, 10, whole))
+        return false;
+    if (s < end && *s == '.') {
+        s++;
+        if (s == end || *s < '0' || *s > '9')
+            return false;
+        tenth = *s++ - '0';
+    }
+    deci = whole * 10 + tenth;
+    if (negative)
+        deci = -deci;
+    return true;
+}
+
+// Position just after what in line, or NULL
+static const char *
+After(const char *line, const char *end, const char *what) {
+    size_t len = strlen(what);
+    const char *p = (const char *)memmem(line, end - line, what, len);
+
+    return p != NULL ? p + len : NULL;
+}
+
+/*
+ * "Stats: isr=812 cyc=117301 itp=310 ...", keys of other firmwares are
+ * skipped and missing ones left at 0.
+ */
+bool
+IngestParser::parseStats(const char *line, const char *end) {
+    const char *p = line + 7;
+    RadioStatsLine stats;
+
+    if (end - line < 7 || memcmp(line, "Stats: ", 7) != 0)
+        return false;
+    memset(&stats, 0, sizeof(stats));
+    while (p < end) {
+        const char *key = p, *eq = (const char *)memchr(p, '=', end - p);
+        unsigned value;
+
+        if (eq == NULL)
+            return false;
+        p = eq + 1;
+        if (!ParseUnsigned(p, end, 10, value))
+            return false;
+        for (unsigned i = 0; i < RADIO_STAT_COUNT; i++) {
+            if (strlen(RadioStatNames[i]) == (size_t)(eq - key) && memcmp(RadioStatNames[i], key, eq - key) == 0)
+                stats.value[i] = value;
+        }
+        while (p < end && *p == ' ')
+            p++;
+    }
+    nbStats++;
+    statsHandler(stats, statsContext);
+    return true;
+}
+
+/*
+ * Text readings are the event log line of a decoded frame:
+ *   [RESET!  ]Len: 9 - Id: 0x1a - Misc: 0 - Batt: 0 - Temp: -4.6C (23.7F) Hygro: 65%
+ * or with "Temp channel: 7d" instead of the hygro.  Older firmwares printed a
+ * negative sign before " - Temp: ".
+ */
+void
+IngestParser::parseLine(const char *line, size_t len) {
+    const char *end = line + len, *p;
+    unsigned id, misc, batt, hygro;
+    int temp;
+    SensorRecord r;
+
+    if (len == 0)
+        return;
+    if (statsHandler != NULL && parseStats(line, end))
+        return;
+
+    if ((p = After(line, end, "Len: 9 - Id: 0x")) == NULL || !ParseUnsigned(p, end, 16, id) ||
+            (p = After(p, end, "Misc: ")) == NULL || !ParseUnsigned(p, end, 10, misc) ||
+            (p = After(p, end, "Batt: ")) == NULL || !ParseUnsigned(p, end, 10, batt)) {
+        nbOtherLines++;
+        return;
+    }
+    bool oldSign = p < end && *p == '-';
+    if ((p = After(p, end, " - Temp: ")) == NULL || !ParseDeci(p, end, temp)) {
+        nbOtherLines++;
+        return;
+    }
+    if (oldSign)
+        temp = -temp;
+
+    const char *h;
+    if ((h = After(p, end, "Hygro: ")) != NULL) {
+        if (!ParseUnsigned(h, end, 10, hygro)) {
+            nbOtherLines++;
+            return;
+        }
+    } else if ((h = After(p, end, "Temp channel: ")) == NULL || !ParseUnsigned(h, end, 16, hygro)) {
+        nbOtherLines++;
+        return;
+    }
+
+    r.sensorId = id;
+    r.flags = REC_FLAG_CRC_OK;
+    if (After(line, end, "RESET!") != NULL)
+        r.flags |= REC_FLAG_RESTART;
+    if (misc)
+        r.flags |= REC_FLAG_MISC;
+    if (batt)
+        r.flags |= REC_FLAG_WEAK_BATT;
+    r.temp = temp;
+    r.hygro = hygro;
+    r.stamp = 0;        // Not in the text
+    r.timeUs = 0;
+    nbText++;
+    handler(r, context);
+}
+
+IngestReader::IngestReader(int fd, IngestParser &parser, size_t bufferSize)
+    : fd(fd), parser(parser), size(bufferSize), used(0), nbBytes(0) {
+    buffer = (uint8_t *)malloc(size);
+}
+
+IngestReader::~IngestReader() {
+    free(buffer);
+}
+
+long
+IngestReader::poll(int timeoutMs) {
+    struct pollfd pfd;
+    long total = 0;
+    size_t done;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (::poll(&pfd, 1, timeoutMs) < 0)
+        return errno == EINTR ? 0 : -1;
+    if (pfd.revents == 0)
+        return 0;
+
+    for (;;) {
+        ssize_t n = read(fd, buffer + used, size - used);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (n <= 0) {
+            // End of file, or EIO on a pty whose other side was closed
+            parser.parse(buffer, used, true);
+            used = 0;
+            return total != 0 ? total : -1;
+        }
+
+        nbBytes += n;
+        total += n;
+        used += n;
+        parser.setHostTime(HostWallClockUs());
+        done = parser.parse(buffer, used);
+        memmove(buffer, buffer + done, used - done);
+        used -= done;
+    }
+    return total;
+}
+
+static speed_t
+Speed(unsigned long baud) {
+    switch (baud) {
+    case 9600:      return B9600;
+    case 19200:     return B19200;
+    case 38400:     return B38400;
+    case 115200:    return B115200;
+    case 230400:    return B230400;
+    default:        return B57600;
+    }
+}
+
+int
+IngestOpen(const char *path, unsigned long baud) {
+    struct termios t;
+    int fd;
+
+    if (strcmp(path, "-") == 0)
+        fd = dup(STDIN_FILENO);
+    else
+        fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0 && (errno == EACCES || errno == EROFS || errno == EISDIR))
+        fd = open(path, O_RDONLY | O_NOCTTY);
+    if (fd < 0)
+        return -1;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    if (isatty(fd)) {
+        if (tcgetattr(fd, &t) < 0) {
+            close(fd);
+            return -1;
+        }
+        cfmakeraw(&t);
+        cfsetispeed(&t, Speed(baud));
+        cfsetospeed(&t, Speed(baud));
+        t.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(fd, TCSANOW, &t);
+    }
+    return fd;
+}
@@ -0,0 +1,135 @@
+/*
+ * Ingest of the JeeLink serial output on the host.
+ *
+ * The firmware sends either text (the event log lines of each decoded IT+
+ * frame) or binary records (see SensorRecord.h), possibly mixed.  Both are
+ * turned into SensorRecord readings, binary ones with the host time of their
+ * firmware stamp once a sync record came (see FirmwareClock.h).  Summary
+ * records, sent when the firmware aggregates (see Aggregate.h), go to their
+ * own handler with the end of their interval rebased alike.  The "Stats:"
+ * lines sent on the 's' command (see RadioStats.h) are turned into
+ * RadioStatsLine.
+ *
+ * IngestReader reads from any file descriptor (serial device, pty, pipe or
+ * file) into a fixed size buffer, and IngestParser splits records in place
+ * in that buffer: memory use doesn't depend on the input.
+ */
+
+#ifndef Ingest_h
+#define Ingest_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "RecordDecoder.h"
+#include "FirmwareClock.h"
+
+// Text lines longer than this are dropped
+#define INGEST_MAX_LINE     256
+
+// Counters of a firmware "Stats:" line, in its order
+enum {
+    RADIO_STAT_ISR_CALLS,
+    RADIO_STAT_ISR_CYCLES,
+    RADIO_STAT_ITPLUS,
+    RADIO_STAT_OTHER,
+    RADIO_STAT_CRC,
+    RADIO_STAT_LENGTH,
+    RADIO_STAT_OVERFLOWS,
+    RADIO_STAT_FILTERED,
+    RADIO_STAT_HITS,
+    RADIO_STAT_KNOWN,
+    RADIO_STAT_NEW,
+    RADIO_STAT_EVICTIONS,
+    RADIO_STAT_COUNT
+};
+
+// Keys of the counters in the line, "isr", "cyc"...
+extern const char *const RadioStatNames[RADIO_STAT_COUNT];
+
+// The counters wrap at 32 bits
+struct RadioStatsLine {
+    unsigned long value[RADIO_STAT_COUNT];
+
+    // Counts since the previous line, with wrapping
+    unsigned long since(const RadioStatsLine &previous, unsigned counter) const;
+};
+
+class IngestParser {
+public:
+    typedef void (*Handler)(const SensorRecord &reading, void *context);
+    typedef void (*StatsHandler)(const RadioStatsLine &stats, void *context);
+    typedef void (*SummaryHandler)(const SummaryRecord &summary, void *context);
+
+    IngestParser(Handler handler, void *context);
+
+    // Stats lines are counted as other lines without a handler
+    void setStatsHandler(StatsHandler handler, void *context);
+
+    // Summary records are counted but dropped without a handler
+    void setSummaryHandler(SummaryHandler handler, void *context);
+
+    // Host wall clock when the data about to be parsed arrived, in us
+    void setHostTime(uint64_t us) { hostUs = us; }
+
+    const FirmwareClock &clock() const { return firmwareClock; }
+
+    /*
+     * Parse complete records from data and return the number of bytes used.
+     * The rest is the start of a record and must be passed again, followed
+     * by the next bytes.  With end set, the rest is parsed as is.
+     */
+    size_t parse(const uint8_t *data, size_t len, bool end = false);
+
+    unsigned long long textReadings() const { return nbText; }
+    unsigned long long binaryReadings() const { return nbBinary; }
+    unsigned long long syncRecords() const { return nbSync; }
+    unsigned long long summaryRecords() const { return nbSummary; }
+    unsigned long long crcErrors() const { return nbCrcErrors; }
+    unsigned long long statsLines() const { return nbStats; }
+    unsigned long long otherLines() const { return nbOtherLines; }
+    unsigned long long noiseBytes() const { return nbNoise; }
+
+private:
+    void parseLine(const char *line, size_t len);
+    bool parseStats(const char *line, const char *end);
+
+    Handler handler;
+    void *context;
+    StatsHandler statsHandler;
+    void *statsContext;
+    SummaryHandler summaryHandler;
+    void *summaryContext;
+    FirmwareClock firmwareClock;
+    uint64_t hostUs;
+    unsigned long long nbText, nbBinary, nbSync, nbSummary, nbCrcErrors, nbStats, nbOtherLines, nbNoise;
+};
+
+class IngestReader {
+public:
+    IngestReader(int fd, IngestParser &parser, size_t bufferSize = 65536);
+    ~IngestReader();
+
+    /*
+     * Wait up to timeoutMs for input, then read and parse everything
+     * available.  Returns the number of bytes read, 0 on timeout and -1 at
+     * end of file or on error.
+     */
+    long poll(int timeoutMs);
+
+    unsigned long long bytesRead() const { return nbBytes; }
+
+private:
+    int fd;
+    IngestParser &parser;
+    uint8_t *buffer;
+    size_t size, used;
+    unsigned long long nbBytes;
+};
+
+/*
+ * Open a serial device raw and non blocking, "-" is stdin.  Read-write when
+ * allowed, so that commands can be sent.  -1 on error.
+ */
+int IngestOpen(const char *path, unsigned long baud);
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * Check of the serial commands of the PiWeather sketch, PiWeather.ino being
+ * compiled as is into this program in place of Sketch.cpp.
+ *
+ *   piweather-sketch
+ *
+ * Registers sensors with the "<channel>,<id>a" command through loop(),
+ * checks the channel table and the ID bitmap of the registered-only filter,
+ * that malformed commands change nothing, that the registrations come back
+ * after a reset from the emulated EEPROM, and that "<channel>a" frees a
+ * channel for good.
+ */
+
+#include <avr/eeprom.h>
+
+#include "PiWeather.ino"
+
+static unsigned Errors;
+
+static void
+Check(bool ok, const char *what) {
+    if (!ok) {
+        printf("%s: failed\n", what);
+        Errors++;
+    }
+}
+
+// Type a command, handled by the next loop() pass
+static void
+Type(const char *Command) {
+    Serial.setInput(Command);
+    loop();
+}
+
+static bool
+Registered(byte Channel, byte id) {
+    return ITPlusChannels[Channel].SensorID == id && (ITPlusRegisteredIds[id >> 3] & 1 << (id & 7));
+}
+
+static bool
+Free(byte Channel) {
+    return ITPlusChannels[Channel].SensorID == 0xff;
+}
+
+int
+main() {
+    HostClockSet(1000000);
+    Serial.setSink(NULL);
+    HostEepromErase();
+    setup();
+    for (byte i = 0; i < ITPLUS_MAX_SENSORS; i++)
+        Check(Free(i), "blank EEPROM: nothing registered");
+
+    Type("2,17a");
+    Check(Registered(2, 17) && StalledSensors == 1, "register");
+    Type("14,63a0,5a");
+    Check(Registered(14, 63) && Registered(0, 5) && StalledSensors == 3, "two commands at once");
+
+    // Out of range channel or ID, a channel whose ID another character cut
+    Type("15,9a3,64a3,x9a");
+    Check(Free(3) && Free(9) && !(ITPlusRegisteredIds[9 >> 3] & 1 << (9 & 7)) && StalledSensors == 3,
+            "malformed commands ignored");
+
+    // A command split over loop() passes
+    Type("4,");
+    Type("33a");
+    Check(Registered(4, 33) && StalledSensors == 4, "split command");
+    Type("4a");
+
+    // Another sensor on channel 2, the former ID out of the filter
+    Type("2,40a");
+    Check(Registered(2, 40) && !(ITPlusRegisteredIds[17 >> 3] & 1 << (17 & 7)), "register again");
+
+    // Reset: the same registrations from the EEPROM
+    setup();
+    Check(Registered(0, 5) && Registered(2, 40) && Registered(14, 63) && StalledSensors == 3, "after a reset");
+
+    Type("14a");
+    Check(Free(14) && !(ITPlusRegisteredIds[63 >> 3] & 1 << (63 & 7)), "free");
+    setup();
+    Check(Free(14) && Registered(0, 5) && StalledSensors == 2, "freed after a reset");
+
+    // A corrupted EEPROM registers nothing
+    eeprom_write_byte(ITPLUS_EEPROM_ADDR, 6);
+    setup();
+    Check(Free(0) && Free(2) && StalledSensors == 0, "bad CRC");
+
+    printf("%u errors\n", Errors);
+    return Errors != 0;
+}
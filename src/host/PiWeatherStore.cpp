@@ -0,0 +1,540 @@
+/*
+ * Time-series store tool, see TimeSeriesStore.h
+ *
+ *   piweather-store info <dir>
+ *       Segments, readings and time span of each sensor.
+ *
+ *   piweather-store scan <dir> <sensor> [from [to]]
+ *       Print the readings of a sensor with from <= time < to (unix times)
+ *       as CSV: time,sensor id,temp (C),hygro,flags
+ *
+ *   piweather-store query <dir> <sensor> <step> [from [to]]
+ *       Print the rollups of a sensor by step seconds as CSV: start time,
+ *       sensor id,readings,temp min,avg,max (C),hygro avg
+ *
+ *   piweather-store rollup <dir> [threads]
+ *       Rebuild the rollups from the readings.
+ *
+ *   piweather-store compact <dir>
+ *       Seal the full segments left raw, see SeriesCodec.h.
+ *
+ *   piweather-store codec [readings]
+ *       Compress readings (default 10000000) of a synthetic TX29, check they
+ *       decode back and report the compression ratio and coding speeds.
+ *
+ *   piweather-store bench <dir> [years] [sensors] [interval]
+ *       Fill a new store and its rollups with years (default 5) of synthetic
+ *       readings for sensors (default 64) every interval seconds (default
+ *       60), then time range scans over it: the full history and the last
+ *       year of one sensor, the last day of each sensor and the full history
+ *       of all, with the segments raw then sealed.  Then time rollup
+ *       rebuilds, checking they match the incremental rollups (exiting 1
+ *       when they do not), and graph queries of each sensor.
+ */
+
+#include "RollupStore.h"
+#include "SensorRecord.h"
+#include "SeriesCodec.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_START     1577836800u     // 2020-01-01 00:00 UTC
+
+static double
+NowSeconds() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+struct Summary {
+    size_t count;
+    uint32_t first, last;
+    long long tempSum;
+    int16_t tempMin, tempMax;
+};
+
+static void
+Summarize(const TimeSeriesChunk &chunk, void *context) {
+    Summary *s = (Summary *)context;
+
+    if (s->count == 0) {
+        s->first = chunk.time[0];
+        s->tempMin = s->tempMax = chunk.temp[0];
+    }
+    s->last = chunk.time[chunk.count - 1];
+    for (size_t i = 0; i < chunk.count; i++) {
+        s->tempSum += chunk.temp[i];
+        if (chunk.temp[i] < s->tempMin)
+            s->tempMin = chunk.temp[i];
+        if (chunk.temp[i] > s->tempMax)
+            s->tempMax = chunk.temp[i];
+    }
+    s->count += chunk.count;
+}
+
+static Summary
+ScanSummary(TimeSeriesStore &store, uint8_t sensorId, uint32_t from, uint32_t to) {
+    Summary s;
+
+    memset(&s, 0, sizeof(s));
+    store.scan(sensorId, from, to, Summarize, &s);
+    return s;
+}
+
+static void
+PrintChunk(const TimeSeriesChunk &chunk, void *) {
+    for (size_t i = 0; i < chunk.count; i++) {
+        int temp = chunk.temp[i] < 0 ? -chunk.temp[i] : chunk.temp[i];
+
+        printf("%lu,%u,%s%d.%d,%u,%02x\n", (unsigned long)chunk.time[i], chunk.sensorId,
+                chunk.temp[i] < 0 ? "-" : "", temp / 10, temp % 10, chunk.hygro[i], chunk.flags[i]);
+    }
+}
+
+static void
+PrintPoint(uint8_t sensorId, const RollupPoint &p, void *) {
+    printf("%lu,%u,%lu,%.1f,%.2f,%.1f,%.1f\n", (unsigned long)p.start, sensorId, (unsigned long)p.count,
+            p.tempMin / 10.0, (double)p.tempSum / p.count / 10.0, p.tempMax / 10.0,
+            (double)p.hygroSum / p.count);
+}
+
+static void
+DigestPoint(uint8_t sensorId, const RollupPoint &p, void *context) {
+    uint64_t *digest = (uint64_t *)context;
+    int64_t values[] = { sensorId, p.start, p.count, p.tempMin, p.tempMax, p.tempSum, (int64_t)p.hygroSum };
+
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+        *digest = (*digest ^ (uint64_t)values[i]) * 1099511628211ull;
+}
+
+// Digest of the 5 minute rollups of all the sensors
+static uint64_t
+RollupDigest(RollupStore &rollups) {
+    uint64_t digest = 14695981039346656037ull;
+
+    for (int i = 0; i < TS_MAX_SENSORS; i++)
+        rollups.query(i, 0, UINT32_MAX, RollupStore::resolutions[0], DigestPoint, &digest);
+    return digest;
+}
+
+static void
+CountPoint(uint8_t, const RollupPoint &, void *) {
+}
+
+static int
+Info(const char *dir) {
+    TimeSeriesStore store;
+
+    if (!store.open(dir, false)) {
+        perror(dir);
+        return 1;
+    }
+    printf("sensor segments  readings  first       last        temp min/avg/max\n");
+    for (int i = 0; i < TS_MAX_SENSORS; i++) {
+        Summary s = ScanSummary(store, i, 0, UINT32_MAX);
+
+        if (s.count == 0)
+            continue;
+        printf("%6d %8zu %9zu  %10lu  %10lu  %.1f/%.1f/%.1f\n", i, store.segments(i), s.count,
+                (unsigned long)s.first, (unsigned long)s.last, s.tempMin / 10.0,
+                s.tempSum / 10.0 / s.count, s.tempMax / 10.0);
+    }
+    return 0;
+}
+
+static int
+Scan(const char *dir, int sensorId, uint32_t from, uint32_t to) {
+    TimeSeriesStore store;
+
+    if (sensorId < 0 || sensorId >= TS_MAX_SENSORS) {
+        fprintf(stderr, "sensor id must be 0 to %d\n", TS_MAX_SENSORS - 1);
+        return 1;
+    }
+    if (!store.open(dir, false)) {
+        perror(dir);
+        return 1;
+    }
+    store.scan(sensorId, from, to, PrintChunk, NULL);
+    return 0;
+}
+
+static int
+Query(const char *dir, int sensorId, uint32_t step, uint32_t from, uint32_t to) {
+    TimeSeriesStore store;
+    RollupStore rollups;
+
+    if (sensorId < 0 || sensorId >= TS_MAX_SENSORS || step == 0) {
+        fprintf(stderr, "sensor id must be 0 to %d and step over 0\n", TS_MAX_SENSORS - 1);
+        return 1;
+    }
+    if (!store.open(dir, false) || !rollups.open(store, false)) {
+        perror(dir);
+        return 1;
+    }
+    rollups.query(sensorId, from, to, step, PrintPoint, NULL);
+    return 0;
+}
+
+static int
+Rollup(const char *dir, unsigned threads) {
+    TimeSeriesStore store;
+    RollupStore rollups;
+
+    if (!store.open(dir, false) || !rollups.open(store, true, threads) || !rollups.rebuild(threads)) {
+        perror(dir);
+        return 1;
+    }
+    return 0;
+}
+
+// Outdoor like temperature: seasonal and daily swings, tenths of degree
+static int16_t
+SyntheticTemp(uint32_t t, int sensorId) {
+    double day = (t - BENCH_START) / 86400.0;
+
+    return (int16_t)lround(100 + sensorId * 3 - 120 * cos(day * 2 * M_PI / 365.25) -
+            50 * cos((day - floor(day)) * 2 * M_PI));
+}
+
+/*
+ * Disk usage of the segment files of a store, dropping them from the page
+ * cache for cold scans.
+ */
+static unsigned long long
+SegmentBytes(const char *dir, bool drop) {
+    unsigned long long bytes = 0;
+
+    for (int i = 0; i < TS_MAX_SENSORS; i++) {
+        char sensorDir[PATH_MAX];
+        struct dirent *e;
+        DIR *d;
+
+        if (snprintf(sensorDir, sizeof(sensorDir), "%s/%02d", dir, i) >= (int)sizeof(sensorDir) ||
+                (d = opendir(sensorDir)) == NULL)
+            continue;
+        while ((e = readdir(d)) != NULL) {
+            char path[PATH_MAX];
+            struct stat st;
+            int fd;
+
+            if (strstr(e->d_name, ".seg") == NULL)
+                continue;
+            if (snprintf(path, sizeof(path), "%s/%s", sensorDir, e->d_name) >= (int)sizeof(path) ||
+                    (fd = open(path, O_RDONLY)) < 0)
+                continue;
+            if (fstat(fd, &st) == 0)
+                bytes += st.st_blocks * 512ull;
+            if (drop) {
+                fdatasync(fd);
+                posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            }
+            close(fd);
+        }
+        closedir(d);
+    }
+    return bytes;
+}
+
+static void
+ScanBench(TimeSeriesStore &store, const char *dir, const char *kind, int nbSensors, uint32_t end) {
+    unsigned long long total = 0, bytes;
+    double start, elapsed;
+    Summary s;
+
+    for (int i = 0; i < nbSensors; i++)
+        total += store.readings(i);
+    bytes = SegmentBytes(dir, true);
+    printf("%s segments: %.1f MB on disk, %.2f bytes per reading\n", kind, bytes / 1e6,
+            (double)bytes / total);
+
+    for (int pass = 0; pass < 2; pass++) {
+        start = NowSeconds();
+        s = ScanSummary(store, 0, 0, UINT32_MAX);
+        elapsed = NowSeconds() - start;
+        printf("%s full history of sensor 0, %s: %zu readings in %.2f ms, %.0f M readings/s "
+                "(avg %.2f C)\n", kind, pass == 0 ? "cold" : "cached", s.count, elapsed * 1e3,
+                s.count / elapsed / 1e6, s.tempSum / 10.0 / s.count);
+    }
+
+    start = NowSeconds();
+    s = ScanSummary(store, nbSensors - 1, end - 365 * 86400, end);
+    elapsed = NowSeconds() - start;
+    printf("%s last year of sensor %d: %zu readings in %.2f ms\n", kind, nbSensors - 1, s.count,
+            elapsed * 1e3);
+
+    start = NowSeconds();
+    total = 0;
+    for (int i = 0; i < nbSensors; i++)
+        total += ScanSummary(store, i, end - 86400, end).count;
+    elapsed = NowSeconds() - start;
+    printf("%s last day of each sensor: %llu readings in %.3f ms, %.1f us per sensor\n", kind, total,
+            elapsed * 1e3, elapsed * 1e6 / nbSensors);
+
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 0)
+            SegmentBytes(dir, true);
+        start = NowSeconds();
+        total = 0;
+        for (int i = 0; i < nbSensors; i++)
+            total += ScanSummary(store, i, 0, UINT32_MAX).count;
+        elapsed = NowSeconds() - start;
+        printf("%s full history of all sensors, %s: %llu readings in %.2f s, %.0f M readings/s\n", kind,
+                pass == 0 ? "cold" : "cached", total, elapsed, total / elapsed / 1e6);
+    }
+}
+
+// Synthetic TX29: a reading every 4 or 5 s, temperature and hygro slowly walking
+static int
+Codec(unsigned long readings) {
+    std::vector<uint32_t> time(readings);
+    std::vector<int16_t> temp(readings);
+    std::vector<uint8_t> hygro(readings), flags(readings);
+    std::vector<SeriesEncoder *> segments;
+    uint32_t t = BENCH_START, decoded[SERIES_BLOCK];
+    int16_t te = 150, decodedTemp[SERIES_BLOCK];
+    uint8_t h = 60, decodedHygro[SERIES_BLOCK], decodedFlags[SERIES_BLOCK];
+    unsigned long long bytes = 0, errors = 0, checksum = 0;
+    double start, encodeSeconds, decodeSeconds;
+
+    srand(1);
+    for (unsigned long i = 0; i < readings; i++) {
+        t += rand() % 5 == 0 ? 5 : 4;
+        if (rand() % 20 == 0)
+            te += rand() % 2 ? 1 : -1;
+        if (rand() % 50 == 0)
+            h += rand() % 2 ? 1 : -1;
+        time[i] = t;
+        temp[i] = te;
+        hygro[i] = h;
+        flags[i] = i % 100000 == 0 ? REC_FLAG_CRC_OK | REC_FLAG_RESTART : REC_FLAG_CRC_OK;
+    }
+
+    // A segment at a time, as when sealing
+    start = NowSeconds();
+    for (unsigned long i = 0; i < readings; i++) {
+        if (i % TS_SEGMENT_CAPACITY == 0)
+            segments.push_back(new SeriesEncoder);
+        segments.back()->add(time[i], temp[i], hygro[i], flags[i]);
+    }
+    for (size_t i = 0; i < segments.size(); i++) {
+        segments[i]->finish();
+        bytes += segments[i]->data().size() + segments[i]->blocks().size() * sizeof(SeriesBlock);
+    }
+    encodeSeconds = NowSeconds() - start;
+
+    for (int pass = 0; pass < 2; pass++) {
+        unsigned long n = 0;
+
+        start = NowSeconds();
+        for (size_t i = 0; i < segments.size(); i++) {
+            const std::vector<SeriesBlock> &blocks = segments[i]->blocks();
+            const std::vector<uint8_t> &data = segments[i]->data();
+
+            for (size_t j = 0; j < blocks.size(); j++) {
+                if (!SeriesDecode(blocks[j], data.data(), data.size(), decoded, decodedTemp, decodedHygro,
+                            decodedFlags)) {
+                    errors++;
+                    continue;
+                }
+                if (pass == 0) {
+                    for (unsigned k = 0; k < blocks[j].count; k++, n++) {
+                        if (decoded[k] != time[n] || decodedTemp[k] != temp[n] || decodedHygro[k] != hygro[n] ||
+                                decodedFlags[k] != flags[n])
+                            errors++;
+                    }
+                } else {
+                    checksum += decodedTemp[blocks[j].count - 1];
+                }
+            }
+        }
+        decodeSeconds = NowSeconds() - start;
+    }
+
+    printf("%lu readings, %llu bytes: %.2f bytes per reading, %.1fx smaller than the raw columns\n",
+            readings, bytes, (double)bytes / readings, readings * 8.0 / bytes);
+    printf("encode: %.1f M readings/s\n", readings / encodeSeconds / 1e6);
+    printf("decode: %.1f M readings/s, %.2f GB/s of columns, %.0f MB/s of compressed data "
+            "(checksum %llu)\n", readings / decodeSeconds / 1e6, readings * 8.0 / decodeSeconds / 1e9,
+            bytes / decodeSeconds / 1e6, checksum);
+    printf("%llu errors\n", errors);
+    for (size_t i = 0; i < segments.size(); i++)
+        delete segments[i];
+    return errors != 0;
+}
+
+static int
+Bench(const char *dir, double years, int nbSensors, unsigned interval) {
+    TimeSeriesStore store;
+    RollupStore rollups;
+    uint32_t end = BENCH_START + (uint32_t)(years * 365.25 * 86400), t;
+    unsigned long long total = 0;
+    unsigned threads = std::thread::hardware_concurrency();
+    struct stat st;
+    double start, elapsed;
+    uint64_t digest;
+    bool same = true, match;
+
+    if (stat(dir, &st) == 0) {
+        fprintf(stderr, "%s exists, the bench needs a new store\n", dir);
+        return 1;
+    }
+    if (!store.open(dir, true) || !rollups.open(store, true)) {
+        perror(dir);
+        return 1;
+    }
+    store.setCompression(false);
+
+    start = NowSeconds();
+    for (t = BENCH_START; t < end; t += interval) {
+        for (int i = 0; i < nbSensors; i++) {
+            int16_t temp = SyntheticTemp(t, i);
+            uint8_t hygro = 40 + i % 50;
+
+            if (!store.append(i, t, temp, hygro, 1) || !rollups.add(i, t, temp, hygro)) {
+                perror("append");
+                return 1;
+            }
+        }
+        total += nbSensors;
+    }
+    store.sync();
+    rollups.sync();
+    elapsed = NowSeconds() - start;
+    printf("append with rollups: %llu readings (%.1f years, %d sensors, every %u s) in %.2f s, "
+            "%.1f M readings/s\n", total, years, nbSensors, interval, elapsed, total / elapsed / 1e6);
+    digest = RollupDigest(rollups);
+    rollups.close();
+    store.close();
+
+    // Read only, as a query tool would
+    if (!store.open(dir, false)) {
+        perror(dir);
+        return 1;
+    }
+    ScanBench(store, dir, "raw", nbSensors, end);
+    store.close();
+
+    if (!store.open(dir, true)) {
+        perror(dir);
+        return 1;
+    }
+    start = NowSeconds();
+    if (!store.compact()) {
+        perror("compact");
+        return 1;
+    }
+    elapsed = NowSeconds() - start;
+    printf("sealing: %zu segments in %.2f s\n", store.sealedSegments(0) * nbSensors, elapsed);
+    store.close();
+    if (!store.open(dir, false)) {
+        perror(dir);
+        return 1;
+    }
+    ScanBench(store, dir, "sealed", nbSensors, end);
+
+    if (!rollups.open(store, true)) {
+        perror(dir);
+        return 1;
+    }
+    for (unsigned n = 1;; n = threads) {
+        start = NowSeconds();
+        if (!rollups.rebuild(n)) {
+            perror("rebuild");
+            return 1;
+        }
+        elapsed = NowSeconds() - start;
+        match = RollupDigest(rollups) == digest;
+        same &= match;
+        printf("rollup rebuild, %u threads: %.2f s, %s incremental rollups\n", n, elapsed,
+                match ? "same as" : "DIFFERENT FROM");
+        if (n == threads)
+            break;
+    }
+    rollups.close();
+
+    // Read only, as a grapher would
+    if (!rollups.open(store, false)) {
+        perror(dir);
+        return 1;
+    }
+    struct {
+        const char *name;
+        uint32_t from, step;
+    } queries[] = {
+        { "last year by day", end - 365 * 86400, 86400 },
+        { "last year in 800 points", end - 365 * 86400, 365 * 86400 / 800 },
+        { "last year by hour", end - 365 * 86400, 3600 },
+        { "full history in 1000 points", BENCH_START, (end - BENCH_START) / 1000 },
+        { "last week by 5 minutes", end - 7 * 86400, 300 },
+        { "last day by minute (raw)", end - 86400, 60 },
+    };
+    for (size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); q++) {
+        start = NowSeconds();
+        total = 0;
+        for (int i = 0; i < nbSensors; i++)
+            total += rollups.query(i, queries[q].from, end, queries[q].step, CountPoint, NULL);
+        elapsed = NowSeconds() - start;
+        printf("%s: %llu points per sensor from the %u s tier, %.1f us per sensor\n", queries[q].name,
+                total / nbSensors, RollupStore::tierFor(queries[q].step), elapsed * 1e6 / nbSensors);
+    }
+    return !same;
+}
+
+static void
+Usage() {
+    fprintf(stderr, "usage: piweather-store info <dir>\n"
+            "       piweather-store scan <dir> <sensor> [from [to]]\n"
+            "       piweather-store query <dir> <sensor> <step> [from [to]]\n"
+            "       piweather-store rollup <dir> [threads]\n"
+            "       piweather-store compact <dir>\n"
+            "       piweather-store codec [readings]\n"
+            "       piweather-store bench <dir> [years] [sensors] [interval]\n");
+}
+
+int
+main(int argc, char **argv) {
+    if (argc >= 3 && strcmp(argv[1], "info") == 0)
+        return Info(argv[2]);
+    if (argc >= 4 && strcmp(argv[1], "scan") == 0)
+        return Scan(argv[2], atoi(argv[3]), argc > 4 ? strtoul(argv[4], NULL, 0) : 0,
+                argc > 5 ? strtoul(argv[5], NULL, 0) : UINT32_MAX);
+    if (argc >= 5 && strcmp(argv[1], "query") == 0)
+        return Query(argv[2], atoi(argv[3]), strtoul(argv[4], NULL, 0),
+                argc > 5 ? strtoul(argv[5], NULL, 0) : 0, argc > 6 ? strtoul(argv[6], NULL, 0) : UINT32_MAX);
+    if (argc >= 3 && strcmp(argv[1], "rollup") == 0)
+        return Rollup(argv[2], argc > 3 ? atoi(argv[3]) : std::thread::hardware_concurrency());
+    if (argc >= 3 && strcmp(argv[1], "compact") == 0) {
+        TimeSeriesStore store;
+
+        if (!store.open(argv[2], true) || !store.compact()) {
+            perror(argv[2]);
+            return 1;
+        }
+        return 0;
+    }
+    if (argc >= 2 && strcmp(argv[1], "codec") == 0)
+        return Codec(argc > 2 ? strtoul(argv[2], NULL, 0) : 10000000);
+    if (argc >= 3 && strcmp(argv[1], "bench") == 0) {
+        int nbSensors = argc > 4 ? atoi(argv[4]) : TS_MAX_SENSORS;
+        int interval = argc > 5 ? atoi(argv[5]) : 60;
+
+        if (nbSensors < 1 || nbSensors > TS_MAX_SENSORS || interval < 1) {
+            Usage();
+            return 1;
+        }
+        return Bench(argv[2], argc > 3 ? atof(argv[3]) : 5, nbSensors, interval);
+    }
+    Usage();
+    return 1;
+}
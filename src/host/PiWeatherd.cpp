@@ -0,0 +1,231 @@
+/*
+ * PiWeather serial ingest daemon.
+ *
+ *   piweatherd [-b baud] [-q] [-s store] [-S seconds] <device>|-
+ *
+ * Reads the JeeLink output, text or binary mode, from a serial device (or
+ * any file, pty or pipe, "-" being stdin) and prints one CSV line per
+ * reading on stdout:
+ *
+ *   host time (s),firmware micros,sensor id,temp (C),hygro,flags
+ *
+ * In binary mode the host time is the one the frame started at, from its
+ * firmware stamp, once a sync record came (see FirmwareClock.h); otherwise
+ * it is the time the reading was parsed.
+ *
+ * When the firmware aggregates (see Aggregate.h), each summary record is
+ * printed as the interval mean, at the middle of the interval, followed by
+ * the frame count and the extremes:
+ *
+ *   host time (s),firmware micros,sensor id,temp (C),hygro,flags,count,tmin,tmax,hmin,hmax
+ *
+ * With -s the readings, and the means of summaries with frames, are also
+ * appended to a time-series store (see TimeSeriesStore.h) at their host time,
+ * and added to its rollups (see RollupStore.h), synced to disk every minute.
+ *
+ * With -S the firmware radio counters (see RadioStats.h) are queried every
+ * that many seconds, and on SIGUSR1.  Each reply is printed on stderr as the
+ * counts since the previous one (since the JeeLink reset for the first):
+ *
+ *   stats <host time>: isr=40 cyc=5866 ... evict=0 cyc/isr=146
+ *
+ * Counters are printed on stderr when the input ends or on SIGINT/SIGTERM.
+ */
+
+#include "Ingest.h"
+#include "RollupStore.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static volatile sig_atomic_t Stop = 0, QueryStats = 0;
+
+static void
+OnSignal(int) {
+    Stop = 1;
+}
+
+static void
+OnStatsSignal(int) {
+    QueryStats = 1;
+}
+
+struct Output {
+    bool quiet;
+    TimeSeriesStore *store;
+    RollupStore *rollups;
+    unsigned long long storeErrors;
+    RadioStatsLine lastStats;
+};
+
+static void
+StoreReading(Output *out, uint8_t sensorId, uint32_t now, int16_t temp, uint8_t hygro, uint8_t flags) {
+    // The clock offset estimate can step back a little
+    if (now < out->store->lastTime(sensorId))
+        now = out->store->lastTime(sensorId);
+    if (!out->store->append(sensorId, now, temp, hygro, flags) || !out->rollups->add(sensorId, now, temp, hygro))
+        out->storeErrors++;
+}
+
+static void
+PrintReading(const SensorRecord &r, void *context) {
+    Output *out = (Output *)context;
+    uint64_t us = r.timeUs != 0 ? r.timeUs : HostWallClockUs();
+    int temp = r.temp < 0 ? -r.temp : r.temp;
+
+    if (out->store != NULL)
+        StoreReading(out, r.sensorId, us / 1000000, r.temp, r.hygro, r.flags);
+    if (out->quiet)
+        return;
+    printf("%lu.%06lu,%lu,%u,%s%d.%d,%u,%02x\n", (unsigned long)(us / 1000000), (unsigned long)(us % 1000000),
+            (unsigned long)r.stamp, r.sensorId, r.temp < 0 ? "-" : "", temp / 10, temp % 10, r.hygro, r.flags);
+}
+
+// Tenths, rounded half away from zero
+static int
+Mean(long sum, unsigned count) {
+    return sum < 0 ? -(int)((-sum + count / 2) / count) : (int)((sum + count / 2) / count);
+}
+
+static void
+PrintSummary(const SummaryRecord &s, void *context) {
+    Output *out = (Output *)context;
+    uint64_t us = (s.timeUs != 0 ? s.timeUs : HostWallClockUs()) - s.interval * 500000ULL;
+    int temp, hygro;
+
+    // Nothing heard from the sensor in the interval
+    if (s.count == 0) {
+        if (!out->quiet)
+            printf("%lu.%06lu,%lu,%u,,,%02x,0,,,,\n", (unsigned long)(us / 1000000),
+                    (unsigned long)(us % 1000000), (unsigned long)s.stamp, s.sensorId, s.flags);
+        return;
+    }
+    temp = Mean(s.tempSum, s.count);
+    hygro = Mean(s.hygroSum, s.count);
+    if (out->store != NULL)
+        StoreReading(out, s.sensorId, us / 1000000, temp, hygro, s.flags);
+    if (out->quiet)
+        return;
+    printf("%lu.%06lu,%lu,%u,%s%d.%d,%d,%02x,%u,%s%d.%d,%s%d.%d,%u,%u\n", (unsigned long)(us / 1000000),
+            (unsigned long)(us % 1000000), (unsigned long)s.stamp, s.sensorId, temp < 0 ? "-" : "",
+            abs(temp) / 10, abs(temp) % 10, hygro, s.flags, s.count, s.tempMin < 0 ? "-" : "",
+            abs(s.tempMin) / 10, abs(s.tempMin) % 10, s.tempMax < 0 ? "-" : "", abs(s.tempMax) / 10,
+            abs(s.tempMax) % 10, s.hygroMin, s.hygroMax);
+}
+
+static void
+PrintStats(const RadioStatsLine &stats, void *context) {
+    Output *out = (Output *)context;
+    unsigned long calls = stats.since(out->lastStats, RADIO_STAT_ISR_CALLS);
+
+    fprintf(stderr, "stats %ld:", (long)time(NULL));
+    for (unsigned i = 0; i < RADIO_STAT_COUNT; i++)
+        fprintf(stderr, " %s=%lu", RadioStatNames[i], stats.since(out->lastStats, i));
+    if (calls != 0)
+        fprintf(stderr, " cyc/isr=%lu", stats.since(out->lastStats, RADIO_STAT_ISR_CYCLES) / calls);
+    fprintf(stderr, "\n");
+    out->lastStats = stats;
+}
+
+static void
+Usage() {
+    fprintf(stderr, "usage: piweatherd [-b baud] [-q] [-s store] [-S seconds] <device>|-\n");
+}
+
+int
+main(int argc, char **argv) {
+    unsigned long baud = 57600;
+    const char *storeDir = NULL;
+    TimeSeriesStore store;
+    RollupStore rollups;
+    Output out = { false, NULL, NULL, 0, RadioStatsLine() };
+    time_t lastSync, lastQuery;
+    unsigned long statsPeriod = 0;
+    bool queryFailed = false;
+    int opt, fd;
+
+    while ((opt = getopt(argc, argv, "b:qs:S:")) != -1) {
+        switch (opt) {
+        case 'b':
+            baud = strtoul(optarg, NULL, 0);
+            break;
+        case 'q':
+            out.quiet = true;
+            break;
+        case 's':
+            storeDir = optarg;
+            break;
+        case 'S':
+            statsPeriod = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            Usage();
+            return 1;
+        }
+    }
+    if (optind != argc - 1) {
+        Usage();
+        return 1;
+    }
+
+    if ((fd = IngestOpen(argv[optind], baud)) < 0) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    if (storeDir != NULL) {
+        if (!store.open(storeDir, true) || !rollups.open(store, true)) {
+            perror(storeDir);
+            return 1;
+        }
+        out.store = &store;
+        out.rollups = &rollups;
+    }
+
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+    signal(SIGUSR1, OnStatsSignal);
+
+    IngestParser parser(PrintReading, &out);
+    IngestReader reader(fd, parser);
+    parser.setStatsHandler(PrintStats, &out);
+    parser.setSummaryHandler(PrintSummary, &out);
+
+    lastSync = lastQuery = time(NULL);
+    QueryStats = statsPeriod != 0;
+    while (!Stop && reader.poll(1000) >= 0) {
+        fflush(stdout);
+        if (statsPeriod != 0 && time(NULL) - lastQuery >= (time_t)statsPeriod)
+            QueryStats = 1;
+        if (QueryStats) {
+            QueryStats = 0;
+            lastQuery = time(NULL);
+            if (write(fd, "s", 1) != 1 && !queryFailed) {
+                perror("stats query");
+                queryFailed = true;
+            }
+        }
+        if (out.store != NULL && time(NULL) - lastSync >= 60) {
+            store.sync();
+            rollups.sync();
+            lastSync = time(NULL);
+        }
+    }
+    if (out.store != NULL) {
+        rollups.close();
+        store.close();
+        if (out.storeErrors)
+            fprintf(stderr, "%llu readings not stored\n", out.storeErrors);
+    }
+
+    fprintf(stderr, "%llu bytes, %llu text readings, %llu binary readings, %llu sync records, "
+            "%llu summary records, %llu CRC errors, %llu stats lines, %llu other lines, %llu noise bytes\n",
+            reader.bytesRead(), parser.textReadings(), parser.binaryReadings(), parser.syncRecords(),
+            parser.summaryRecords(), parser.crcErrors(),
+            parser.statsLines(), parser.otherLines(), parser.noiseBytes());
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,256 @@
+/*
+ * Check of the IT+ frame ring of RF12_IT.cpp: rf12_interrupt() is run
+ * against a simulated RFM12B receiving bursts of frames while the
+ * loop() side drains the ring at its own pace.
+ *
+ *   rf12-ring [frames] [seed]
+ *
+ * The RFM12B model answers the FIFO reads with the bytes of the frames on
+ * the air, one interrupt per byte.  Restarting the sync pattern detection
+ * (rf12_rearm()) drops what is left of the frame being received, as the
+ * radio then waits for the next sync word.  Knowing how full the ring is,
+ * the check predicts which frames must be queued and which ones dropped,
+ * and compares that with what rf12_itplusFrame() hands over, in order and
+ * with their micros() stamp, and with rf12_ringOverflows.  It then checks
+ * the sensor ID filter and frames that aren't IT+ ones.
+ */
+
+#include "RF12_IT_ext.h"
+#include "RadioStats.h"
+#include <deque>
+#include <vector>
+
+#define RING_FRAMES     (ITPLUS_RX_RING - 1)    // One slot stays free
+
+// RF12 commands the model acts on, see RF12_IT.cpp
+#define RF_RX_FIFO_READ 0xB000
+#define RF_FIFO_FILL    0x0002
+
+struct AirFrame {
+    uint8_t bytes[ITPLUS_FRAME_LEN];
+    unsigned long stamp;
+};
+
+static std::deque<AirFrame> Air;
+static size_t AirPos;           // Next byte of Air.front()
+static uint16_t Command;
+static bool SecondByte;
+static unsigned long long BytesRead, Rearms;
+
+static uint8_t
+RadioTransfer(uint8_t out) {
+    if (!SecondByte) {
+        Command = out << 8;
+        SecondByte = true;
+        return 0;               // Status, nothing pending
+    }
+    SecondByte = false;
+    Command |= out;
+
+    if (Command == RF_RX_FIFO_READ && !Air.empty()) {
+        uint8_t in = Air.front().bytes[AirPos++];
+
+        BytesRead++;
+        if (AirPos == ITPLUS_FRAME_LEN) {
+            Air.pop_front();
+            AirPos = 0;
+        }
+        return in;
+    }
+    if ((Command & 0xff00) == 0xCA00 && !(Command & RF_FIFO_FILL)) {
+        Rearms++;
+        if (AirPos != 0) {
+            Air.pop_front();
+            AirPos = 0;
+        }
+    }
+    return 0;
+}
+
+// Interrupts until the frames on the air are received
+static void
+Receive() {
+    void (*isr)() = HostInterrupt(0);
+
+    while (!Air.empty()) {
+        if (AirPos == 0)
+            HostClockSet(Air.front().stamp);
+        isr();
+    }
+}
+
+static AirFrame
+MakeFrame(unsigned long seq, uint8_t id) {
+    AirFrame f;
+
+    f.bytes[0] = 0x90 | (id >> 2);
+    f.bytes[1] = (id & 3) << 6 | ((seq >> 16) & 0x3f);
+    f.bytes[2] = seq >> 8;
+    f.bytes[3] = seq;
+    f.bytes[4] = seq * 7;
+    f.stamp = seq * 1000 + 7;
+    return f;
+}
+
+static bool
+SameFrame(const uint8_t *got, uint32_t stamp, const AirFrame &want) {
+    return memcmp(got, want.bytes, ITPLUS_FRAME_LEN) == 0 && stamp == (uint32_t)want.stamp;
+}
+
+/*
+ * Release up to count frames from the ring, checking them against what
+ * was predicted to be queued
+ */
+static unsigned
+Drain(std::deque<AirFrame> &queued, unsigned count, unsigned long long &errors) {
+    const uint8_t *frame;
+    unsigned n = 0;
+
+    for (; n < count && (frame = rf12_itplusFrame()) != 0; n++) {
+        if (queued.empty() || !SameFrame(frame, rf12_itplusStamp(), queued.front())) {
+            if (errors++ < 10)
+                printf("frame %02x %02x %02x %02x %02x not the one expected\n", frame[0], frame[1],
+                        frame[2], frame[3], frame[4]);
+        }
+        if (!queued.empty())
+            queued.pop_front();
+        rf12_itplusRelease();
+    }
+    return n;
+}
+
+/*
+ * Send frames in bursts of 1 to 2 ring sizes, loop() draining 0 to 2 ring
+ * sizes of frames between them
+ */
+static unsigned long long
+Bursts(unsigned long frames, unsigned long &dropped) {
+    std::deque<AirFrame> queued;
+    unsigned long long errors = 0;
+    uint32_t overflows = rf12_ringOverflows;
+    unsigned long seq = 0;
+
+    dropped = 0;
+    while (seq < frames) {
+        unsigned burst = 1 + random() % (2 * ITPLUS_RX_RING);
+
+        for (unsigned i = 0; i < burst && seq < frames; i++, seq++) {
+            AirFrame f = MakeFrame(seq, seq % 64);
+
+            // The ring fills from the first byte of a frame
+            if (queued.size() < RING_FRAMES)
+                queued.push_back(f);
+            else
+                dropped++;
+            Air.push_back(f);
+            Receive();
+        }
+        Drain(queued, random() % (2 * ITPLUS_RX_RING + 1), errors);
+    }
+    Drain(queued, ~0u, errors);
+    if (!queued.empty()) {
+        printf("bursts: %zu frames never handed over\n", queued.size());
+        errors++;
+    }
+    if ((rf12_ringOverflows - overflows) != dropped) {
+        printf("bursts: %u overflows counted, %lu frames dropped\n",
+                (rf12_ringOverflows - overflows), dropped);
+        errors++;
+    }
+    return errors;
+}
+
+int
+main(int argc, char **argv) {
+    unsigned long frames = argc > 1 ? strtoul(argv[1], NULL, 0) : 100000, dropped;
+    unsigned long long errors = 0, bytes;
+    std::deque<AirFrame> queued;
+    uint8_t ids[8];
+
+    srandom(argc > 2 ? strtoul(argv[2], NULL, 0) : 1);
+    HostSpiTransfer = RadioTransfer;
+    rf12_initialize(1, RF12_868MHZ, 0xd4);
+    rf12_initialize_overide_ITP(868);
+    rf12_recvDone();            // Receiver on
+    if (HostInterrupt(0) == NULL) {
+        printf("rf12_initialize() attached no interrupt\n");
+        return 1;
+    }
+
+    // A burst longer than the ring while loop() is busy: the first frames
+    // are kept, each of the others counted as an overflow
+    uint32_t overflows = rf12_ringOverflows;
+    for (unsigned long seq = 0; seq < 3 * ITPLUS_RX_RING; seq++) {
+        Air.push_back(MakeFrame(seq, 1));
+        if (seq < RING_FRAMES)
+            queued.push_back(Air.back());
+    }
+    bytes = BytesRead;
+    Receive();
+    if ((rf12_ringOverflows - overflows) != 3 * ITPLUS_RX_RING - RING_FRAMES) {
+        printf("full ring: %u overflows, want %u\n", (rf12_ringOverflows - overflows),
+                3 * ITPLUS_RX_RING - RING_FRAMES);
+        errors++;
+    }
+    // Only the first byte of the dropped frames is read
+    if (BytesRead - bytes != RING_FRAMES * ITPLUS_FRAME_LEN + 3 * ITPLUS_RX_RING - RING_FRAMES) {
+        printf("full ring: %llu bytes read from the FIFO\n", BytesRead - bytes);
+        errors++;
+    }
+    if (Drain(queued, ~0u, errors) != RING_FRAMES || !queued.empty()) {
+        printf("full ring: frames missing\n");
+        errors++;
+    }
+    printf("full ring:   %u frames sent at once, %u queued, %u overflows\n", 3 * ITPLUS_RX_RING,
+            RING_FRAMES, (rf12_ringOverflows - overflows));
+
+    // Many times around the ring, the producer and consumer indexes wrapping
+    errors += Bursts(frames, dropped);
+    printf("bursts:      %lu frames, %lu dropped on a full ring, %lu wraps of the ring\n", frames, dropped,
+            (frames - dropped) / ITPLUS_RX_RING);
+
+    // Frames of sensors not in the filter stop after their ID
+    memset(ids, 0, sizeof(ids));
+    for (uint8_t id = 0; id < 64; id += 2)
+        ids[id >> 3] |= 1 << (id & 7);
+    rf12_itplusFilter(ids);
+    uint32_t filtered = rf12_itplusFiltered;
+    bytes = BytesRead;
+    for (unsigned long seq = 0; seq < RING_FRAMES; seq++) {
+        Air.push_back(MakeFrame(seq, seq));
+        if (seq % 2 == 0)
+            queued.push_back(Air.back());
+    }
+    Receive();
+    if ((rf12_itplusFiltered - filtered) != RING_FRAMES / 2 ||
+            BytesRead - bytes != (RING_FRAMES + 1) / 2 * ITPLUS_FRAME_LEN + RING_FRAMES / 2 * 2) {
+        printf("filter: %u filtered, %llu bytes read\n", (rf12_itplusFiltered - filtered),
+                BytesRead - bytes);
+        errors++;
+    }
+    if (Drain(queued, ~0u, errors) != (RING_FRAMES + 1) / 2 || !queued.empty()) {
+        printf("filter: frames missing\n");
+        errors++;
+    }
+    rf12_itplusFilter(0);
+    printf("filter:      %u of %u frames dropped after 2 bytes\n", (rf12_itplusFiltered - filtered),
+            RING_FRAMES);
+
+    // Not IT+, the receiver restarts after the first byte
+    uint32_t others = RadioStats.OtherFrames;
+    AirFrame jee = MakeFrame(0, 0);
+    jee.bytes[0] = 0x55;
+    Air.push_back(jee);
+    Air.push_back(MakeFrame(1, 0));
+    queued.push_back(Air.back());
+    bytes = BytesRead;
+    Receive();
+    if ((RadioStats.OtherFrames - others) != 1 || BytesRead - bytes != 1 + ITPLUS_FRAME_LEN ||
+            Drain(queued, ~0u, errors) != 1) {
+        printf("other frame: not skipped\n");
+        errors++;
+    }
+
+    printf("%llu errors\n", errors);
+    return errors != 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * Binary output mode decoder, see RecordDecoder.h
+ */
+
+#include "RecordDecoder.h"
+
+#define ITPLUS_CRC_IMPL ITPLUS_CRC_TABLE
+#include "ITPlusCRC.h"
+
+RecordDecoder::RecordDecoder(Handler handler, void *context)
+    : handler(handler), syncHandler(NULL), summaryHandler(NULL), context(context), frameLen(0),
+      overflow(false), nbRecords(0), nbSyncs(0), nbSummaries(0), nbCrcErrors(0), nbNoise(0) {
+}
+
+void
+RecordDecoder::feed(const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = data[i];
+
+        if (c == REC_DELIMITER) {
+            endOfFrame();
+        } else if (frameLen < sizeof(frame)) {
+            frame[frameLen++] = c;
+        } else {
+            overflow = true;
+            nbNoise++;
+        }
+    }
+}
+
+static inline uint16_t
+GetWord(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t
+GetLong(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/*
+ * Undo COBS: each code byte gives the distance to the next one, with a 0
+ * between the two unless the code is 0xff.
+ */
+RecordDecoder::Result
+RecordDecoder::decode(const uint8_t *frame, size_t len, LinkRecord &link) {
+    uint8_t record[REC_MAX_LEN];
+    size_t in = 0, out = 0, recordLen;
+
+    if (len == COBS_LEN(REC_SENSOR_LEN))
+        recordLen = REC_SENSOR_LEN;
+    else if (len == COBS_LEN(REC_SUMMARY_LEN))
+        recordLen = REC_SUMMARY_LEN;
+    else
+        return NOT_A_RECORD;
+
+    while (in < len) {
+        uint8_t code = frame[in++];
+
+        if (code == 0 || in + code - 1 > len)
+            return NOT_A_RECORD;
+        for (uint8_t k = 1; k < code; k++)
+            record[out++] = frame[in++];
+        if (code != 0xff && in < len)
+            record[out++] = 0;
+    }
+    if (out != recordLen)
+        return NOT_A_RECORD;
+    if (recordLen == REC_SENSOR_LEN ? record[0] != REC_SENSOR && record[0] != REC_SYNC : record[0] != REC_SUMMARY)
+        return NOT_A_RECORD;
+    if (ITPlusCRC8<ITPLUS_CRC_IMPL>(record, recordLen, 0) != 0)
+        return CRC_ERROR;
+
+    if (record[0] == REC_SYNC) {
+        SyncRecord &sync = link.sync;
+
+        sync.micros = GetLong(record + 1);
+        sync.uptime = GetLong(record + 5);
+        return SYNC;
+    }
+    if (record[0] == REC_SUMMARY) {
+        SummaryRecord &s = link.summary;
+
+        s.sensorId = record[1];
+        s.flags = record[2];
+        s.interval = GetWord(record + 3);
+        s.count = GetWord(record + 5);
+        s.tempMin = (int16_t)GetWord(record + 7);
+        s.tempMax = (int16_t)GetWord(record + 9);
+        s.tempSum = (int32_t)GetLong(record + 11);
+        s.hygroMin = record[15];
+        s.hygroMax = record[16];
+        s.hygroSum = GetLong(record + 17);
+        s.stamp = GetLong(record + 21);
+        s.timeUs = 0;
+        return SUMMARY;
+    }
+
+    SensorRecord &r = link.sensor;
+
+    r.sensorId = record[1];
+    r.flags = record[2];
+    r.temp = (int16_t)(record[3] | (record[4] << 8));
+    r.hygro = record[5];
+    r.stamp = GetLong(record + 6);
+    r.timeUs = 0;
+    return RECORD;
+}
+
+void
+RecordDecoder::endOfFrame() {
+    LinkRecord r;
+
+    switch (overflow ? NOT_A_RECORD : decode(frame, frameLen, r)) {
+    case RECORD:
+        nbRecords++;
+        handler(r.sensor, context);
+        break;
+    case SYNC:
+        nbSyncs++;
+        if (syncHandler != NULL)
+            syncHandler(r.sync, context);
+        break;
+    case SUMMARY:
+        nbSummaries++;
+        if (summaryHandler != NULL)
+            summaryHandler(r.summary, context);
+        break;
+    case CRC_ERROR:
+        nbCrcErrors++;
+        break;
+    case NOT_A_RECORD:
+        nbNoise += frameLen;
+        break;
+    }
+
+    frameLen = 0;
+    overflow = false;
+}
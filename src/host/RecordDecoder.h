@@ -0,0 +1,94 @@
+/*
+ * Host side decoder of the JeeLink binary output mode, see SensorRecord.h
+ * for the wire format.
+ *
+ * Bytes read from the serial port are fed as they come, in chunks of any
+ * size; a handler is called for each valid sensor record, and the sync and
+ * summary handlers, if any, for the other records.  Text the firmware may
+ * send between records is counted as noise and skipped.
+ */
+
+#ifndef RecordDecoder_h
+#define RecordDecoder_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SensorRecord.h"
+
+struct SensorRecord {
+    uint8_t sensorId;
+    uint8_t flags;          // REC_FLAG_*
+    int16_t temp;           // Tenths of degree Celsius
+    uint8_t hygro;
+    uint32_t stamp;         // Firmware micros() at the start of the frame
+    uint64_t timeUs;        // Host wall clock of stamp, 0 if unknown (see FirmwareClock.h)
+};
+
+struct SyncRecord {
+    uint32_t micros;        // Firmware micros() when sent
+    uint32_t uptime;        // Seconds since the JeeLink reset
+};
+
+// Frames of a registered sensor over an interval, see Aggregate.h
+struct SummaryRecord {
+    uint8_t sensorId;
+    uint8_t flags;          // REC_FLAG_* of any of the frames
+    uint16_t interval;      // Seconds
+    uint16_t count;         // Frames, the rest is 0 when none
+    int16_t tempMin, tempMax;
+    int32_t tempSum;
+    uint8_t hygroMin, hygroMax;
+    uint32_t hygroSum;
+    uint32_t stamp;         // Firmware micros() at the end of the interval
+    uint64_t timeUs;        // Host wall clock of stamp, 0 if unknown
+};
+
+// One of the records, as told by decode()
+struct LinkRecord {
+    SensorRecord sensor;
+    SyncRecord sync;
+    SummaryRecord summary;
+};
+
+class RecordDecoder {
+public:
+    typedef void (*Handler)(const SensorRecord &record, void *context);
+    typedef void (*SyncHandler)(const SyncRecord &sync, void *context);
+    typedef void (*SummaryHandler)(const SummaryRecord &summary, void *context);
+
+    enum Result { RECORD, SYNC, SUMMARY, CRC_ERROR, NOT_A_RECORD };
+
+    RecordDecoder(Handler handler, void *context);
+
+    // Called with the context given above
+    void setSyncHandler(SyncHandler handler) { syncHandler = handler; }
+    void setSummaryHandler(SummaryHandler handler) { summaryHandler = handler; }
+
+    // Decode one COBS frame, without its delimiters
+    static Result decode(const uint8_t *frame, size_t len, LinkRecord &record);
+
+    void feed(const uint8_t *data, size_t len);
+
+    unsigned long long records() const { return nbRecords; }
+    unsigned long long syncs() const { return nbSyncs; }
+    unsigned long long summaries() const { return nbSummaries; }
+    unsigned long long crcErrors() const { return nbCrcErrors; }
+    unsigned long long noiseBytes() const { return nbNoise; }
+
+private:
+    void endOfFrame();
+
+    Handler handler;
+    SyncHandler syncHandler;
+    SummaryHandler summaryHandler;
+    void *context;
+
+    // Encoded bytes since the last delimiter; overflow means it isn't a record
+    uint8_t frame[COBS_LEN(REC_MAX_LEN)];
+    size_t frameLen;
+    bool overflow;
+
+    unsigned long long nbRecords, nbSyncs, nbSummaries, nbCrcErrors, nbNoise;
+};
+
+#endif
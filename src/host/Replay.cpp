@@ -0,0 +1,148 @@
+/*
+ * Replay helpers shared by the itplus-replay modes, see Replay.h.
+ */
+
+#include "Replay.h"
+#include "ITPlusRX_ext.h"
+#include "EventLog.h"
+#include "BinaryOutput.h"
+#include "FleetEmulator.h"
+#include <string.h>
+#include <time.h>
+
+/*
+ * Count heap allocations made while decoding by interposing malloc.  Not
+ * possible under ASan, which provides its own malloc.
+ */
+unsigned long long Allocations = 0;
+
+#if COUNT_ALLOCS
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *
+malloc(size_t size) {
+    Allocations++;
+    return __libc_malloc(size);
+}
+
+void *
+calloc(size_t n, size_t size) {
+    Allocations++;
+    return __libc_calloc(n, size);
+}
+
+void *
+realloc(void *ptr, size_t size) {
+    Allocations++;
+    return __libc_realloc(ptr, size);
+}
+}
+#endif
+
+double
+NowSeconds() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+bool
+ReadFile(const char *name, std::vector<byte> &data) {
+    byte buf[4096];
+    size_t n;
+    FILE *f;
+
+    if ((f = fopen(name, "rb")) == NULL) {
+        perror(name);
+        return false;
+    }
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        data.insert(data.end(), buf, buf + n);
+    fclose(f);
+    return true;
+}
+
+bool
+WriteFile(const char *name, const void *data, size_t len) {
+    FILE *f = strcmp(name, "-") == 0 ? stdout : fopen(name, "wb");
+    bool ok;
+
+    if (f == NULL) {
+        perror(name);
+        return false;
+    }
+    ok = fwrite(data, 1, len, f) == len;
+    if (f != stdout)
+        ok = fclose(f) == 0 && ok;
+    else
+        fflush(f);
+    return ok;
+}
+
+void
+ReplayPass(const std::vector<byte> &corpus, unsigned long long frames, bool logging, PassResult &r) {
+    size_t nbFrames = corpus.size() / ITPLUS_FRAME_LEN, next = 0;
+    unsigned long long stepUs = ITPLUS_TX_PERIOD * 1000ULL / nbFrames, clockUs = 0;
+    double start;
+
+    ITPlusRXSetup();
+    EventLogEnabled = logging;
+    r.frameSeconds = r.drainSeconds = 0;
+    r.allocs = Allocations;
+    r.bytes = Serial.bytesWritten();
+
+    for (unsigned long long i = 0; i < frames; i++) {
+        HostClockSet(clockUs += stepUs);
+        start = NowSeconds();
+        ProcessITPlusFrame(&corpus[next * ITPLUS_FRAME_LEN], micros());
+        r.frameSeconds += NowSeconds() - start;
+        if (logging) {
+            start = NowSeconds();
+            while (EventLogDrain(EVENT_LOG_RING) != 0)
+                ;
+            r.drainSeconds += NowSeconds() - start;
+        }
+        if (++next == nbFrames)
+            next = 0;
+    }
+
+    r.allocs = Allocations - r.allocs;
+    r.bytes = Serial.bytesWritten() - r.bytes;
+    EventLogEnabled = true;
+}
+
+void
+MakeFrame(byte *Frame, byte id, int raw) {
+    FleetEmulator::makeFrame(Frame, id, false, false, raw - 400, false, 0x6a);
+}
+
+bool
+CaptureOutput(const std::vector<byte> &corpus, unsigned long long frames, bool binary,
+        std::vector<uint8_t> &output) {
+    char *data = NULL;
+    size_t len = 0;
+    FILE *sink;
+    PassResult r;
+
+    if ((sink = open_memstream(&data, &len)) == NULL) {
+        perror("open_memstream");
+        return false;
+    }
+    Serial.setSink(sink);
+    BinaryOutput = binary;
+    ReplayPass(corpus, frames, !binary, r);
+    BinaryOutput = false;
+    Serial.setSink(NULL);
+    fclose(sink);
+    output.assign(data, data + len);
+    free(data);
+    return true;
+}
+
+void
+IgnoreReading(const SensorRecord &, void *) {
+}
@@ -0,0 +1,72 @@
+/*
+ * Replay helpers shared by the itplus-replay modes, see ITPlusReplay.cpp.
+ * Each mode is a function taking the arguments that follow its name.
+ */
+
+#ifndef Replay_H
+#define Replay_H
+
+#include "Arduino.h"
+#include "PiWeather.h"
+#include <stdio.h>
+#include <vector>
+
+// Heap allocations so far, 0 when they cannot be counted (COUNT_ALLOCS)
+extern unsigned long long Allocations;
+
+// Defined by Sketch.cpp in place of PiWeather.ino
+extern unsigned long FramesMissed;
+
+#if defined(__SANITIZE_ADDRESS__)
+#define COUNT_ALLOCS 0
+#else
+#define COUNT_ALLOCS 1
+#endif
+
+struct PassResult {
+    double frameSeconds, drainSeconds;
+    unsigned long long bytes, allocs;
+};
+
+struct SensorRecord;
+
+double NowSeconds();
+bool ReadFile(const char *name, std::vector<byte> &data);
+// name "-" for stdout
+bool WriteFile(const char *name, const void *data, size_t len);
+
+/*
+ * Push frames from the corpus, round robin, through ProcessITPlusFrame(),
+ * the clock advanced so that a pass over the corpus takes ITPLUS_TX_PERIOD.
+ * The event log is drained after each frame when logging.
+ */
+void ReplayPass(const std::vector<byte> &corpus, unsigned long long frames, bool logging, PassResult &r);
+
+// Firmware serial output for frames from the corpus, in binary or text mode
+bool CaptureOutput(const std::vector<byte> &corpus, unsigned long long frames, bool binary,
+        std::vector<uint8_t> &output);
+
+// Frame from sensor id for an IT+ raw temperature, 3 BCD digits of the temperature + 40 C
+void MakeFrame(byte *Frame, byte id, int raw);
+
+void IgnoreReading(const SensorRecord &, void *);
+
+// Modes, ReplayCorpus.cpp
+int Extract(int argc, char **argv);
+int Run(int argc, char **argv);
+int Log(char **argv);
+
+// ReplayFirmware.cpp
+int Registry(int argc, char **argv);
+int Temps(int argc, char **argv);
+int Report(int argc, char **argv);
+int CRC(int argc, char **argv);
+
+// ReplayOutput.cpp
+int Binary(int argc, char **argv);
+int IngestBench(int argc, char **argv);
+
+// ReplayFleet.cpp
+int Fleet(int argc, char **argv);
+
+#endif
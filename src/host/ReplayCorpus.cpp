@@ -0,0 +1,133 @@
+/*
+ * itplus-replay extract, run and log, see ITPlusReplay.cpp.
+ */
+
+#include "Replay.h"
+#include "ITPlusRX_ext.h"
+#include "EventLog.h"
+#include <ctype.h>
+#include <string.h>
+
+/*
+ * Frames follow a "GotIT+" marker, optionally with a colon, as 5 hex bytes
+ * on the same or the next line.
+ */
+static size_t
+ExtractFrames(FILE *in, std::vector<byte> &corpus) {
+    char line[256];
+    bool pending = false;
+    size_t count = 0;
+
+    while (fgets(line, sizeof(line), in) != NULL) {
+        char *p = strstr(line, "GotIT+");
+        unsigned int b[ITPLUS_FRAME_LEN];
+
+        if (p != NULL) {
+            p += strlen("GotIT+");
+            if (*p == ':')
+                p++;
+            pending = true;
+        } else if (pending) {
+            p = line;
+        } else {
+            continue;
+        }
+
+        while (isspace((unsigned char)*p))
+            p++;
+        if (*p == '\0')
+            continue;   // Frame bytes on the next line
+
+        pending = false;
+        if (sscanf(p, "%x %x %x %x %x", &b[0], &b[1], &b[2], &b[3], &b[4]) != ITPLUS_FRAME_LEN)
+            continue;
+        for (int i = 0; i < ITPLUS_FRAME_LEN; i++)
+            corpus.push_back(b[i]);
+        count++;
+    }
+    return count;
+}
+
+int
+Extract(int argc, char **argv) {
+    std::vector<byte> corpus;
+    FILE *f;
+
+    for (int i = 1; i < argc; i++) {
+        if ((f = fopen(argv[i], "r")) == NULL) {
+            perror(argv[i]);
+            return 1;
+        }
+        printf("%s: %zu frames\n", argv[i], ExtractFrames(f, corpus));
+        fclose(f);
+    }
+
+    if ((f = fopen(argv[0], "wb")) == NULL) {
+        perror(argv[0]);
+        return 1;
+    }
+    fwrite(corpus.data(), 1, corpus.size(), f);
+    fclose(f);
+    printf("%s: %zu frames\n", argv[0], corpus.size() / ITPLUS_FRAME_LEN);
+    return 0;
+}
+
+int
+Run(int argc, char **argv) {
+    std::vector<byte> corpus;
+    unsigned long long frames = 5000000;
+    size_t nbFrames;
+    PassResult r;
+
+    if (!ReadFile(argv[0], corpus))
+        return 1;
+    if (argc > 1)
+        frames = strtoull(argv[1], NULL, 0);
+
+    nbFrames = corpus.size() / ITPLUS_FRAME_LEN;
+    if (nbFrames == 0) {
+        fprintf(stderr, "%s: no frames\n", argv[0]);
+        return 1;
+    }
+
+    Serial.setSink(NULL);
+    printf("corpus:      %zu frames\n", nbFrames);
+    printf("replayed:    %llu frames per pass\n", frames);
+    printf("event log  frames/s   ns/frame  drain ns/frame  serial bytes/frame  allocs/frame\n");
+    for (int logging = 0; logging <= 1; logging++) {
+        ReplayPass(corpus, frames, logging, r);
+        printf("%-9s  %8.0f  %9.1f  %14.1f  %18.1f", logging ? "on" : "off",
+                frames / r.frameSeconds, r.frameSeconds * 1e9 / frames,
+                r.drainSeconds * 1e9 / frames, (double)r.bytes / frames);
+#if COUNT_ALLOCS
+        printf("  %12.3f\n", (double)r.allocs / frames);
+#else
+        printf("  %12s\n", "n/a (ASan)");
+#endif
+    }
+    return 0;
+}
+
+int
+Log(char **argv) {
+    std::vector<byte> capture;
+    Type_LogRecord Record;
+    size_t i = 0;
+
+    if (!ReadFile(argv[0], capture))
+        return 1;
+
+    while (i < capture.size()) {
+        if (capture[i] == EVENT_LOG_SYNC && i + 1 + sizeof(Record) <= capture.size() &&
+                capture[i + 1] >= EV_DROPPED && capture[i + 1] <= EV_LAST) {
+            memcpy(&Record, &capture[i + 1], sizeof(Record));
+            printf("[%5u] ", Record.Stamp);
+            fflush(stdout);
+            EventLogPrint(&Record);
+            i += 1 + sizeof(Record);
+        } else {
+            Serial.write(capture[i++]);
+        }
+    }
+    return 0;
+}
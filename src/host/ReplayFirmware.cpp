@@ -0,0 +1,245 @@
+/*
+ * itplus-replay registry, temps, report and crc: timing and checks of the
+ * firmware code on its own, see ITPlusReplay.cpp.
+ */
+
+#include "Replay.h"
+#include "ITPlusRX_ext.h"
+#include "EventLog.h"
+#include "Misc.h"
+#include "ITPlusCRC.h"
+#include <math.h>
+#include <string.h>
+
+static unsigned
+DiscoveredEntries(byte id) {
+    unsigned n = 0;
+
+    for (byte i = 0; i < ITPLUS_MAX_DISCOVER; i++)
+        n += DiscoveredITPlus[i].SensorID != 0xff && (DiscoveredITPlus[i].SensorID & ITPLUS_ID_MASK) == id;
+    return n;
+}
+
+/*
+ * A discovered sensor registered, then unregistered, keeps one discovered
+ * entry, found again when heard
+ */
+static unsigned
+CheckUnregister() {
+    unsigned errors = 0;
+
+    ITPlusRXSetup();
+    CheckITPlusRegistration(40, 205);
+    ITPlusRegister(0, 40);
+    errors += CheckITPlusRegistration(40, 206) != 0;
+    ITPlusRegister(0, 0xff);
+    DiscoveredITPlus[0].LastReceiveTimer = 0;
+    errors += CheckITPlusRegistration(40, 207) != 0xff;
+    errors += DiscoveredEntries(40) != 1 || DiscoveredITPlus[0].Temp != 207 ||
+        DiscoveredITPlus[0].LastReceiveTimer == 0;
+
+    // Its discovered entry evicted while it was registered
+    ITPlusRegister(1, 40);
+    for (byte id = 0; id < ITPLUS_MAX_DISCOVER; id++)
+        CheckITPlusRegistration(id, 205);
+    ITPlusRegister(1, 0xff);
+    errors += DiscoveredEntries(40) != 0;
+    CheckITPlusRegistration(40, 208);
+    errors += DiscoveredEntries(40) != 1;
+    return errors;
+}
+
+int
+Registry(int argc, char **argv) {
+    static const byte Counts[] = { 1, 2, 4, 8, 15, 16, 32, 48, 64 };
+    unsigned long long lookups = 5000000;
+    unsigned errors;
+    double start, elapsed;
+
+    if (argc > 0)
+        lookups = strtoull(argv[0], NULL, 0);
+    Serial.setSink(NULL);
+
+    errors = CheckUnregister();
+    printf("unregister:  %u errors\n", errors);
+
+    printf("sensors  registered  ns/lookup\n");
+    for (size_t c = 0; c < sizeof(Counts); c++) {
+        byte nbSensors = Counts[c], id = 0;
+
+        ITPlusRXSetup();
+        for (byte i = 0; i < nbSensors && i < ITPLUS_MAX_SENSORS; i++)
+            ITPlusRegister(i, i);
+
+        start = NowSeconds();
+        for (unsigned long long i = 0; i < lookups; i++) {
+            HostClockSet(i * 1000);
+            CheckITPlusRegistration(id, 205);
+            if (++id == nbSensors)
+                id = 0;
+        }
+        elapsed = NowSeconds() - start;
+        printf("%7d  %10d  %9.1f\n", nbSensors, nbSensors < ITPLUS_MAX_SENSORS ? nbSensors : ITPLUS_MAX_SENSORS,
+                elapsed * 1e9 / lookups);
+    }
+    return errors != 0;
+}
+
+int
+Temps(int argc, char **argv) {
+    unsigned long long conversions = 10000000;
+    unsigned errors = 0;
+    char got[8], want[16];
+    byte Frame[ITPLUS_FRAME_LEN];
+    volatile int16_t sink = 0;
+    double start, formatNs, convertNs;
+
+    if (argc > 0)
+        conversions = strtoull(argv[0], NULL, 0);
+    Serial.setSink(NULL);
+    ITPlusRXSetup();
+    ITPlusRegister(0, 0);
+
+    for (int raw = 0; raw <= 999; raw++) {
+        int16_t deci = raw - 400;
+        long wantF = lround((deci / 10.0 * 1.8 + 32) * 10);
+
+        MakeFrame(Frame, 0, raw);
+        ProcessITPlusFrame(Frame, micros());
+        if (ITPlusChannels[0].Temp != deci) {
+            printf("decode %03d: got %d, want %d\n", raw, ITPlusChannels[0].Temp, deci);
+            errors++;
+        }
+
+        FormatDeci(got, deci);
+        snprintf(want, sizeof(want), "%.1f", deci / 10.0);
+        if (strcmp(got, want) != 0) {
+            printf("format %d: got %s, want %s\n", deci, got, want);
+            errors++;
+        }
+
+        if (DeciCelsiusToFahrenheit(deci) != wantF) {
+            printf("fahrenheit %d: got %d, want %ld\n", deci, DeciCelsiusToFahrenheit(deci), wantF);
+            errors++;
+        }
+    }
+    printf("checked:     1000 temperatures, %u errors\n", errors);
+
+    start = NowSeconds();
+    for (unsigned long long i = 0; i < conversions; i++)
+        FormatDeci(got, (int16_t)(i % 1000) - 400);
+    formatNs = (NowSeconds() - start) * 1e9 / conversions;
+
+    start = NowSeconds();
+    for (unsigned long long i = 0; i < conversions; i++)
+        sink += DeciCelsiusToFahrenheit((int16_t)(i % 1000) - 400);
+    convertNs = (NowSeconds() - start) * 1e9 / conversions;
+
+    printf("FormatDeci:  %.1f ns\n", formatNs);
+    printf("C to F:      %.1f ns\n", convertNs);
+    return errors != 0;
+}
+
+int
+Report(int argc, char **argv) {
+    unsigned long long reports = 1000000, bytes;
+    byte Frame[ITPLUS_FRAME_LEN], Records = 0;
+    double start, elapsed;
+
+    if (argc > 0)
+        reports = strtoull(argv[0], NULL, 0);
+    Serial.setSink(NULL);
+    ITPlusRXSetup();
+
+    printf("sensors  bytes  ns/report\n");
+    for (byte nbSensors = 0; nbSensors <= ITPLUS_MAX_SENSORS; nbSensors++) {
+        if (nbSensors > 0) {
+            // Spread temperatures over the whole range, negative ones included
+            ITPlusRegister(nbSensors - 1, nbSensors - 1);
+            MakeFrame(Frame, nbSensors - 1, (nbSensors * 677) % 1000);
+            ProcessITPlusFrame(Frame, micros());
+        }
+        while (EventLogDrain(EVENT_LOG_RING) != 0)
+            ;
+
+        bytes = Serial.bytesWritten();
+        start = NowSeconds();
+        for (unsigned long long i = 0; i < reports; i++) {
+            Records = 0;
+            PrintITPlusRecords(Serial, &Records);
+        }
+        elapsed = NowSeconds() - start;
+        printf("%7d  %5llu  %9.1f\n", nbSensors, (Serial.bytesWritten() - bytes) / reports, elapsed * 1e9 / reports);
+    }
+
+    Serial.setSink(stdout);
+    Records = 0;
+    PrintITPlusRecords(Serial, &Records);
+    Serial.println();
+    return 0;
+}
+
+// ns per frame of one CRC implementation over the frames
+template <uint8_t Impl> static double
+CRCFrameNs(const std::vector<byte> &frames, unsigned long long passes, unsigned &sink) {
+    size_t nbFrames = frames.size() / ITPLUS_FRAME_LEN;
+    double start = NowSeconds();
+
+    for (unsigned long long p = 0; p < passes; p++) {
+        for (size_t i = 0; i < nbFrames; i++)
+            sink += ITPlusCRC8<Impl>(&frames[i * ITPLUS_FRAME_LEN], ITPLUS_FRAME_LEN, 0);
+    }
+    return (NowSeconds() - start) * 1e9 / (passes * nbFrames);
+}
+
+int
+CRC(int argc, char **argv) {
+    unsigned long long frames = 10000000, passes;
+    unsigned errors = 0, valid = 0, sink = 0;
+    std::vector<byte> corpus;
+    byte Frame[ITPLUS_FRAME_LEN];
+
+    if (argc > 0)
+        frames = strtoull(argv[0], NULL, 0);
+
+    // Every state and input byte of the update step, on which the CRC of
+    // any message only depends
+    for (unsigned crc = 0; crc < 256; crc++) {
+        for (unsigned data = 0; data < 256; data++) {
+            uint8_t bitwise = ITPlusCRC<ITPLUS_CRC_BITWISE>::Update(crc, data);
+            uint8_t nibble = ITPlusCRC<ITPLUS_CRC_NIBBLE>::Update(crc, data);
+            uint8_t table = ITPlusCRC<ITPLUS_CRC_TABLE>::Update(crc, data);
+
+            if (nibble != bitwise || table != bitwise) {
+                if (errors++ < 10)
+                    printf("update %02x %02x: bitwise %02x, nibble %02x, table %02x\n", crc, data, bitwise,
+                            nibble, table);
+            }
+        }
+    }
+
+    // A frame carrying its CRC checks to 0, a flipped bit is always seen
+    for (int raw = 0; raw <= 999; raw++) {
+        MakeFrame(Frame, raw % 64, raw);
+        valid += ITPlusCRC8<ITPLUS_CRC_IMPL>(Frame, ITPLUS_FRAME_LEN, 0) == 0;
+        for (int b = 0; b < ITPLUS_FRAME_LEN * 8; b++) {
+            Frame[b / 8] ^= 0x80 >> (b % 8);
+            if (ITPlusCRC8<ITPLUS_CRC_IMPL>(Frame, ITPLUS_FRAME_LEN, 0) == 0)
+                errors++;
+            Frame[b / 8] ^= 0x80 >> (b % 8);
+        }
+    }
+    errors += 1000 - valid;
+    printf("checked:     65536 update steps, 1000 frames and their 40000 single bit errors, %u errors\n",
+            errors);
+
+    // Random frames, as many as fit in the L1 cache with the table
+    srandom(1);
+    for (int i = 0; i < 1024 * ITPLUS_FRAME_LEN; i++)
+        corpus.push_back(random());
+    passes = frames / 1024 ? frames / 1024 : 1;
+    printf("bitwise:     %.1f ns/frame\n", CRCFrameNs<ITPLUS_CRC_BITWISE>(corpus, passes, sink));
+    printf("nibble:      %.1f ns/frame\n", CRCFrameNs<ITPLUS_CRC_NIBBLE>(corpus, passes, sink));
+    printf("table:       %.1f ns/frame\n", CRCFrameNs<ITPLUS_CRC_TABLE>(corpus, passes, sink));
+    return errors != 0 || sink == 0;
+}
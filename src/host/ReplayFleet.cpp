@@ -0,0 +1,348 @@
+/*
+ * itplus-replay fleet, see ITPlusReplay.cpp and FleetEmulator.h.
+ */
+
+#include "Replay.h"
+#include "ITPlusRX_ext.h"
+#include "EventLog.h"
+#include "BinaryOutput.h"
+#include "Ingest.h"
+#include "FleetEmulator.h"
+#include "RadioStats.h"
+#include "Aggregate.h"
+#include <unistd.h>
+#include <map>
+
+static void
+CollectRecord(const SensorRecord &record, void *context) {
+    ((std::vector<SensorRecord> *)context)->push_back(record);
+}
+
+static void
+CollectSummary(const SummaryRecord &summary, void *context) {
+    ((std::vector<SummaryRecord> *)context)->push_back(summary);
+}
+
+// What AggregateAdd() makes of a frame record
+static void
+AddToSummary(SummaryRecord &s, const SensorRecord &r) {
+    if (s.count == 0) {
+        s.tempMin = s.tempMax = r.temp;
+        s.hygroMin = s.hygroMax = r.hygro;
+    } else {
+        s.tempMin = r.temp < s.tempMin ? r.temp : s.tempMin;
+        s.tempMax = r.temp > s.tempMax ? r.temp : s.tempMax;
+        s.hygroMin = r.hygro < s.hygroMin ? r.hygro : s.hygroMin;
+        s.hygroMax = r.hygro > s.hygroMax ? r.hygro : s.hygroMax;
+    }
+    s.tempSum += r.temp;
+    s.hygroSum += r.hygro;
+    s.count++;
+    s.flags |= r.flags;
+}
+
+static bool
+SameSummary(const SummaryRecord &a, const SummaryRecord &b) {
+    return a.count == b.count && a.flags == b.flags && a.tempMin == b.tempMin && a.tempMax == b.tempMax &&
+        a.tempSum == b.tempSum && a.hygroMin == b.hygroMin && a.hygroMax == b.hygroMax &&
+        a.hygroSum == b.hygroSum;
+}
+
+// Serial and USB latency of the fleet output, 14 bytes at 57600 bps and up
+// to a 16 ms FTDI latency timer
+#define FLEET_LATENCY_US        2430
+#define FLEET_LATENCY_JITTER_US 16000
+#define FLEET_WALL_BASE_US      1700000000000000ULL
+
+// Output of the firmware up to end arriving at the host at hostUs
+struct FleetArrival {
+    size_t end;
+    uint64_t hostUs;
+};
+
+int
+Fleet(int argc, char **argv) {
+    FleetConfig config;
+    double hours = 24, elapsed = 0, start;
+    const char *outputName = NULL, *corpusName = NULL;
+    bool text = false, filter = false;
+    std::vector<FleetFrame> frames;
+    std::vector<bool> produced, filtered;
+    std::vector<uint8_t> output;
+    std::vector<FleetArrival> arrivals;
+    uint32_t latencySeed = 0;
+    unsigned long long endUs, minuteUs = 60000000ULL, syncUs = REC_SYNC_PERIOD * 1000000ULL, intervalUs = 0, aggregateUs;
+    unsigned long long syncBytes = 0, summaryBytes = 0, statsBytes, intervals = 0, badSummaries = 0;
+    unsigned long long correct = 0, falseAccepts = 0, decodeErrors = 0, crcRejects = 0, goodRejects = 0,
+        lengthRejects = 0, nbFiltered = 0, registeredFiltered = 0;
+    unsigned heard = 0, discovered = 0, registered = 0, interval = 0;
+    char *data = NULL;
+    size_t len = 0;
+    FILE *sink, *report;
+    FleetFrame f;
+    int opt;
+
+    optind = 1;
+    while ((opt = getopt(argc, argv, "n:t:j:c:e:r:d:s:a:fxo:w:")) != -1) {
+        switch (opt) {
+        case 'n': config.sensors = atoi(optarg); break;
+        case 't': hours = atof(optarg); break;
+        case 'j': config.jitterMs = atoi(optarg); break;
+        case 'c': config.collisionRate = atof(optarg); break;
+        case 'e': config.bitErrorRate = atof(optarg); break;
+        case 'r': config.restartsPerDay = atof(optarg); break;
+        case 'd': config.duplicateIdRate = atof(optarg); break;
+        case 's': config.seed = strtoul(optarg, NULL, 0); break;
+        case 'a': interval = atoi(optarg); break;
+        case 'f': filter = true; break;
+        case 'x': text = true; break;
+        case 'o': outputName = optarg; break;
+        case 'w': corpusName = optarg; break;
+        default: return 2;
+        }
+    }
+    // Summaries are checked against the frame records
+    if (config.sensors == 0 || hours <= 0 || interval > 0xffff || (interval != 0 && text))
+        return 2;
+    report = outputName != NULL && strcmp(outputName, "-") == 0 ? stderr : stdout;
+
+    FleetEmulator fleet(config);
+    endUs = (unsigned long long)(hours * 3600e6);
+    for (fleet.next(f); f.timeUs < endUs; fleet.next(f))
+        frames.push_back(f);
+
+    if ((sink = open_memstream(&data, &len)) == NULL) {
+        perror("open_memstream");
+        return 1;
+    }
+    Serial.setSink(sink);
+    ITPlusRXSetup();
+    for (unsigned i = 0; i < config.sensors && i < ITPLUS_MAX_SENSORS; i++)
+        ITPlusRegister(i, fleet.sensorId(i));
+    registered = config.sensors < ITPLUS_MAX_SENSORS ? config.sensors : ITPLUS_MAX_SENSORS;
+    BinaryOutput = !text;
+    EventLogEnabled = text;
+    AggregateOutput = interval != 0;
+    AggregateInterval = interval;
+    RawOutput = true;
+    intervalUs = aggregateUs = interval * 1000000ULL;
+    FramesMissed = 0;
+    memset((void *)&RadioStats, 0, sizeof(RadioStats));
+    produced.resize(frames.size());
+    filtered.resize(frames.size());
+    latencySeed = config.seed;
+
+    for (size_t i = 0; i < frames.size(); i++) {
+        unsigned long long before;
+        FleetArrival arrival;
+
+        for (; minuteUs <= frames[i].timeUs; minuteUs += 60000000ULL)
+            ITPlusMinuteTick();
+        for (; syncUs <= frames[i].timeUs; syncUs += REC_SYNC_PERIOD * 1000000ULL) {
+            if (text)
+                continue;
+            HostClockSet(syncUs);
+            before = Serial.bytesWritten();
+            SendSyncRecord(syncUs / 1000000);
+            syncBytes += Serial.bytesWritten() - before;
+            latencySeed = latencySeed * 1664525 + 1013904223;
+            arrival.end = Serial.bytesWritten();
+            arrival.hostUs = FLEET_WALL_BASE_US + syncUs + FLEET_LATENCY_US + (latencySeed >> 8) % FLEET_LATENCY_JITTER_US;
+            arrivals.push_back(arrival);
+        }
+        for (; AggregateOutput && aggregateUs <= frames[i].timeUs; aggregateUs += intervalUs) {
+            HostClockSet(aggregateUs);
+            before = Serial.bytesWritten();
+            AggregateSend(micros());
+            summaryBytes += Serial.bytesWritten() - before;
+            intervals++;
+            latencySeed = latencySeed * 1664525 + 1013904223;
+            arrival.end = Serial.bytesWritten();
+            arrival.hostUs = FLEET_WALL_BASE_US + aggregateUs + FLEET_LATENCY_US + (latencySeed >> 8) % FLEET_LATENCY_JITTER_US;
+            arrivals.push_back(arrival);
+        }
+        before = Serial.bytesWritten();
+        if (filter && !rf12_itplusAccept(ITPlusRegisteredIds, frames[i].frame[0], frames[i].frame[1])) {
+            const FleetFrame &sent = frames[i];
+
+            filtered[i] = true;
+            nbFiltered++;
+            // Bit errors in the ID
+            registeredFiltered += (ITPlusRegisteredIds[sent.sensorId >> 3] >> (sent.sensorId & 7)) & 1;
+            continue;
+        }
+        HostClockSet(frames[i].timeUs);
+        start = NowSeconds();
+        ProcessITPlusFrame(frames[i].frame, micros());
+        elapsed += NowSeconds() - start;
+        if (text) {
+            while (EventLogDrain(EVENT_LOG_RING) != 0)
+                ;
+        }
+        produced[i] = Serial.bytesWritten() != before;
+        latencySeed = latencySeed * 1664525 + 1013904223;
+        arrival.end = Serial.bytesWritten();
+        arrival.hostUs = FLEET_WALL_BASE_US + frames[i].timeUs + FLEET_LATENCY_US + (latencySeed >> 8) % FLEET_LATENCY_JITTER_US;
+        arrivals.push_back(arrival);
+    }
+    // As on the 's' command, for piweatherd
+    statsBytes = Serial.bytesWritten();
+    PrintRadioStats();
+    statsBytes = Serial.bytesWritten() - statsBytes;
+    BinaryOutput = false;
+    EventLogEnabled = true;
+    AggregateOutput = false;
+    Serial.setSink(NULL);
+    fclose(sink);
+    output.assign(data, data + len);
+    free(data);
+
+    for (byte i = 0; i < ITPLUS_MAX_SENSORS; i++)
+        heard += ITPlusChannels[i].SensorID != 0xff && ITPlusChannels[i].LastReceiveTimer != 0;
+    for (byte i = 0; i < ITPLUS_MAX_DISCOVER; i++)
+        discovered += DiscoveredITPlus[i].SensorID != 0xff && DiscoveredITPlus[i].LastReceiveTimer != 0;
+
+    fprintf(report, "fleet:       %u sensors, %.1f h, jitter %u ms, collision rate %g, bit error rate %g, "
+            "%g restarts/day, duplicate ID rate %g\n", config.sensors, hours, config.jitterMs,
+            config.collisionRate, config.bitErrorRate, config.restartsPerDay, config.duplicateIdRate);
+    fprintf(report, "on air:      %llu frames sent, %llu lost in collisions, %llu heard garbled by collisions, "
+            "%llu with bit errors, %llu restarts\n", fleet.sent(), fleet.lost(), fleet.collisions(),
+            fleet.bitErrors(), fleet.restarts());
+    if (filter) {
+        double saved = nbFiltered * (ITPLUS_FRAME_LEN - 2) * ITPLUS_BYTE_US / 1e6;
+
+        fprintf(report, "filter:      %llu frames filtered after 2 bytes, %.1f s of receive saved (%.2f%% of the time), "
+                "%llu of registered sensors dropped for a garbled ID\n", nbFiltered, saved, saved * 100 / (hours * 3600),
+                registeredFiltered);
+    }
+    fprintf(report, "decode:      %llu frames in %.3f s, %.0f frames/s, %.1f ns/frame, %.1f output bytes/frame\n",
+            frames.size() - nbFiltered, elapsed, (frames.size() - nbFiltered) / elapsed,
+            elapsed * 1e9 / (frames.size() - nbFiltered), (double)output.size() / (frames.size() - nbFiltered));
+
+    if (text) {
+        IngestParser parser(IgnoreReading, NULL);
+
+        parser.parse(output.data(), output.size(), true);
+        fprintf(report, "ingest:      %llu readings, %llu other lines\n", parser.textReadings(),
+                parser.otherLines());
+        correct = parser.textReadings();
+    } else {
+        std::vector<SensorRecord> records;
+        std::vector<SummaryRecord> summaries;
+        // Per interval and sensor ID
+        std::map<std::pair<unsigned long long, uint8_t>, SummaryRecord> expected;
+        IngestParser parser(CollectRecord, &records);
+        size_t r = 0, p = 0;
+        unsigned long long timed = 0;
+        int64_t minError = INT64_MAX, maxError = INT64_MIN, sumError = 0;
+
+        parser.setSummaryHandler(CollectSummary, &summaries);
+
+        for (size_t i = 0; i < arrivals.size(); i++) {
+            parser.setHostTime(arrivals[i].hostUs);
+            p += parser.parse(output.data() + p, arrivals[i].end - p);
+        }
+        parser.parse(output.data() + p, output.size() - p, true);
+
+        for (size_t i = 0; i < frames.size(); i++) {
+            const FleetFrame &sent = frames[i];
+
+            if (filtered[i])
+                continue;
+            if (!produced[i]) {
+                lengthRejects++;
+                continue;
+            }
+            if (r == records.size())
+                break;
+            const SensorRecord &got = records[r++];
+            if (intervalUs != 0 && (got.flags & REC_FLAG_CRC_OK) &&
+                    sent.timeUs / intervalUs < intervals &&
+                    (ITPlusRegisteredIds[got.sensorId >> 3] >> (got.sensorId & 7)) & 1) {
+                SummaryRecord &s = expected[std::make_pair(sent.timeUs / intervalUs, got.sensorId)];
+
+                AddToSummary(s, got);
+            }
+            if (!(got.flags & REC_FLAG_CRC_OK)) {
+                if (sent.garbled)
+                    crcRejects++;
+                else
+                    goodRejects++;
+            } else if (got.sensorId == sent.sensorId && got.temp == sent.temp && got.hygro == sent.hygro &&
+                    !(got.flags & REC_FLAG_RESTART) == !sent.restart &&
+                    !(got.flags & REC_FLAG_WEAK_BATT) == !sent.weakBatt) {
+                correct++;
+                if (got.timeUs != 0) {
+                    int64_t error = (int64_t)(got.timeUs - (FLEET_WALL_BASE_US + sent.timeUs));
+
+                    minError = error < minError ? error : minError;
+                    maxError = error > maxError ? error : maxError;
+                    sumError += error;
+                    timed++;
+                }
+            } else if (sent.garbled) {
+                falseAccepts++;
+            } else {
+                decodeErrors++;
+            }
+        }
+        fprintf(report, "accepted:    %llu correct, %llu garbled frames passing the CRC, %llu decode errors\n",
+                correct, falseAccepts, decodeErrors);
+        fprintf(report, "rejected:    %llu garbled by CRC, %llu garbled by length, %llu good frames\n",
+                crcRejects, lengthRejects, goodRejects);
+        if (timed != 0) {
+            fprintf(report, "timing:      %llu sync records, %llu readings rebased, error %.3f to %.3f ms, "
+                    "mean %.3f ms\n", parser.syncRecords(), timed, minError / 1e3, maxError / 1e3,
+                    sumError / 1e3 / timed);
+        }
+        if (intervalUs != 0) {
+            unsigned long long matched = 0, empty = 0, differing = 0, missing = 0;
+            // Frame records, bad CRC ones included, as sent without aggregation
+            unsigned long long frameBytes = output.size() - syncBytes - summaryBytes - statsBytes;
+
+            for (size_t k = 0; k < summaries.size(); k++) {
+                const SummaryRecord &got = summaries[k];
+                std::map<std::pair<unsigned long long, uint8_t>, SummaryRecord>::iterator e =
+                    expected.find(std::make_pair(k / registered, got.sensorId));
+
+                if (got.count == 0 && e == expected.end()) {
+                    empty++;
+                } else if (got.interval == interval && e != expected.end() && SameSummary(got, e->second)) {
+                    matched++;
+                    expected.erase(e);
+                } else if (got.count != 0) {
+                    differing++;
+                }
+            }
+            missing = expected.size();
+            fprintf(report, "aggregate:   %llu intervals of %u s, %zu summaries: %llu matching the frame records, "
+                    "%llu empty, %llu differing, %llu missing\n", intervals, interval, summaries.size(), matched,
+                    empty, differing, missing);
+            fprintf(report, "output:      %llu bytes of summaries instead of %llu bytes of frame records (%.1f%%), "
+                    "%.1f bytes/sensor/minute instead of %.1f\n", summaryBytes, frameBytes,
+                    frameBytes ? 100.0 * summaryBytes / frameBytes : 0.0,
+                    registered ? summaryBytes * 60e6 / (intervals * intervalUs) / registered : 0.0,
+                    frameBytes * 60 / (hours * 3600) / config.sensors);
+            badSummaries = differing + missing;
+        }
+    }
+    fprintf(report, "delivered:   %.2f%% of the frames sent\n", 100.0 * correct / fleet.sent());
+    fprintf(report, "counters:    %u CRC errors, %u bad lengths, %u registry hits, %u known, %u new, "
+            "%u evictions\n", RadioStats.CrcErrors, RadioStats.BadLength, RadioStats.RegistryHits,
+            RadioStats.RegistryKnown, RadioStats.RegistryNew, RadioStats.RegistryEvictions);
+    fprintf(report, "registry:    %u of %u registered sensors heard, %u discovered, %u stalled, "
+            "%lu frames missed by the firmware count\n", heard, registered, discovered, StalledSensors,
+            FramesMissed);
+
+    if (outputName != NULL && !WriteFile(outputName, output.data(), output.size()))
+        return 1;
+    if (corpusName != NULL) {
+        std::vector<byte> corpus;
+
+        for (size_t i = 0; i < frames.size(); i++)
+            corpus.insert(corpus.end(), frames[i].frame, frames[i].frame + ITPLUS_FRAME_LEN);
+        if (!WriteFile(corpusName, corpus.data(), corpus.size()))
+            return 1;
+    }
+    return decodeErrors != 0 || goodRejects != 0 || badSummaries != 0;
+}
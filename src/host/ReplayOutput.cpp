@@ -0,0 +1,169 @@
+/*
+ * itplus-replay binary and ingest: the firmware output through the host
+ * decoders, see ITPlusReplay.cpp.
+ */
+
+#include "Replay.h"
+#include "BinaryOutput.h"
+#include "RecordDecoder.h"
+#include "Ingest.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+static void
+CountRecord(const SensorRecord &record, void *context) {
+    *(long long *)context += record.temp;
+}
+
+int
+Binary(int argc, char **argv) {
+    std::vector<byte> corpus;
+    unsigned long long frames = 1000000, textBytes, binaryBytes;
+    long long tempSum = 0;
+    int passes = 10;
+    char *output = NULL;
+    size_t outputLen = 0;
+    FILE *sink;
+    PassResult r;
+    double start, elapsed;
+
+    if (!ReadFile(argv[0], corpus))
+        return 1;
+    if (argc > 1)
+        frames = strtoull(argv[1], NULL, 0);
+    if (corpus.size() < ITPLUS_FRAME_LEN) {
+        fprintf(stderr, "%s: no frames\n", argv[0]);
+        return 1;
+    }
+
+    Serial.setSink(NULL);
+    BinaryOutput = false;
+    ReplayPass(corpus, frames, true, r);
+    textBytes = r.bytes;
+
+    if ((sink = open_memstream(&output, &outputLen)) == NULL) {
+        perror("open_memstream");
+        return 1;
+    }
+    Serial.setSink(sink);
+    BinaryOutput = true;
+    ReplayPass(corpus, frames, false, r);
+    binaryBytes = r.bytes;
+    BinaryOutput = false;
+    Serial.setSink(NULL);
+    fclose(sink);
+
+    RecordDecoder check(CountRecord, &tempSum);
+    check.feed((const uint8_t *)output, outputLen);
+
+    start = NowSeconds();
+    for (int i = 0; i < passes; i++) {
+        RecordDecoder decoder(CountRecord, &tempSum);
+        decoder.feed((const uint8_t *)output, outputLen);
+    }
+    elapsed = NowSeconds() - start;
+
+    printf("frames:      %llu\n", frames);
+    printf("text:        %.1f bytes/frame\n", (double)textBytes / frames);
+    printf("binary:      %.1f bytes/frame, %.1fx less\n", (double)binaryBytes / frames,
+            (double)textBytes / binaryBytes);
+    printf("decoded:     %llu records, %llu CRC errors, %llu noise bytes\n",
+            check.records(), check.crcErrors(), check.noiseBytes());
+    printf("decoder:     %.1f ns/record, %.0f MB/s\n", elapsed * 1e9 / (passes * check.records()),
+            passes * outputLen / elapsed / 1e6);
+    free(output);
+    return check.records() != frames;
+}
+
+// Parse the whole output from memory, 4 KB at a time like reads would get it
+static double
+ParseInMemory(const std::vector<uint8_t> &output, IngestParser &parser) {
+    std::vector<uint8_t> buf;
+    double start = NowSeconds();
+
+    for (size_t p = 0; p < output.size(); ) {
+        size_t n = output.size() - p < 4096 ? output.size() - p : 4096, done;
+
+        buf.insert(buf.end(), output.begin() + p, output.begin() + p + n);
+        p += n;
+        done = parser.parse(buf.data(), buf.size(), p == output.size());
+        buf.erase(buf.begin(), buf.begin() + done);
+    }
+    return NowSeconds() - start;
+}
+
+// Write the output into a pty master while IngestReader reads the slave
+static double
+ParseThroughPty(const std::vector<uint8_t> &output, IngestParser &parser) {
+    int master, slave;
+    size_t written = 0;
+    double start;
+
+    if ((master = posix_openpt(O_RDWR | O_NOCTTY)) < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+        perror("pty");
+        return -1;
+    }
+    if ((slave = IngestOpen(ptsname(master), 57600)) < 0) {
+        perror(ptsname(master));
+        return -1;
+    }
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    IngestReader reader(slave, parser);
+    start = NowSeconds();
+    while (reader.bytesRead() < output.size()) {
+        if (written < output.size()) {
+            ssize_t n = write(master, output.data() + written, output.size() - written);
+            if (n > 0)
+                written += n;
+        }
+        if (reader.poll(written < output.size() ? 0 : 1000) < 0)
+            break;
+    }
+    close(master);
+    while (reader.poll(100) >= 0)
+        ;
+    close(slave);
+    return NowSeconds() - start;
+}
+
+int
+IngestBench(int argc, char **argv) {
+    std::vector<byte> corpus;
+    unsigned long long frames = 200000;
+    int errors = 0;
+
+    if (!ReadFile(argv[0], corpus))
+        return 1;
+    if (argc > 1)
+        frames = strtoull(argv[1], NULL, 0);
+    if (corpus.size() < ITPLUS_FRAME_LEN) {
+        fprintf(stderr, "%s: no frames\n", argv[0]);
+        return 1;
+    }
+
+    printf("frames:      %llu\n", frames);
+    printf("mode    path    bytes/frame       MB/s  readings/s  readings  other lines  noise\n");
+    for (int binary = 0; binary <= 1; binary++) {
+        std::vector<uint8_t> output;
+
+        if (!CaptureOutput(corpus, frames, binary, output))
+            return 1;
+
+        for (int pty = 0; pty <= 1; pty++) {
+            IngestParser parser(IgnoreReading, NULL);
+            double elapsed = pty ? ParseThroughPty(output, parser) : ParseInMemory(output, parser);
+            unsigned long long readings = parser.textReadings() + parser.binaryReadings();
+
+            if (elapsed < 0)
+                return 1;
+            printf("%-6s  %-6s  %11.1f  %9.1f  %10.0f  %8llu  %11llu  %5llu\n", binary ? "binary" : "text",
+                    pty ? "pty" : "memory", (double)output.size() / frames, output.size() / elapsed / 1e6,
+                    readings / elapsed, readings, parser.otherLines(), parser.noiseBytes());
+            if (readings != frames || parser.crcErrors() != 0)
+                errors++;
+        }
+    }
+    return errors != 0;
+}
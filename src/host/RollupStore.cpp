@@ -0,0 +1,453 @@
+/*
+ * Rollups of the time-series store readings, see RollupStore.h
+ */
+
+#include "RollupStore.h"
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#define ROLLUP_MAGIC    0x55525750  // "PWRU"
+#define ROLLUP_VERSION  1
+#define NO_BUCKET       0xffffffffu
+#define QUERY_CHUNK     1024        // Buckets read at once by query()
+
+const uint32_t RollupStore::resolutions[ROLLUP_TIERS] = { 300, 3600, 86400 };
+
+static void
+Fold(RollupBucket &b, int16_t temp, uint8_t hygro) {
+    if (b.count == 0) {
+        b.tempMin = b.tempMax = temp;
+    } else if (temp < b.tempMin) {
+        b.tempMin = temp;
+    } else if (temp > b.tempMax) {
+        b.tempMax = temp;
+    }
+    b.tempSum += temp;
+    b.hygroSum += hygro;
+    b.count++;
+}
+
+RollupStore::RollupStore() : store(NULL), writable(false) {
+    for (int i = 0; i < TS_MAX_SENSORS; i++) {
+        for (int j = 0; j < ROLLUP_TIERS; j++)
+            sensors[i].tiers[j].fd = -1;
+    }
+}
+
+RollupStore::~RollupStore() {
+    close();
+}
+
+/*
+ * Open the file of a tier, if it exists or create is set, and load its
+ * last bucket as the current one.  A file with a bad header is taken as
+ * empty, to be refolded.
+ */
+bool
+RollupStore::openTier(uint8_t sensorId, int tier, bool create) {
+    Tier &t = sensors[sensorId].tiers[tier];
+    char name[48];
+    struct stat st;
+
+    t.slots = 0;
+    t.current = NO_BUCKET;
+    t.dirty = false;
+    memset(&t.header, 0, sizeof(t.header));
+    memset(&t.bucket, 0, sizeof(t.bucket));
+
+    snprintf(name, sizeof(name), "/%02u/rollup-%u.dat", sensorId, resolutions[tier]);
+    t.fd = ::open((store->directory() + name).c_str(),
+            writable ? O_RDWR | (create ? O_CREAT : 0) : O_RDONLY, 0644);
+    if (t.fd < 0)
+        return errno == ENOENT && !create;
+
+    if (fstat(t.fd, &st) == 0 && pread(t.fd, &t.header, sizeof(t.header), 0) == (ssize_t)sizeof(t.header) &&
+            t.header.magic == ROLLUP_MAGIC && t.header.version == ROLLUP_VERSION &&
+            t.header.resolution == resolutions[tier] && t.header.sensorId == sensorId) {
+        t.slots = (st.st_size - sizeof(t.header)) / sizeof(RollupBucket);
+        if (t.slots > 0) {
+            t.current = t.header.base + t.slots - 1;
+            pread(t.fd, &t.bucket, sizeof(t.bucket), sizeof(t.header) + (off_t)(t.slots - 1) * sizeof(t.bucket));
+        }
+        return true;
+    }
+
+    memset(&t.header, 0, sizeof(t.header));
+    t.header.magic = ROLLUP_MAGIC;
+    t.header.version = ROLLUP_VERSION;
+    t.header.sensorId = sensorId;
+    t.header.resolution = resolutions[tier];
+    return !writable || (ftruncate(t.fd, 0) == 0 && writeHeader(t));
+}
+
+bool
+RollupStore::writeBucket(Tier &t) {
+    return pwrite(t.fd, &t.bucket, sizeof(t.bucket),
+            sizeof(t.header) + (off_t)(t.current - t.header.base) * sizeof(t.bucket)) == (ssize_t)sizeof(t.bucket);
+}
+
+bool
+RollupStore::writeHeader(Tier &t) {
+    return pwrite(t.fd, &t.header, sizeof(t.header), 0) == (ssize_t)sizeof(t.header);
+}
+
+bool
+RollupStore::open(TimeSeriesStore &timeSeries, bool rw, unsigned threads) {
+    std::vector<std::pair<uint8_t, uint32_t> > jobs;
+
+    close();
+    store = &timeSeries;
+    writable = rw;
+    for (int i = 0; i < TS_MAX_SENSORS; i++) {
+        for (int j = 0; j < ROLLUP_TIERS; j++) {
+            if (!openTier(i, j, false)) {
+                close();
+                return false;
+            }
+        }
+    }
+    if (!writable)
+        return true;
+
+    for (int i = 0; i < TS_MAX_SENSORS; i++) {
+        uint32_t from = store->lastTime(i);
+        bool upToDate = true;
+
+        for (int j = 0; j < ROLLUP_TIERS; j++) {
+            const Tier &t = sensors[i].tiers[j];
+
+            if (t.fd < 0) {
+                upToDate = store->readings(i) == 0;
+                from = 0;
+            } else {
+                if (t.header.readings != store->readings(i) || t.header.lastTime != store->lastTime(i))
+                    upToDate = false;
+                if (t.header.lastTime < from)
+                    from = t.header.lastTime;
+            }
+        }
+        if (!upToDate)
+            jobs.push_back(std::make_pair((uint8_t)i, from - from % 86400));
+    }
+    if (!refoldAll(jobs, threads)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void
+RollupStore::close() {
+    if (writable)
+        sync();
+    for (int i = 0; i < TS_MAX_SENSORS; i++) {
+        for (int j = 0; j < ROLLUP_TIERS; j++) {
+            if (sensors[i].tiers[j].fd >= 0)
+                ::close(sensors[i].tiers[j].fd);
+            sensors[i].tiers[j].fd = -1;
+        }
+    }
+    writable = false;
+}
+
+bool
+RollupStore::add(uint8_t sensorId, uint32_t time, int16_t temp, uint8_t hygro) {
+    Sensor *s;
+
+    if (!writable || sensorId >= TS_MAX_SENSORS) {
+        errno = !writable ? EROFS : EINVAL;
+        return false;
+    }
+    s = &sensors[sensorId];
+    if (time < s->tiers[0].header.lastTime) {
+        errno = EINVAL;
+        return false;
+    }
+
+    for (int i = 0; i < ROLLUP_TIERS; i++) {
+        Tier &t = s->tiers[i];
+        uint32_t b = time / resolutions[i];
+
+        if (t.fd < 0 && !openTier(sensorId, i, true))
+            return false;
+        if (b != t.current) {
+            if (t.slots > 0 && t.dirty && !writeBucket(t))
+                return false;
+            if (t.slots == 0)
+                t.header.base = b;
+            t.current = b;
+            t.slots = b - t.header.base + 1;
+            memset(&t.bucket, 0, sizeof(t.bucket));
+        }
+        Fold(t.bucket, temp, hygro);
+        t.header.lastTime = time;
+        t.header.readings++;
+        t.dirty = true;
+    }
+    return true;
+}
+
+bool
+RollupStore::sync() {
+    bool ok = true;
+
+    for (int i = 0; i < TS_MAX_SENSORS; i++) {
+        for (int j = 0; j < ROLLUP_TIERS; j++) {
+            Tier &t = sensors[i].tiers[j];
+
+            if (t.fd < 0 || !t.dirty)
+                continue;
+            if (!writeBucket(t) || !writeHeader(t) || fdatasync(t.fd) < 0)
+                ok = false;
+            t.dirty = false;
+        }
+    }
+    return ok;
+}
+
+// Buckets of all the tiers, from the readings of a scan
+struct Refold {
+    std::vector<RollupBucket> buckets[ROLLUP_TIERS];
+    uint32_t start[ROLLUP_TIERS];
+};
+
+static void
+RefoldChunk(const TimeSeriesChunk &chunk, void *context) {
+    Refold *r = (Refold *)context;
+
+    for (int j = 0; j < ROLLUP_TIERS; j++) {
+        std::vector<RollupBucket> &buckets = r->buckets[j];
+        uint32_t resolution = RollupStore::resolutions[j];
+
+        if (buckets.empty())
+            r->start[j] = chunk.time[0] / resolution;
+        for (size_t i = 0; i < chunk.count; i++) {
+            size_t index = chunk.time[i] / resolution - r->start[j];
+
+            if (index >= buckets.size())
+                buckets.resize(index + 1);
+            Fold(buckets[index], chunk.temp[i], chunk.hygro[i]);
+        }
+    }
+}
+
+/*
+ * Replace the buckets of a sensor from the one holding time from with the
+ * ones folded from the store readings.
+ */
+bool
+RollupStore::refold(uint8_t sensorId, uint32_t from) {
+    Refold r;
+
+    store->scan(sensorId, from, UINT32_MAX, RefoldChunk, &r);
+
+    for (int j = 0; j < ROLLUP_TIERS; j++) {
+        Tier &t = sensors[sensorId].tiers[j];
+        const std::vector<RollupBucket> &buckets = r.buckets[j];
+        uint32_t first = from / resolutions[j], keep = 0;
+
+        if (t.fd < 0 && !openTier(sensorId, j, true))
+            return false;
+        if (t.slots > 0 && first > t.header.base)
+            keep = first - t.header.base < t.slots ? first - t.header.base : t.slots;
+        if (ftruncate(t.fd, sizeof(t.header) + (off_t)keep * sizeof(RollupBucket)) < 0)
+            return false;
+        t.slots = keep;
+
+        if (!buckets.empty()) {
+            size_t len = buckets.size() * sizeof(RollupBucket);
+
+            if (keep == 0)
+                t.header.base = r.start[j];
+            if (pwrite(t.fd, buckets.data(), len, sizeof(t.header) +
+                        (off_t)(r.start[j] - t.header.base) * sizeof(RollupBucket)) != (ssize_t)len)
+                return false;
+            t.slots = r.start[j] - t.header.base + buckets.size();
+        }
+
+        t.current = NO_BUCKET;
+        memset(&t.bucket, 0, sizeof(t.bucket));
+        if (t.slots > 0) {
+            t.current = t.header.base + t.slots - 1;
+            pread(t.fd, &t.bucket, sizeof(t.bucket), sizeof(t.header) + (off_t)(t.slots - 1) * sizeof(t.bucket));
+        }
+        t.header.readings = store->readings(sensorId);
+        t.header.lastTime = store->lastTime(sensorId);
+        t.dirty = false;
+        if (!writeHeader(t))
+            return false;
+    }
+    return true;
+}
+
+// Sensors touch only their own files and store segments: no locking
+bool
+RollupStore::refoldAll(const std::vector<std::pair<uint8_t, uint32_t> > &jobs, unsigned threads) {
+    std::vector<std::thread> workers;
+    std::atomic<size_t> next(0);
+    std::atomic<bool> ok(true);
+    auto work = [&]() {
+        for (size_t i; (i = next++) < jobs.size();) {
+            if (!refold(jobs[i].first, jobs[i].second))
+                ok = false;
+        }
+    };
+
+    if (threads > jobs.size())
+        threads = jobs.size();
+    for (unsigned i = 1; i < threads; i++)
+        workers.push_back(std::thread(work));
+    work();
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+    return ok;
+}
+
+bool
+RollupStore::rebuild(unsigned threads) {
+    std::vector<std::pair<uint8_t, uint32_t> > jobs;
+
+    if (!writable) {
+        errno = EROFS;
+        return false;
+    }
+    for (int i = 0; i < TS_MAX_SENSORS; i++) {
+        if (store->readings(i) > 0 || sensors[i].tiers[0].fd >= 0)
+            jobs.push_back(std::make_pair((uint8_t)i, 0u));
+    }
+    return refoldAll(jobs, threads);
+}
+
+uint32_t
+RollupStore::tierFor(uint32_t step) {
+    for (int j = ROLLUP_TIERS - 1; j >= 0; j--) {
+        if (resolutions[j] <= step)
+            return resolutions[j];
+    }
+    return 0;
+}
+
+// Merge of readings or tier buckets into the points of a query
+struct QueryOutput {
+    uint8_t sensorId;
+    uint32_t step;
+    RollupStore::PointHandler handler;
+    void *context;
+    RollupPoint point;
+    size_t points;
+
+    void flush() {
+        if (point.count > 0) {
+            handler(sensorId, point, context);
+            points++;
+        }
+        point.count = 0;
+    }
+
+    void merge(uint32_t time, const RollupBucket &b) {
+        uint32_t start = time - time % step;
+
+        if (point.count > 0 && start != point.start)
+            flush();
+        if (point.count == 0) {
+            point.start = start;
+            point.tempMin = b.tempMin;
+            point.tempMax = b.tempMax;
+            point.tempSum = 0;
+            point.hygroSum = 0;
+        } else {
+            if (b.tempMin < point.tempMin)
+                point.tempMin = b.tempMin;
+            if (b.tempMax > point.tempMax)
+                point.tempMax = b.tempMax;
+        }
+        point.tempSum += b.tempSum;
+        point.hygroSum += b.hygroSum;
+        point.count += b.count;
+    }
+};
+
+static void
+QueryChunk(const TimeSeriesChunk &chunk, void *context) {
+    QueryOutput *out = (QueryOutput *)context;
+
+    for (size_t i = 0; i < chunk.count; i++) {
+        RollupBucket b;
+
+        b.tempMin = b.tempMax = chunk.temp[i];
+        b.tempSum = chunk.temp[i];
+        b.hygroSum = chunk.hygro[i];
+        b.count = 1;
+        out->merge(chunk.time[i], b);
+    }
+}
+
+size_t
+RollupStore::query(uint8_t sensorId, uint32_t from, uint32_t to, uint32_t step, PointHandler handler,
+        void *context) {
+    uint32_t resolution = tierFor(step);
+    QueryOutput out;
+
+    if (sensorId >= TS_MAX_SENSORS || step == 0 || from >= to)
+        return 0;
+    out.sensorId = sensorId;
+    out.step = step;
+    out.handler = handler;
+    out.context = context;
+    out.point.count = 0;
+    out.points = 0;
+
+    if (resolution == 0) {
+        store->scan(sensorId, from, to, QueryChunk, &out);
+        out.flush();
+        return out.points;
+    }
+
+    int j = 0;
+    while (resolutions[j] != resolution)
+        j++;
+    Tier &t = sensors[sensorId].tiers[j];
+
+    // Another process may be adding readings, or may have rebuilt
+    if (!writable) {
+        if (t.fd >= 0)
+            ::close(t.fd);
+        if (!openTier(sensorId, j, false) || t.fd < 0)
+            return 0;
+    }
+    if (t.slots == 0)
+        return 0;
+
+    uint32_t first = from / resolution, end = (to - 1) / resolution + 1;
+    RollupBucket buckets[QUERY_CHUNK];
+
+    if (first < t.header.base)
+        first = t.header.base;
+    if (end > t.header.base + t.slots)
+        end = t.header.base + t.slots;
+    for (uint32_t b = first; b < end;) {
+        uint32_t n = end - b < QUERY_CHUNK ? end - b : QUERY_CHUNK;
+        ssize_t len = pread(t.fd, buckets, n * sizeof(RollupBucket),
+                sizeof(t.header) + (off_t)(b - t.header.base) * sizeof(RollupBucket));
+
+        if (len < 0)
+            break;
+        // Past the end of the file until the current bucket is written
+        memset((uint8_t *)buckets + len, 0, n * sizeof(RollupBucket) - len);
+        if (writable && t.current >= b && t.current < b + n)
+            buckets[t.current - b] = t.bucket;
+        for (uint32_t i = 0; i < n; i++) {
+            if (buckets[i].count > 0)
+                out.merge((b + i) * resolution, buckets[i]);
+        }
+        b += n;
+    }
+    out.flush();
+    return out.points;
+}
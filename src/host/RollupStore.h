@@ -0,0 +1,121 @@
+/*
+ * Rollups of the time-series store readings: temperature min/max/sum and
+ * hygro sum with the reading count, per 5 minutes, hour and day.
+ *
+ * They are kept up to date as the readings are appended, with only the
+ * current bucket of each tier in memory, and stored next to the segments
+ * of each sensor:
+ *
+ *   <dir>/<sensor id>/rollup-<resolution>.dat
+ *
+ *   header      RollupHeader
+ *   then        RollupBucket of consecutive buckets from the first one,
+ *               count 0 for buckets without readings
+ *
+ * A graph then reads a few hundred buckets instead of millions of readings:
+ * query() uses the coarsest tier no coarser than the step asked for.
+ */
+
+#ifndef RollupStore_h
+#define RollupStore_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+#include "TimeSeriesStore.h"
+
+#define ROLLUP_TIERS        3           // 5 minutes, hour, day
+
+struct RollupBucket {
+    int16_t tempMin, tempMax;
+    int32_t tempSum;
+    uint32_t hygroSum;
+    uint32_t count;
+};
+
+// A query result: a bucket of step seconds from start
+struct RollupPoint {
+    uint32_t start;
+    uint32_t count;
+    int16_t tempMin, tempMax;
+    int64_t tempSum;
+    uint64_t hygroSum;
+};
+
+class RollupStore {
+public:
+    typedef void (*PointHandler)(uint8_t sensorId, const RollupPoint &point, void *context);
+
+    static const uint32_t resolutions[ROLLUP_TIERS];
+
+    RollupStore();
+    ~RollupStore();
+
+    /*
+     * Open the rollups of an open store.  When writable, the rollups of
+     * each sensor missing some of its readings (crash or rollups never
+     * built) are completed from the start of the last day they hold.
+     */
+    bool open(TimeSeriesStore &store, bool writable, unsigned threads = 1);
+    void close();
+
+    // Add a reading, appended to the store just before
+    bool add(uint8_t sensorId, uint32_t time, int16_t temp, uint8_t hygro);
+
+    // Write the current buckets and headers
+    bool sync();
+
+    // Rebuild all the rollups from the store, sensors spread over threads
+    bool rebuild(unsigned threads);
+
+    /*
+     * Call handler with the buckets of step seconds, aligned on multiples
+     * of step, having readings from <= time < to, in time order.  Bucket
+     * limits are accurate to the resolution of the tier read, the raw
+     * readings if step is under 5 minutes.  Returns the number of buckets.
+     */
+    size_t query(uint8_t sensorId, uint32_t from, uint32_t to, uint32_t step, PointHandler handler,
+            void *context);
+
+    // Resolution query() reads for step, 0 for raw readings
+    static uint32_t tierFor(uint32_t step);
+
+private:
+    struct RollupHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint8_t sensorId;
+        uint8_t reserved;
+        uint32_t resolution;
+        uint32_t base;          // Bucket number (time / resolution) of the first one
+        uint32_t lastTime;      // Of the last reading added
+        uint32_t pad;
+        uint64_t readings;      // Added since the store was created
+    };
+
+    struct Tier {
+        int fd;
+        RollupHeader header;
+        uint32_t slots;         // Buckets in the file, current included
+        uint32_t current;       // Bucket number of bucket
+        RollupBucket bucket;
+        bool dirty;
+    };
+
+    struct Sensor {
+        Tier tiers[ROLLUP_TIERS];
+    };
+
+    bool openTier(uint8_t sensorId, int tier, bool create);
+    bool writeBucket(Tier &t);
+    bool writeHeader(Tier &t);
+    bool refold(uint8_t sensorId, uint32_t from);
+    // Refold (sensor id, from) pairs
+    bool refoldAll(const std::vector<std::pair<uint8_t, uint32_t> > &jobs, unsigned threads);
+
+    TimeSeriesStore *store;
+    bool writable;
+    Sensor sensors[TS_MAX_SENSORS];
+};
+
+#endif
@@ -0,0 +1,263 @@
+/*
+ * Compression of sealed time-series segments, see SeriesCodec.h
+ */
+
+#include "SeriesCodec.h"
+
+// MSB first bit packing
+struct BitWriter {
+    std::vector<uint8_t> &out;
+    uint64_t acc;
+    unsigned bits;
+
+    BitWriter(std::vector<uint8_t> &out) : out(out), acc(0), bits(0) {}
+
+    void put(uint32_t value, unsigned n) {
+        acc = (acc << n) | (value & (uint32_t)((1ull << n) - 1));
+        bits += n;
+        while (bits >= 8) {
+            bits -= 8;
+            out.push_back((uint8_t)(acc >> bits));
+        }
+    }
+
+    void flush() {
+        if (bits > 0)
+            out.push_back((uint8_t)(acc << (8 - bits)));
+        bits = 0;
+    }
+};
+
+/*
+ * Reads zeros past the end, so that refills need no check per bit: the
+ * caller checks overrun() once the block is decoded.
+ */
+struct BitReader {
+    const uint8_t *data;
+    size_t len, pos;
+    uint64_t acc;
+    unsigned bits;
+
+    BitReader(const uint8_t *data, size_t len) : data(data), len(len), pos(0), acc(0), bits(0) {}
+
+    // At least 57 bits available after
+    void refill() {
+        while (bits <= 56) {
+            acc = (acc << 8) | (pos < len ? data[pos] : 0);
+            pos++;
+            bits += 8;
+        }
+    }
+
+    // n bits, with n <= bits
+    uint32_t take(unsigned n) {
+        bits -= n;
+        return (uint32_t)(acc >> bits) & (uint32_t)((1ull << n) - 1);
+    }
+
+    uint32_t get(unsigned n) {
+        if (bits < n)
+            refill();
+        return take(n);
+    }
+
+    bool overrun() const { return pos * 8 - bits > len * 8; }
+};
+
+static void
+PutVarint(std::vector<uint8_t> &out, int32_t value) {
+    uint32_t zz = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+
+    while (zz >= 0x80) {
+        out.push_back((uint8_t)(zz | 0x80));
+        zz >>= 7;
+    }
+    out.push_back((uint8_t)zz);
+}
+
+static inline bool
+GetVarint(const uint8_t *&p, const uint8_t *end, int32_t &value) {
+    uint32_t zz = 0;
+
+    // Most deltas are small
+    if (p < end && *p < 0x80) {
+        zz = *p++;
+        value = (int32_t)(zz >> 1) ^ -(int32_t)(zz & 1);
+        return true;
+    }
+
+    for (unsigned shift = 0; shift < 35; shift += 7) {
+        if (p == end)
+            return false;
+        zz |= (uint32_t)(*p & 0x7f) << shift;
+        if (!(*p++ & 0x80)) {
+            value = (int32_t)(zz >> 1) ^ -(int32_t)(zz & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+SeriesEncoder::SeriesEncoder() : count(0) {
+}
+
+void
+SeriesEncoder::add(uint32_t t, int16_t te, uint8_t h, uint8_t f) {
+    time[count] = t;
+    temp[count] = te;
+    hygro[count] = h;
+    flags[count] = f;
+    if (++count == SERIES_BLOCK)
+        flushBlock();
+}
+
+void
+SeriesEncoder::finish() {
+    if (count > 0)
+        flushBlock();
+}
+
+void
+SeriesEncoder::flushBlock() {
+    SeriesBlock block;
+    size_t start = out.size(), mark;
+    uint32_t delta = 0;
+    int32_t prevTemp = 0, prevHygro = 0;
+    uint8_t prevFlags = 0;
+
+    block.firstTime = time[0];
+    block.lastTime = time[count - 1];
+    block.offset = start;
+    block.count = count;
+    block.reserved = 0;
+
+    BitWriter timeBits(out);
+    for (unsigned i = 1; i < count; i++) {
+        uint32_t d = time[i] - time[i - 1];
+        int64_t dod = (int64_t)d - delta;
+
+        if (dod == 0) {
+            timeBits.put(0, 1);
+        } else if (dod >= -63 && dod <= 64) {
+            timeBits.put(2, 2);
+            timeBits.put(dod + 63, 7);
+        } else if (dod >= -255 && dod <= 256) {
+            timeBits.put(6, 3);
+            timeBits.put(dod + 255, 9);
+        } else if (dod >= -2047 && dod <= 2048) {
+            timeBits.put(14, 4);
+            timeBits.put(dod + 2047, 12);
+        } else {
+            timeBits.put(15, 4);
+            timeBits.put(d, 32);
+        }
+        delta = d;
+    }
+    timeBits.flush();
+    block.timeBytes = out.size() - start;
+
+    mark = out.size();
+    for (unsigned i = 0; i < count; i++) {
+        PutVarint(out, temp[i] - prevTemp);
+        prevTemp = temp[i];
+    }
+    block.tempBytes = out.size() - mark;
+
+    mark = out.size();
+    for (unsigned i = 0; i < count; i++) {
+        PutVarint(out, hygro[i] - prevHygro);
+        prevHygro = hygro[i];
+    }
+    block.hygroBytes = out.size() - mark;
+
+    mark = out.size();
+    BitWriter flagBits(out);
+    for (unsigned i = 0; i < count; i++) {
+        if (flags[i] == prevFlags) {
+            flagBits.put(0, 1);
+        } else {
+            flagBits.put(1, 1);
+            flagBits.put(flags[i], 8);
+            prevFlags = flags[i];
+        }
+    }
+    flagBits.flush();
+    block.flagBytes = out.size() - mark;
+
+    blockList.push_back(block);
+    count = 0;
+}
+
+bool
+SeriesDecode(const SeriesBlock &block, const uint8_t *data, size_t dataLen, uint32_t *time,
+        int16_t *temp, uint8_t *hygro, uint8_t *flags) {
+    size_t len = (size_t)block.timeBytes + block.tempBytes + block.hygroBytes + block.flagBytes;
+    const uint8_t *p, *end;
+    uint32_t t = block.firstTime, delta = 0;
+    int32_t value, prev;
+    unsigned count = block.count;
+
+    if (count == 0 || count > SERIES_BLOCK || block.offset > dataLen || len > dataLen - block.offset)
+        return false;
+    data += block.offset;
+
+    BitReader timeBits(data, block.timeBytes);
+    time[0] = t;
+    for (unsigned i = 1; i < count; i++) {
+        uint32_t prefix;
+
+        // The longest code is 36 bits
+        if (timeBits.bits < 36)
+            timeBits.refill();
+        prefix = timeBits.take(4);
+        if (prefix < 8) {
+            timeBits.bits += 3;
+        } else if (prefix < 12) {
+            timeBits.bits += 2;
+            delta += (int32_t)timeBits.take(7) - 63;
+        } else if (prefix < 14) {
+            timeBits.bits += 1;
+            delta += (int32_t)timeBits.take(9) - 255;
+        } else if (prefix == 14) {
+            delta += (int32_t)timeBits.take(12) - 2047;
+        } else {
+            delta = timeBits.take(32);
+        }
+        t += delta;
+        time[i] = t;
+    }
+    if (timeBits.overrun() || t != block.lastTime)
+        return false;
+    data += block.timeBytes;
+
+    p = data;
+    end = data + block.tempBytes;
+    prev = 0;
+    for (unsigned i = 0; i < count; i++) {
+        if (!GetVarint(p, end, value))
+            return false;
+        prev += value;
+        temp[i] = (int16_t)prev;
+    }
+    data = end;
+
+    p = data;
+    end = data + block.hygroBytes;
+    prev = 0;
+    for (unsigned i = 0; i < count; i++) {
+        if (!GetVarint(p, end, value))
+            return false;
+        prev += value;
+        hygro[i] = (uint8_t)prev;
+    }
+    data = end;
+
+    BitReader flagBits(data, block.flagBytes);
+    prev = 0;
+    for (unsigned i = 0; i < count; i++) {
+        if (flagBits.get(1))
+            prev = flagBits.get(8);
+        flags[i] = (uint8_t)prev;
+    }
+    return !flagBits.overrun();
+}
@@ -0,0 +1,69 @@
+/*
+ * Compression of sealed time-series segments, in independent blocks of up
+ * to SERIES_BLOCK readings, each column in its own stream:
+ *
+ *   time    delta of delta from the previous reading, bit packed:
+ *           0                   same delta
+ *           10   + 7 bits       delta of delta -63 to 64
+ *           110  + 9 bits       -255 to 256
+ *           1110 + 12 bits      -2047 to 2048
+ *           1111 + 32 bits      the delta itself
+ *   temp    zig-zag varint of the delta from the previous reading
+ *   hygro   zig-zag varint of the delta from the previous reading
+ *   flags   bit packed: 0 same flags, 1 + 8 bits new flags
+ *
+ * The first reading of a block is coded against time firstTime, delta 0,
+ * temp 0, hygro 0 and flags 0.  A TX29 reading every 4 s with a steady
+ * temperature takes 1 to 3 bytes instead of 8.
+ */
+
+#ifndef SeriesCodec_h
+#define SeriesCodec_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#define SERIES_BLOCK        256
+
+struct SeriesBlock {
+    uint32_t firstTime, lastTime;
+    uint32_t offset;            // Of the time stream in the data
+    uint16_t count;
+    uint16_t timeBytes, tempBytes, hygroBytes, flagBytes;
+    uint16_t reserved;
+};
+
+class SeriesEncoder {
+public:
+    SeriesEncoder();
+
+    // Readings must come in time order
+    void add(uint32_t time, int16_t temp, uint8_t hygro, uint8_t flags);
+
+    // Encode the last block, if partial
+    void finish();
+
+    const std::vector<SeriesBlock> &blocks() const { return blockList; }
+    const std::vector<uint8_t> &data() const { return out; }
+
+private:
+    void flushBlock();
+
+    std::vector<SeriesBlock> blockList;
+    std::vector<uint8_t> out;
+    uint32_t time[SERIES_BLOCK];
+    int16_t temp[SERIES_BLOCK];
+    uint8_t hygro[SERIES_BLOCK];
+    uint8_t flags[SERIES_BLOCK];
+    unsigned count;
+};
+
+/*
+ * Decode a block from the data it points to into columns of block.count
+ * readings.  False if the block is corrupt.
+ */
+bool SeriesDecode(const SeriesBlock &block, const uint8_t *data, size_t dataLen, uint32_t *time,
+        int16_t *temp, uint8_t *hygro, uint8_t *flags);
+
+#endif
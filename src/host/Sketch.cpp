@@ -0,0 +1,10 @@
+/*
+ * Globals the IT+ decode sources expect to find in PiWeather.ino, which
+ * isn't part of the host build.
+ */
+
+#include "PiWeather.h"
+
+byte SignalError = 1;
+unsigned long FramesReceived = 0;
+unsigned long FramesMissed = 0;
@@ -0,0 +1,669 @@
+/*
+ * Append-only memory-mapped time-series store, see TimeSeriesStore.h
+ */
+
+#include "TimeSeriesStore.h"
+#include "SeriesCodec.h"
+#include <algorithm>
+#include <atomic>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TS_MAGIC        0x53545750  // "PWTS"
+#define TS_VERSION      1
+
+#define INDEX_OFFSET    TS_PAGE
+#define INDEX_ENTRIES   (TS_SEGMENT_CAPACITY / TS_INDEX_STRIDE)
+#define DATA_OFFSET     (INDEX_OFFSET + ((INDEX_ENTRIES * 4 + TS_PAGE - 1) / TS_PAGE) * TS_PAGE)
+#define SEGMENT_SIZE    (DATA_OFFSET + (size_t)TS_SEGMENT_CAPACITY * 8)
+
+struct SegmentHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t sensorId;
+    uint8_t reserved;
+    uint32_t capacity;
+    uint32_t indexStride;
+    uint32_t count;             // Readings complete in the columns
+    uint32_t firstTime, lastTime;
+    uint32_t pad;
+    uint64_t sequence;          // The copy with the highest one is current
+    uint32_t checksum;          // FNV-1a of the fields above
+};
+
+// Sealed segment file: this header, the SeriesBlock table then the data
+struct SealedHeader {
+    uint32_t magic;             // "PWTZ"
+    uint16_t version;
+    uint8_t sensorId;
+    uint8_t reserved;
+    uint32_t count, firstTime, lastTime;
+    uint32_t blocks, dataLen;
+};
+
+#define TS_SEALED_MAGIC 0x5a545750
+
+// One segment file mapped in memory
+struct TimeSeriesMapping {
+    int fd;
+    uint8_t *base;
+    uint32_t number;
+    SegmentHeader current;
+    SegmentHeader *headers;     // The 2 copies
+    uint32_t *index;
+    uint32_t *time;
+    int16_t *temp;
+    uint8_t *hygro;
+    uint8_t *flags;
+};
+
+static uint32_t
+Checksum(const SegmentHeader &h) {
+    const uint8_t *p = (const uint8_t *)&h;
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < offsetof(SegmentHeader, checksum); i++)
+        hash = (hash ^ p[i]) * 16777619u;
+    return hash;
+}
+
+static bool
+ValidHeader(const SegmentHeader &h) {
+    return h.magic == TS_MAGIC && h.version == TS_VERSION && h.capacity == TS_SEGMENT_CAPACITY &&
+        h.indexStride == TS_INDEX_STRIDE && h.count <= h.capacity && h.checksum == Checksum(h);
+}
+
+// Newest valid header copy from page 0 of a segment
+static bool
+ReadHeader(const uint8_t *page, SegmentHeader &h) {
+    SegmentHeader copies[2];
+    bool valid[2];
+
+    memcpy(copies, page, sizeof(copies));
+    for (int i = 0; i < 2; i++)
+        valid[i] = ValidHeader(copies[i]);
+    if (!valid[0] && !valid[1])
+        return false;
+    h = copies[valid[1] && (!valid[0] || copies[1].sequence > copies[0].sequence)];
+    return true;
+}
+
+static TimeSeriesMapping *
+MapSegment(const std::string &path, bool writable, bool create, uint8_t sensorId, uint32_t number) {
+    TimeSeriesMapping *m = new TimeSeriesMapping;
+    int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    void *base;
+
+    m->fd = ::open(path.c_str(), writable ? O_RDWR | (create ? O_CREAT : 0) : O_RDONLY, 0644);
+    if (m->fd < 0) {
+        delete m;
+        return NULL;
+    }
+    if (create && ftruncate(m->fd, SEGMENT_SIZE) < 0) {
+        ::close(m->fd);
+        delete m;
+        return NULL;
+    }
+    if ((base = mmap(NULL, SEGMENT_SIZE, prot, MAP_SHARED, m->fd, 0)) == MAP_FAILED) {
+        ::close(m->fd);
+        delete m;
+        return NULL;
+    }
+
+    m->base = (uint8_t *)base;
+    m->number = number;
+    m->headers = (SegmentHeader *)m->base;
+    m->index = (uint32_t *)(m->base + INDEX_OFFSET);
+    m->time = (uint32_t *)(m->base + DATA_OFFSET);
+    m->temp = (int16_t *)(m->time + TS_SEGMENT_CAPACITY);
+    m->hygro = (uint8_t *)(m->temp + TS_SEGMENT_CAPACITY);
+    m->flags = m->hygro + TS_SEGMENT_CAPACITY;
+
+    if (create) {
+        memset(&m->current, 0, sizeof(m->current));
+        m->current.magic = TS_MAGIC;
+        m->current.version = TS_VERSION;
+        m->current.sensorId = sensorId;
+        m->current.capacity = TS_SEGMENT_CAPACITY;
+        m->current.indexStride = TS_INDEX_STRIDE;
+        m->current.sequence = 1;
+        m->current.checksum = Checksum(m->current);
+        memset(m->headers, 0, 2 * sizeof(SegmentHeader));
+        m->headers[1] = m->current;
+    } else if (!ReadHeader(m->base, m->current) || m->current.sensorId != sensorId) {
+        munmap(m->base, SEGMENT_SIZE);
+        ::close(m->fd);
+        delete m;
+        errno = EINVAL;
+        return NULL;
+    }
+    madvise(m->base + DATA_OFFSET, SEGMENT_SIZE - DATA_OFFSET, MADV_SEQUENTIAL);
+    return m;
+}
+
+static void
+UnmapSegment(TimeSeriesMapping *m) {
+    munmap(m->base, SEGMENT_SIZE);
+    ::close(m->fd);
+    delete m;
+}
+
+/*
+ * Publish m->current: the columns are written before, and the copy that
+ * isn't current is overwritten, so a torn write leaves the other intact.
+ */
+static void
+CommitHeader(TimeSeriesMapping *m) {
+    m->current.sequence++;
+    m->current.checksum = Checksum(m->current);
+    std::atomic_thread_fence(std::memory_order_release);
+    m->headers[m->current.sequence & 1] = m->current;
+}
+
+// First reading at or after t, the sparse index narrowing the search
+static size_t
+LowerBound(const TimeSeriesMapping *m, size_t count, uint32_t t) {
+    size_t lo = 0, hi = (count + TS_INDEX_STRIDE - 1) / TS_INDEX_STRIDE, first, last;
+
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+
+        if (m->index[mid] < t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    first = lo == 0 ? 0 : (lo - 1) * TS_INDEX_STRIDE;
+    last = std::min(lo * TS_INDEX_STRIDE, count);
+    return std::lower_bound(m->time + first, m->time + last, t) - m->time;
+}
+
+static bool
+WriteAll(int fd, const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t *)data;
+
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool
+ReadSealedHeader(const std::string &path, uint8_t sensorId, SealedHeader &h) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    bool ok;
+
+    if (fd < 0)
+        return false;
+    ok = pread(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) && h.magic == TS_SEALED_MAGIC &&
+        h.version == TS_VERSION && h.sensorId == sensorId;
+    ::close(fd);
+    return ok;
+}
+
+/*
+ * Readings of a sealed segment with from <= time < to, decoded a block at
+ * a time into the columns handed to handler.
+ */
+static size_t
+ScanSealed(const std::string &path, uint8_t sensorId, uint32_t from, uint32_t to,
+        TimeSeriesStore::ScanHandler handler, void *context) {
+    uint32_t time[SERIES_BLOCK];
+    int16_t temp[SERIES_BLOCK];
+    uint8_t hygro[SERIES_BLOCK], flags[SERIES_BLOCK];
+    const SealedHeader *h;
+    const SeriesBlock *blocks, *b;
+    const uint8_t *data;
+    size_t total = 0;
+    struct stat st;
+    void *base;
+    int fd;
+
+    if ((fd = ::open(path.c_str(), O_RDONLY)) < 0)
+        return 0;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(SealedHeader) ||
+            (base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        ::close(fd);
+        return 0;
+    }
+    madvise(base, st.st_size, MADV_SEQUENTIAL);
+    h = (const SealedHeader *)base;
+    blocks = (const SeriesBlock *)(h + 1);
+    data = (const uint8_t *)(blocks + h->blocks);
+    if (sizeof(SealedHeader) + (size_t)h->blocks * sizeof(SeriesBlock) + h->dataLen > (size_t)st.st_size)
+        goto done;
+
+    b = std::lower_bound(blocks, blocks + h->blocks, from,
+            [](const SeriesBlock &block, uint32_t t) { return block.lastTime < t; });
+    for (; b < blocks + h->blocks && b->firstTime < to; b++) {
+        TimeSeriesChunk chunk;
+        size_t begin, end;
+
+        if (!SeriesDecode(*b, data, h->dataLen, time, temp, hygro, flags))
+            break;
+        begin = std::lower_bound(time, time + b->count, from) - time;
+        end = std::lower_bound(time + begin, time + b->count, to) - time;
+        if (end == begin)
+            continue;
+
+        chunk.sensorId = sensorId;
+        chunk.count = end - begin;
+        chunk.time = time + begin;
+        chunk.temp = temp + begin;
+        chunk.hygro = hygro + begin;
+        chunk.flags = flags + begin;
+        handler(chunk, context);
+        total += chunk.count;
+    }
+done:
+    munmap(base, st.st_size);
+    ::close(fd);
+    return total;
+}
+
+TimeSeriesStore::TimeSeriesStore() : writable(false), compress(true) {
+    for (int i = 0; i < TS_MAX_SENSORS; i++)
+        sensors[i].tail = NULL;
+}
+
+TimeSeriesStore::~TimeSeriesStore() {
+    close();
+}
+
+std::string
+TimeSeriesStore::segmentPath(uint8_t sensorId, uint32_t number, bool sealed) const {
+    char name[32];
+
+    snprintf(name, sizeof(name), "/%02u/%06u.seg%s", sensorId, number, sealed ? "z" : "");
+    return dir + name;
+}
+
+/*
+ * List the segments of a sensor from their headers.  A segment which never
+ * got a valid header (crash while creating it) is ignored and will be
+ * created again.  A raw segment whose sealed version exists is what's left
+ * of a crash while sealing it.
+ */
+bool
+TimeSeriesStore::loadSensor(uint8_t sensorId) {
+    char name[8];
+    std::string sensorDir;
+    std::vector<std::pair<uint32_t, bool> > files;
+    struct dirent *e;
+    DIR *d;
+
+    snprintf(name, sizeof(name), "/%02u", sensorId);
+    sensorDir = dir + name;
+    if ((d = opendir(sensorDir.c_str())) == NULL) {
+        if (errno != ENOENT)
+            return false;
+        if (writable && mkdir(sensorDir.c_str(), 0755) < 0)
+            return false;
+        return true;
+    }
+    while ((e = readdir(d)) != NULL) {
+        char *end;
+        unsigned long number = strtoul(e->d_name, &end, 10);
+
+        if (end == e->d_name)
+            continue;
+        if (strcmp(end, ".seg") == 0)
+            files.push_back(std::make_pair((uint32_t)number, false));
+        else if (strcmp(end, ".segz") == 0)
+            files.push_back(std::make_pair((uint32_t)number, true));
+        else if (strcmp(end, ".segz.tmp") == 0 && writable)
+            unlink((sensorDir + "/" + e->d_name).c_str());
+    }
+    closedir(d);
+    std::sort(files.begin(), files.end());
+
+    for (size_t i = 0; i < files.size(); i++) {
+        uint32_t number = files[i].first;
+        SegmentInfo info;
+
+        info.number = number;
+        info.sealed = files[i].second;
+        if (i + 1 < files.size() && files[i + 1].first == number) {
+            if (writable)
+                unlink(segmentPath(sensorId, number).c_str());
+            continue;
+        }
+
+        if (info.sealed) {
+            SealedHeader h;
+
+            if (!ReadSealedHeader(segmentPath(sensorId, number, true), sensorId, h))
+                continue;
+            info.count = h.count;
+            info.firstTime = h.firstTime;
+            info.lastTime = h.lastTime;
+        } else {
+            uint8_t page[2 * sizeof(SegmentHeader)];
+            SegmentHeader h;
+            int fd = ::open(segmentPath(sensorId, number).c_str(), O_RDONLY);
+
+            if (fd < 0)
+                return false;
+            if (pread(fd, page, sizeof(page), 0) != (ssize_t)sizeof(page) || !ReadHeader(page, h) ||
+                    h.sensorId != sensorId) {
+                ::close(fd);
+                continue;
+            }
+            ::close(fd);
+            info.count = h.count;
+            info.firstTime = h.firstTime;
+            info.lastTime = h.lastTime;
+        }
+        sensors[sensorId].segments.push_back(info);
+    }
+    return true;
+}
+
+/*
+ * Compress a full raw segment into its sealed version, see SeriesCodec.h.
+ * The sealed file is complete on disk before the raw one is removed.
+ */
+bool
+TimeSeriesStore::seal(uint8_t sensorId, size_t segment) {
+    Sensor &s = sensors[sensorId];
+    SegmentInfo &info = s.segments[segment];
+    TimeSeriesMapping *m;
+    SeriesEncoder encoder;
+    SealedHeader h;
+    std::string path = segmentPath(sensorId, info.number, true), tmp = path + ".tmp";
+    char name[8];
+    bool ok;
+    int fd;
+
+    if (s.tail != NULL && s.tail->number == info.number) {
+        m = s.tail;
+        s.tail = NULL;
+    } else if ((m = MapSegment(segmentPath(sensorId, info.number), false, false, sensorId, info.number)) == NULL) {
+        return false;
+    }
+    for (uint32_t i = 0; i < m->current.count; i++)
+        encoder.add(m->time[i], m->temp[i], m->hygro[i], m->flags[i]);
+    encoder.finish();
+
+    memset(&h, 0, sizeof(h));
+    h.magic = TS_SEALED_MAGIC;
+    h.version = TS_VERSION;
+    h.sensorId = sensorId;
+    h.count = m->current.count;
+    h.firstTime = m->current.firstTime;
+    h.lastTime = m->current.lastTime;
+    h.blocks = encoder.blocks().size();
+    h.dataLen = encoder.data().size();
+    UnmapSegment(m);
+
+    if ((fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+        return false;
+    ok = WriteAll(fd, &h, sizeof(h)) &&
+        WriteAll(fd, encoder.blocks().data(), encoder.blocks().size() * sizeof(SeriesBlock)) &&
+        WriteAll(fd, encoder.data().data(), encoder.data().size()) && fsync(fd) == 0;
+    ::close(fd);
+    if (!ok || rename(tmp.c_str(), path.c_str()) < 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    snprintf(name, sizeof(name), "/%02u", sensorId);
+    if ((fd = ::open((dir + name).c_str(), O_RDONLY | O_DIRECTORY)) >= 0) {
+        fsync(fd);
+        ::close(fd);
+    }
+    unlink(segmentPath(sensorId, info.number).c_str());
+    info.sealed = true;
+    return true;
+}
+
+bool
+TimeSeriesStore::compact() {
+    if (!writable) {
+        errno = EROFS;
+        return false;
+    }
+    for (int i = 0; i < TS_MAX_SENSORS; i++) {
+        for (size_t j = 0; j < sensors[i].segments.size(); j++) {
+            const SegmentInfo &info = sensors[i].segments[j];
+
+            if (!info.sealed && info.count == TS_SEGMENT_CAPACITY && !seal(i, j))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool
+TimeSeriesStore::open(const char *path, bool rw) {
+    close();
+    dir = path;
+    writable = rw;
+    if (writable && mkdir(path, 0755) < 0 && errno != EEXIST)
+        return false;
+
+    for (int i = 0; i < TS_MAX_SENSORS; i++) {
+        if (!loadSensor(i)) {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void
+TimeSeriesStore::close() {
+    if (writable)
+        sync();
+    for (int i = 0; i < TS_MAX_SENSORS; i++) {
+        if (sensors[i].tail != NULL)
+            UnmapSegment(sensors[i].tail);
+        sensors[i].tail = NULL;
+        sensors[i].segments.clear();
+    }
+}
+
+/*
+ * Map the segment to append to: the last one if it isn't full, else a new
+ * one.  Readings past the last one in time order, left by a crash before
+ * the data reached the disk, are dropped.
+ */
+bool
+TimeSeriesStore::openTail(uint8_t sensorId, bool create) {
+    Sensor &s = sensors[sensorId];
+    TimeSeriesMapping *m;
+
+    if (s.tail != NULL) {
+        msync(s.tail->base, SEGMENT_SIZE, MS_ASYNC);
+        UnmapSegment(s.tail);
+        s.tail = NULL;
+    }
+
+    if (!create && !s.segments.empty() && s.segments.back().count < TS_SEGMENT_CAPACITY) {
+        if ((m = MapSegment(segmentPath(sensorId, s.segments.back().number), true, false, sensorId,
+                        s.segments.back().number)) == NULL)
+            return false;
+        uint32_t count = m->current.count;
+        while (count > 0 && (m->time[count - 1] == 0 || (count > 1 && m->time[count - 1] < m->time[count - 2])))
+            count--;
+        if (count != m->current.count) {
+            m->current.count = count;
+            m->current.lastTime = count > 0 ? m->time[count - 1] : 0;
+            CommitHeader(m);
+            s.segments.back().count = count;
+            s.segments.back().lastTime = m->current.lastTime;
+        }
+    } else {
+        SegmentInfo info;
+
+        if (compress && !s.segments.empty() && !s.segments.back().sealed &&
+                s.segments.back().count == TS_SEGMENT_CAPACITY && !seal(sensorId, s.segments.size() - 1))
+            return false;
+        info.number = s.segments.empty() ? 0 : s.segments.back().number + 1;
+        info.sealed = false;
+        info.count = info.firstTime = info.lastTime = 0;
+        if ((m = MapSegment(segmentPath(sensorId, info.number), true, true, sensorId, info.number)) == NULL)
+            return false;
+        s.segments.push_back(info);
+    }
+    s.tail = m;
+    return true;
+}
+
+bool
+TimeSeriesStore::append(uint8_t sensorId, uint32_t time, int16_t temp, uint8_t hygro, uint8_t flags) {
+    Sensor *s;
+    TimeSeriesMapping *m;
+    uint32_t i;
+
+    if (!writable || sensorId >= TS_MAX_SENSORS) {
+        errno = !writable ? EROFS : EINVAL;
+        return false;
+    }
+    s = &sensors[sensorId];
+    if (s->tail == NULL && !openTail(sensorId, false))
+        return false;
+    if (s->tail->current.count == TS_SEGMENT_CAPACITY && !openTail(sensorId, true))
+        return false;
+
+    m = s->tail;
+    i = m->current.count;
+    if (i > 0 && time < m->current.lastTime) {
+        errno = EINVAL;
+        return false;
+    }
+    if (i == 0 && s->segments.size() > 1 && time < s->segments[s->segments.size() - 2].lastTime) {
+        errno = EINVAL;
+        return false;
+    }
+
+    m->time[i] = time;
+    m->temp[i] = temp;
+    m->hygro[i] = hygro;
+    m->flags[i] = flags;
+    if (i % TS_INDEX_STRIDE == 0)
+        m->index[i / TS_INDEX_STRIDE] = time;
+    if (i == 0)
+        m->current.firstTime = time;
+    m->current.lastTime = time;
+    m->current.count = i + 1;
+    CommitHeader(m);
+
+    SegmentInfo &info = s->segments.back();
+    info.count = m->current.count;
+    info.firstTime = m->current.firstTime;
+    info.lastTime = time;
+    return true;
+}
+
+bool
+TimeSeriesStore::sync() {
+    bool ok = true;
+
+    for (int i = 0; i < TS_MAX_SENSORS; i++) {
+        TimeSeriesMapping *m = sensors[i].tail;
+
+        if (m == NULL)
+            continue;
+        if (msync(m->base + INDEX_OFFSET, SEGMENT_SIZE - INDEX_OFFSET, MS_SYNC) < 0 ||
+                msync(m->base, TS_PAGE, MS_SYNC) < 0)
+            ok = false;
+    }
+    return ok;
+}
+
+size_t
+TimeSeriesStore::readings(uint8_t sensorId) const {
+    size_t total = 0;
+
+    for (size_t i = 0; i < sensors[sensorId].segments.size(); i++)
+        total += sensors[sensorId].segments[i].count;
+    return total;
+}
+
+size_t
+TimeSeriesStore::sealedSegments(uint8_t sensorId) const {
+    size_t sealed = 0;
+
+    for (size_t i = 0; i < sensors[sensorId].segments.size(); i++)
+        sealed += sensors[sensorId].segments[i].sealed;
+    return sealed;
+}
+
+uint32_t
+TimeSeriesStore::lastTime(uint8_t sensorId) const {
+    const std::vector<SegmentInfo> &segments = sensors[sensorId].segments;
+
+    for (size_t i = segments.size(); i > 0; i--) {
+        if (segments[i - 1].count > 0)
+            return segments[i - 1].lastTime;
+    }
+    return 0;
+}
+
+size_t
+TimeSeriesStore::scan(uint8_t sensorId, uint32_t from, uint32_t to, ScanHandler handler, void *context) {
+    Sensor &s = sensors[sensorId];
+    size_t total = 0;
+
+    if (sensorId >= TS_MAX_SENSORS)
+        return 0;
+
+    for (size_t i = 0; i < s.segments.size(); i++) {
+        const SegmentInfo &info = s.segments[i];
+        bool isTail = s.tail != NULL && s.tail->number == info.number;
+        TimeSeriesMapping *m;
+        SegmentHeader h;
+        size_t begin, end;
+
+        // Segments past the last known one may have grown since open()
+        if (info.firstTime >= to || (info.lastTime < from && i + 1 < s.segments.size()))
+            continue;
+        if (info.sealed) {
+            total += ScanSealed(segmentPath(sensorId, info.number, true), sensorId, from, to, handler, context);
+            continue;
+        }
+        if (isTail) {
+            m = s.tail;
+        } else if ((m = MapSegment(segmentPath(sensorId, info.number), false, false, sensorId, info.number)) == NULL) {
+            // Sealed by another process since open()
+            total += ScanSealed(segmentPath(sensorId, info.number, true), sensorId, from, to, handler, context);
+            continue;
+        }
+
+        h = m->current;
+        if (!isTail)
+            ReadHeader(m->base, h);
+        begin = LowerBound(m, h.count, from);
+        end = LowerBound(m, h.count, to);
+        if (end > begin) {
+            TimeSeriesChunk chunk;
+
+            chunk.sensorId = sensorId;
+            chunk.count = end - begin;
+            chunk.time = m->time + begin;
+            chunk.temp = m->temp + begin;
+            chunk.hygro = m->hygro + begin;
+            chunk.flags = m->flags + begin;
+            handler(chunk, context);
+            total += chunk.count;
+        }
+        if (!isTail)
+            UnmapSegment(m);
+    }
+    return total;
+}
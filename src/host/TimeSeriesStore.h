@@ -0,0 +1,112 @@
+/*
+ * Append-only store of the IT+ readings, for years of history.
+ *
+ * Each sensor id has its own directory of fixed size segment files, each
+ * holding TS_SEGMENT_CAPACITY readings as four columns (time, temp, hygro,
+ * flags) written through a shared memory mapping:
+ *
+ *   <dir>/<sensor id>/<segment number>.seg
+ *
+ *   page 0      two copies of the segment header, written alternately
+ *   page 1      sparse time index, time of every TS_INDEX_STRIDE-th reading
+ *   then        time[capacity] (uint32_t, unix time), temp[capacity]
+ *               (int16_t, tenths of degree), hygro[capacity], flags[capacity]
+ *
+ * A reading is written to the columns first and only then counted in the
+ * header, each header copy carrying a sequence number and a checksum: after
+ * a crash the newest valid copy tells which readings are complete.  Readings
+ * of a sensor must be appended in time order.
+ *
+ * A range scan maps the segments overlapping the range and hands out
+ * pointers into the columns, so reading a year of a sensor is sequential
+ * memory access.
+ *
+ * Once full, a segment is sealed: compressed with SeriesCodec.h into
+ * <segment number>.segz, 2 to 4 times smaller, which scans decode a block
+ * at a time.
+ */
+
+#ifndef TimeSeriesStore_h
+#define TimeSeriesStore_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define TS_MAX_SENSORS          64          // IT+ sensor ids are 6 bits
+#define TS_SEGMENT_CAPACITY     (1 << 18)   // 12 days of frames every 4 s, 182 days of minutes
+#define TS_INDEX_STRIDE         256
+#define TS_PAGE                 4096
+
+// Consecutive readings of one sensor, pointing into a segment mapping
+struct TimeSeriesChunk {
+    uint8_t sensorId;
+    size_t count;
+    const uint32_t *time;
+    const int16_t *temp;
+    const uint8_t *hygro;
+    const uint8_t *flags;
+};
+
+struct TimeSeriesMapping;
+
+class TimeSeriesStore {
+public:
+    typedef void (*ScanHandler)(const TimeSeriesChunk &chunk, void *context);
+
+    TimeSeriesStore();
+    ~TimeSeriesStore();
+
+    // Open or create the store in dir.  False with errno set on error.
+    bool open(const char *dir, bool writable);
+    void close();
+
+    // False if the store is read only, time goes backward or on I/O error
+    bool append(uint8_t sensorId, uint32_t time, int16_t temp, uint8_t hygro, uint8_t flags);
+
+    // Flush the segments being appended to disk, data before headers
+    bool sync();
+
+    // Seal full segments as they are left (default), or keep them raw
+    void setCompression(bool on) { compress = on; }
+
+    // Seal all the full raw segments
+    bool compact();
+
+    /*
+     * Call handler with the readings of sensorId having from <= time < to,
+     * in time order and in as few chunks as possible.  Returns the number
+     * of readings.  Chunks are only valid during the call.
+     */
+    size_t scan(uint8_t sensorId, uint32_t from, uint32_t to, ScanHandler handler, void *context);
+
+    size_t segments(uint8_t sensorId) const { return sensors[sensorId].segments.size(); }
+    size_t readings(uint8_t sensorId) const;
+    uint32_t lastTime(uint8_t sensorId) const;
+    size_t sealedSegments(uint8_t sensorId) const;
+    const std::string &directory() const { return dir; }
+
+private:
+    struct SegmentInfo {
+        uint32_t number;
+        bool sealed;
+        uint32_t count, firstTime, lastTime;
+    };
+
+    struct Sensor {
+        std::vector<SegmentInfo> segments;
+        TimeSeriesMapping *tail;        // Segment being appended to
+    };
+
+    std::string segmentPath(uint8_t sensorId, uint32_t number, bool sealed = false) const;
+    bool loadSensor(uint8_t sensorId);
+    bool seal(uint8_t sensorId, size_t segment);
+    bool openTail(uint8_t sensorId, bool create);
+
+    std::string dir;
+    bool writable, compress;
+    Sensor sensors[TS_MAX_SENSORS];
+};
+
+#endif
@@ -0,0 +1,162 @@
+/*
+ * Host side implementation of the Arduino shim, see Arduino.h
+ */
+
+#include "Arduino.h"
+#include <time.h>
+#include <unistd.h>
+
+HostSerial Serial;
+
+static bool clockFrozen = false;
+static unsigned long long clockUs = 0;
+
+size_t
+HostSerial::write(uint8_t c) {
+    if (sink != 0)
+        fputc(c, sink);
+    written++;
+    return 1;
+}
+
+size_t
+Print::write(const uint8_t *buf, size_t len) {
+    for (size_t i = 0; i < len; i++)
+        write(buf[i]);
+    return len;
+}
+
+size_t
+Print::print(const char *s) {
+    size_t n = 0;
+
+    while (*s)
+        n += write(*s++);
+    return n;
+}
+
+size_t
+Print::print(char c) {
+    return write(c);
+}
+
+size_t
+Print::print(unsigned char n, int base) {
+    return printNumber(n, base);
+}
+
+size_t
+Print::print(int n, int base) {
+    return print((long)n, base);
+}
+
+size_t
+Print::print(unsigned int n, int base) {
+    return printNumber(n, base);
+}
+
+size_t
+Print::print(long n, int base) {
+    // Like the Arduino core, only decimal numbers are printed signed
+    if (base == DEC && n < 0)
+        return write('-') + printNumber(-(unsigned long)n, base);
+    return printNumber(n, base);
+}
+
+size_t
+Print::print(unsigned long n, int base) {
+    return printNumber(n, base);
+}
+
+size_t
+Print::println() {
+    return write('\r') + write('\n');
+}
+
+size_t
+Print::println(const char *s) {
+    return print(s) + println();
+}
+
+size_t
+Print::printNumber(unsigned long n, int base) {
+    char buf[8 * sizeof(long) + 1];
+    char *str = &buf[sizeof(buf) - 1];
+
+    *str = '\0';
+    do {
+        char c = n % base;
+        n /= base;
+        *--str = c < 10 ? c + '0' : c + 'A' - 10;
+    } while (n);
+    return print(str);
+}
+
+static unsigned long long
+nowUs() {
+    struct timespec ts;
+
+    if (clockFrozen)
+        return clockUs;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+unsigned long
+millis() {
+    return nowUs() / 1000;
+}
+
+unsigned long
+micros() {
+    return nowUs();
+}
+
+void
+delay(unsigned long ms) {
+    if (!clockFrozen)
+        usleep(ms * 1000);
+}
+
+void
+delayMicroseconds(unsigned int us) {
+    if (!clockFrozen)
+        usleep(us);
+}
+
+void
+HostClockSet(unsigned long long us) {
+    clockFrozen = true;
+    clockUs = us;
+}
+
+void
+HostClockRelease() {
+    clockFrozen = false;
+}
+
+char *
+itoa(int value, char *str, int base) {
+    char *p = str, *start;
+    unsigned int n = value;
+
+    if (value < 0 && base == 10) {
+        *p++ = '-';
+        n = -(unsigned int)value;
+    }
+    start = p;
+    do {
+        int d = n % base;
+        *p++ = d < 10 ? d + '0' : d + 'a' - 10;
+        n /= base;
+    } while (n);
+    *p = '\0';
+
+    // Digits were produced backward
+    for (char *end = p - 1; start < end; start++, end--) {
+        char c = *start;
+        *start = *end;
+        *end = c;
+    }
+    return str;
+}
@@ -0,0 +1,127 @@
+/*
+ * Minimal Arduino core used to build the IT+ decode sources of PiWeather on a
+ * Linux host.  Only what those sources use is provided: the AVR integer types,
+ * millis()/micros(), Print, a Serial sink, interrupt masking, digital pins,
+ * external interrupts and the avr-libc itoa().
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;      // 16 bits like on the AVR, not the host's int
+
+#define DEC 10
+#define HEX 16
+
+/*
+ * Character output base class, like the Arduino core one: derived classes
+ * only provide write(uint8_t).
+ */
+class Print {
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+    size_t write(const uint8_t *buf, size_t len);
+    size_t print(const char *s);
+    size_t print(char c);
+    size_t print(unsigned char n, int base = DEC);
+    size_t print(int n, int base = DEC);
+    size_t print(unsigned int n, int base = DEC);
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t println();
+    size_t println(const char *s);
+
+private:
+    size_t printNumber(unsigned long n, int base);
+};
+
+/*
+ * Serial port replacement.  Output goes to stdout unless another sink is set,
+ * a null sink discards it but still counts the bytes written.  read() hands
+ * over the characters of the string last given to setInput(), then -1.
+ */
+class HostSerial : public Print {
+public:
+    HostSerial() : sink(stdout), written(0), input(NULL) {}
+
+    void begin(unsigned long) {}
+    using Print::write;
+    size_t write(uint8_t c);
+    int read() { return input != NULL && *input != 0 ? (uint8_t)*input++ : -1; }
+
+    void setSink(FILE *f) { sink = f; }
+    void setInput(const char *s) { input = s; }
+    unsigned long long bytesWritten() const { return written; }
+
+private:
+    FILE *sink;
+    unsigned long long written;
+    const char *input;
+};
+
+extern HostSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+/*
+ * By default millis() and micros() follow the host monotonic clock.  Replay
+ * tools can instead drive them from the capture timestamps: once
+ * HostClockSet() is called the clock only moves when set again.
+ */
+void HostClockSet(unsigned long long us);
+void HostClockRelease();
+
+// Only the flag is kept, see avr/interrupt.h
+inline void noInterrupts() { cli(); }
+inline void interrupts() { sei(); }
+
+#define LOW     0
+#define HIGH    1
+#define INPUT   0
+#define OUTPUT  1
+#define CHANGE  1
+#define FALLING 2
+#define RISING  3
+
+#define bit(b)                  (1UL << (b))
+#define bitRead(value, b)       (((value) >> (b)) & 1)
+#define bitSet(value, b)        ((value) |= bit(b))
+#define bitClear(value, b)      ((value) &= ~bit(b))
+
+/*
+ * Pins only keep the level last written, an input reads what HostPinSet()
+ * or digitalWrite() (the pull-up) left on it.
+ */
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void HostPinSet(uint8_t pin, uint8_t value);
+
+/*
+ * Handlers are only recorded: tests deliver an interrupt by calling what
+ * HostInterrupt() returns for it, NULL when detached.
+ */
+void attachInterrupt(uint8_t num, void (*handler)(), int mode);
+void detachInterrupt(uint8_t num);
+void (*HostInterrupt(uint8_t num))();
+
+char *itoa(int value, char *str, int base);
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * ATmega328 registers, pins and external interrupts of the host shim, see
+ * avr/io.h, avr/interrupt.h and Arduino.h.
+ */
+
+#include "Arduino.h"
+
+volatile uint8_t PORTB, DDRB, PINB;
+volatile uint8_t PORTC, DDRC, PINC;
+volatile uint8_t PORTD, DDRD, PIND;
+volatile uint8_t HostSPCR, HostSPSR = _BV(SPIF), HostEIMSK;
+volatile uint8_t TCCR1A, TCCR1B, TIMSK1, TIFR1;
+volatile uint16_t TCNT1, OCR1A;
+volatile uint8_t HostSREG = 1 << SREG_I;
+
+uint8_t (*HostSpiTransfer)(uint8_t out);
+HostSpiData HostSPDR;
+
+static uint8_t pinLevel[32];
+static void (*interruptHandler[2])();
+
+void
+pinMode(uint8_t, uint8_t) {
+}
+
+void
+digitalWrite(uint8_t pin, uint8_t value) {
+    pinLevel[pin & 31] = value != 0;
+}
+
+int
+digitalRead(uint8_t pin) {
+    return pinLevel[pin & 31];
+}
+
+void
+HostPinSet(uint8_t pin, uint8_t value) {
+    pinLevel[pin & 31] = value != 0;
+}
+
+void
+attachInterrupt(uint8_t num, void (*handler)(), int) {
+    interruptHandler[num & 1] = handler;
+}
+
+void
+detachInterrupt(uint8_t num) {
+    interruptHandler[num & 1] = NULL;
+}
+
+void
+(*HostInterrupt(uint8_t num))() {
+    return interruptHandler[num & 1];
+}
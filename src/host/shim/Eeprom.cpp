@@ -0,0 +1,60 @@
+/*
+ * Host side implementation of the EEPROM shim, see avr/eeprom.h
+ */
+
+#include <avr/eeprom.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+HostEepromState HostEeprom;
+
+static size_t
+Address(const void *addr, size_t n) {
+    uintptr_t a = (uintptr_t)addr;
+
+    if (a > E2END || n > E2END + 1 - a) {
+        fprintf(stderr, "EEPROM access out of range: %lu bytes at %lu\n", (unsigned long)n, (unsigned long)a);
+        abort();
+    }
+    return a;
+}
+
+void
+HostEepromErase() {
+    memset(HostEeprom.data, 0xff, sizeof(HostEeprom.data));
+    memset(HostEeprom.cellWrites, 0, sizeof(HostEeprom.cellWrites));
+    HostEeprom.reads = HostEeprom.writes = 0;
+    HostEeprom.writesLeft = -1;
+}
+
+uint8_t
+eeprom_read_byte(const uint8_t *addr) {
+    HostEeprom.reads++;
+    return HostEeprom.data[Address(addr, 1)];
+}
+
+void
+eeprom_write_byte(uint8_t *addr, uint8_t value) {
+    size_t a = Address(addr, 1);
+
+    if (HostEeprom.writesLeft == 0)
+        return;
+    if (HostEeprom.writesLeft > 0)
+        HostEeprom.writesLeft--;
+    HostEeprom.data[a] = value;
+    HostEeprom.cellWrites[a]++;
+    HostEeprom.writes++;
+}
+
+void
+eeprom_read_block(void *dst, const void *src, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        ((uint8_t *)dst)[i] = eeprom_read_byte((const uint8_t *)src + i);
+}
+
+void
+eeprom_write_block(const void *src, void *dst, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        eeprom_write_byte((uint8_t *)dst + i, ((const uint8_t *)src)[i]);
+}
@@ -0,0 +1,86 @@
+/*
+ * Simulated network of the host shim, see EtherCard.h.
+ */
+
+#include "EtherCard.h"
+#include <stdarg.h>
+
+HostEtherNet HostEther;
+
+void
+BufferFiller::emit_p(const char *fmt, ...) {
+    va_list ap;
+    char num[12];
+    const char *s;
+
+    va_start(ap, fmt);
+    for (; *fmt != 0; fmt++) {
+        if (*fmt != '$' || (fmt[1] != 'D' && fmt[1] != 'S' && fmt[1] != 'F')) {
+            write(*fmt);
+            continue;
+        }
+        if (*++fmt == 'D') {
+            snprintf(num, sizeof(num), "%d", va_arg(ap, int));
+            s = num;
+        } else {
+            s = va_arg(ap, const char *);
+        }
+        emit_raw(s, strlen(s));
+    }
+    va_end(ap);
+}
+
+uint16_t
+EtherCard::packetReceive(uint8_t *buf, uint16_t size) {
+    uint16_t len;
+
+    if (HostEther.received.empty()) {
+        HostClockSet((millis() + 1) * 1000ULL);
+        return 0;
+    }
+    len = HostEther.received.front().size() < size ? HostEther.received.front().size() : size;
+    memcpy(buf, HostEther.received.front().data(), len);
+    HostEther.received.pop_front();
+    return len;
+}
+
+static void
+Swap(uint8_t *a, uint8_t *b, uint8_t len) {
+    for (uint8_t i = 0; i < len; i++) {
+        uint8_t c = a[i];
+
+        a[i] = b[i];
+        b[i] = c;
+    }
+}
+
+// The reply to the segment in buf: addresses and ports swapped, our sequence number from its ACK
+void
+make_tcp_ack_from_any(uint8_t *buf, int16_t datlentoack, uint8_t addflags) {
+    uint32_t seq = 0;
+
+    Swap(&buf[IP_SRC_P], &buf[IP_DST_P], 4);
+    Swap(&buf[TCP_SRC_PORT_H_P], &buf[TCP_DST_PORT_H_P], 2);
+    Swap(&buf[TCP_SEQ_H_P], &buf[TCP_SEQACK_H_P], 4);
+    if (addflags != TCP_FLAGS_RST_V && datlentoack == 0)
+        datlentoack = 1;
+    for (uint8_t i = 0; i < 4; i++)
+        seq = seq << 8 | buf[TCP_SEQACK_H_P + i];
+    seq += datlentoack;
+    for (uint8_t i = 4; i != 0; i--, seq >>= 8)
+        buf[TCP_SEQACK_H_P + i - 1] = seq & 0xff;
+    buf[TCP_FLAGS_P] = TCP_FLAGS_ACK_V | addflags;
+    buf[TCP_HEADER_LEN_P] = TCP_HEADER_LEN_PLAIN << 2;
+    if (HostEther.sent != NULL)
+        HostEther.sent(buf, 0);
+}
+
+void
+make_tcp_ack_with_data_noflags(uint8_t *buf, uint16_t dlen) {
+    uint16_t len = IP_HEADER_LEN + TCP_HEADER_LEN_PLAIN + dlen;
+
+    buf[IP_TOTLEN_H_P] = len >> 8;
+    buf[IP_TOTLEN_L_P] = len & 0xff;
+    if (HostEther.sent != NULL)
+        HostEther.sent(buf, dlen);
+}
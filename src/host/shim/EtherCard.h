@@ -0,0 +1,59 @@
+/*
+ * Host replacement for the parts of the EtherCard library the DataLogger
+ * pages use, over a simulated network.  packetReceive() hands over the
+ * packets queued in HostEther.received, one per call, and moves the clock
+ * 1 ms on when there is none, so that a wait for a packet ends once the
+ * clock is frozen.  Each packet sent by make_tcp_ack_from_any() or
+ * make_tcp_ack_with_data_noflags() is passed to HostEther.sent.
+ */
+
+#ifndef EtherCard_h
+#define EtherCard_h
+
+#include "Arduino.h"
+#include "net.h"
+#include <deque>
+#include <vector>
+
+struct HostEtherNet {
+    std::deque<std::vector<uint8_t> > received;
+    // Headers up to TCP_OPTIONS_P, then dataLen bytes of TCP data
+    void (*sent)(const uint8_t *packet, uint16_t dataLen);
+};
+
+extern HostEtherNet HostEther;
+
+class BufferFiller : public Print {
+public:
+    BufferFiller() : start(0), ptr(0) {}
+    BufferFiller(uint8_t *buf) : start(buf), ptr(buf) {}
+
+    // $D an int, $S a string, $F a string in flash, other characters as they are
+    void emit_p(const char *fmt, ...);
+    void emit_raw(const char *s, uint16_t n) {
+        memcpy(ptr, s, n);
+        ptr += n;
+    }
+    uint16_t position() const { return ptr - start; }
+
+    using Print::write;
+    size_t write(uint8_t c) {
+        *ptr++ = c;
+        return 1;
+    }
+
+private:
+    uint8_t *start, *ptr;
+};
+
+class EtherCard {
+public:
+    uint16_t packetReceive(uint8_t *buf, uint16_t size);
+    uint8_t *tcpOffset(uint8_t *buf) { return buf + TCP_OPTIONS_P; }
+};
+
+// From ip_arp_udp_tcp.cpp
+void make_tcp_ack_from_any(uint8_t *buf, int16_t datlentoack, uint8_t addflags);
+void make_tcp_ack_with_data_noflags(uint8_t *buf, uint16_t dlen);
+
+#endif
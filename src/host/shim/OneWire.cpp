@@ -0,0 +1,67 @@
+/*
+ * Simulated 1-Wire bus of the host shim, see OneWire.h.
+ */
+
+#include "OneWire.h"
+
+HostOneWireBus HostOneWire;
+
+uint8_t
+OneWire::reset() {
+    HostOneWire.resets++;
+    HostOneWire.readPos = sizeof(HostOneWire.scratchpad);
+    HostOneWire.power = false;
+    return HostOneWire.present;
+}
+
+void
+OneWire::skip() {
+}
+
+void
+OneWire::write(uint8_t v, uint8_t power) {
+    HostOneWire.lastCommand = v;
+    HostOneWire.power = power != 0;
+    if (v == 0x44) {
+        HostOneWire.conversions++;
+    } else if (v == 0xBE) {
+        HostOneWire.scratchpadReads++;
+        HostOneWire.readPos = 0;
+    }
+}
+
+uint8_t
+OneWire::read() {
+    if (!HostOneWire.present || HostOneWire.readPos >= sizeof(HostOneWire.scratchpad))
+        return 0xff;
+    return HostOneWire.scratchpad[HostOneWire.readPos++];
+}
+
+uint8_t
+OneWire::read_bit() {
+    return HostOneWire.present && !HostOneWire.converting;
+}
+
+void
+OneWire::depower() {
+    HostOneWire.power = false;
+}
+
+uint8_t
+OneWire::crc8(const uint8_t *addr, uint8_t len) {
+    uint8_t crc = 0;
+
+    while (len--) {
+        uint8_t b = *addr++;
+
+        for (uint8_t i = 0; i < 8; i++) {
+            uint8_t mix = (crc ^ b) & 1;
+
+            crc >>= 1;
+            if (mix)
+                crc ^= 0x8C;
+            b >>= 1;
+        }
+    }
+    return crc;
+}
@@ -0,0 +1,44 @@
+/*
+ * Host replacement for the OneWire library, with one simulated device on
+ * the bus standing for a DS18B20: reset() tells whether it is present,
+ * the commands written are recorded, read() returns the bytes of its
+ * scratchpad after a Read Scratchpad command, and read_bit() is 0 while
+ * it converts.
+ */
+
+#ifndef OneWire_h
+#define OneWire_h
+
+#include <stdint.h>
+
+struct HostOneWireBus {
+    bool present;
+    bool converting;
+    uint8_t scratchpad[9];
+    uint8_t readPos;                // Next scratchpad byte, 9 when none
+    uint8_t lastCommand;
+    bool power;                     // Strong pull-up after the last write
+    unsigned resets, conversions, scratchpadReads;
+};
+
+extern HostOneWireBus HostOneWire;
+
+class OneWire {
+public:
+    OneWire(uint8_t pin) : pin(pin) {}
+
+    uint8_t reset();
+    void skip();
+    void write(uint8_t v, uint8_t power = 0);
+    uint8_t read();
+    uint8_t read_bit();
+    void depower();
+
+    // Dallas CRC-8, x^8 + x^5 + x^4 + 1 LSB first
+    static uint8_t crc8(const uint8_t *addr, uint8_t len);
+
+private:
+    uint8_t pin;
+};
+
+#endif
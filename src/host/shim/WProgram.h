@@ -0,0 +1,5 @@
+/*
+ * Arduino 0022 name of the core header, for the sources that still use it.
+ */
+
+#include "Arduino.h"
@@ -0,0 +1,34 @@
+/*
+ * Host replacement for avr-libc's EEPROM access: an ATmega328 sized array,
+ * the EEPROM pointers being addresses into it.  Reads, writes and the writes
+ * of each cell are counted, and a power cut can be simulated by giving the
+ * number of writes still done: the ones after it are lost.
+ */
+
+#ifndef EEPROM_H
+#define EEPROM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define E2END   0x3ff
+#define EEMEM
+
+struct HostEepromState {
+    uint8_t data[E2END + 1];
+    unsigned long cellWrites[E2END + 1];
+    unsigned long long reads, writes;
+    long long writesLeft;       // Before the power cut, -1 for none
+};
+
+extern HostEepromState HostEeprom;
+
+// Blank EEPROM, all 0xff as erased cells, counters cleared
+void HostEepromErase();
+
+uint8_t eeprom_read_byte(const uint8_t *addr);
+void eeprom_write_byte(uint8_t *addr, uint8_t value);
+void eeprom_read_block(void *dst, const void *src, size_t n);
+void eeprom_write_block(const void *src, void *dst, size_t n);
+
+#endif
@@ -0,0 +1,22 @@
+/*
+ * Host replacement for avr-libc's interrupt handling.  SREG only holds the
+ * global interrupt flag, which cli() and sei() clear and set, and an ISR is
+ * a plain function of the vector name that tests call to deliver the
+ * interrupt.
+ */
+
+#ifndef INTERRUPT_H
+#define INTERRUPT_H
+
+#include <stdint.h>
+
+extern volatile uint8_t HostSREG;
+#define SREG        HostSREG
+#define SREG_I      7
+
+#define cli()       (HostSREG &= ~(1 << SREG_I))
+#define sei()       (HostSREG |= 1 << SREG_I)
+
+#define ISR(vector) extern "C" void vector()
+
+#endif
@@ -0,0 +1,67 @@
+/*
+ * Host replacement for avr-libc's ATmega328 I/O registers: the ones the
+ * firmware touches are plain variables, except SPDR.  Writing SPDR makes an
+ * SPI transfer through HostSpiTransfer, reading it gives the byte received,
+ * and SPIF always reads set, the transfer being done at once.  With no
+ * transfer function, 0 is received.
+ */
+
+#ifndef IO_H
+#define IO_H
+
+#include <stdint.h>
+
+#define _BV(bit)    (1 << (bit))
+
+extern volatile uint8_t PORTB, DDRB, PINB;
+extern volatile uint8_t PORTC, DDRC, PINC;
+extern volatile uint8_t PORTD, DDRD, PIND;
+extern volatile uint8_t HostSPCR, HostSPSR, HostEIMSK;
+extern volatile uint8_t TCCR1A, TCCR1B, TIMSK1, TIFR1;
+extern volatile uint16_t TCNT1, OCR1A;
+
+#define PORTC3      3
+#define PORTD7      7
+#define DDD7        7
+
+// SPI, with the register names tested by #ifdef in the drivers
+#define SPCR        HostSPCR
+#define SPSR        HostSPSR
+#define SPR0        0
+#define SPR1        1
+#define MSTR        4
+#define SPE         6
+#define SPI2X       0
+#define SPIF        7
+
+extern uint8_t (*HostSpiTransfer)(uint8_t out);
+
+class HostSpiData {
+public:
+    HostSpiData &operator=(uint8_t out) {
+        in = HostSpiTransfer ? HostSpiTransfer(out) : 0;
+        return *this;
+    }
+    operator uint8_t() const { return in; }
+
+private:
+    uint8_t in;
+};
+
+extern HostSpiData HostSPDR;
+#define SPDR        HostSPDR
+
+// External interrupts
+#define EIMSK       HostEIMSK
+#define INT0        0
+#define INT1        1
+
+// Timer1
+#define CS10        0
+#define CS11        1
+#define CS12        2
+#define WGM12       3
+#define OCIE1A      1
+#define OCF1A       1
+
+#endif
@@ -0,0 +1,22 @@
+/*
+ * Host replacement for avr-libc's program space access: there is a single
+ * address space, so flash data is plain const data.
+ */
+
+#ifndef PGMSPACE_H
+#define PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+
+#define memcpy_P memcpy
+#define strlen_P strlen
+#define strncmp_P strncmp
+
+#endif
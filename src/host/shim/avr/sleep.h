@@ -0,0 +1,15 @@
+/*
+ * Host replacement for avr-libc's sleep modes: sleeping returns at once.
+ */
+
+#ifndef SLEEP_H
+#define SLEEP_H
+
+#define SLEEP_MODE_IDLE         0
+#define SLEEP_MODE_PWR_DOWN     2
+#define SLEEP_MODE_STANDBY      6
+
+#define set_sleep_mode(mode)    ((void)(mode))
+#define sleep_mode()            do {} while (0)
+
+#endif
@@ -0,0 +1,39 @@
+/*
+ * Host copy of the offsets and values of the EtherCard net.h that the
+ * DataLogger pages use: Ethernet, IPv4 and TCP headers without options,
+ * as the enc28j60 stack builds them.
+ */
+
+#ifndef NET_H
+#define NET_H
+
+#define ETH_HEADER_LEN          14
+#define ETH_TYPE_H_P            12
+#define ETH_TYPE_L_P            13
+#define ETH_TYPE_IP_H_V         0x08
+#define ETH_TYPE_IP_L_V         0x00
+
+#define IP_P                    0x0E
+#define IP_HEADER_LEN           20
+#define IP_TOTLEN_H_P           0x10
+#define IP_TOTLEN_L_P           0x11
+#define IP_PROTO_P              0x17
+#define IP_SRC_P                0x1a
+#define IP_DST_P                0x1e
+#define IP_PROTO_TCP_V          6
+
+#define TCP_SRC_PORT_H_P        0x22
+#define TCP_DST_PORT_H_P        0x24
+#define TCP_SEQ_H_P             0x26
+#define TCP_SEQACK_H_P          0x2a
+#define TCP_HEADER_LEN_P        0x2e
+#define TCP_FLAGS_P             0x2f
+#define TCP_FLAGS_FIN_V         0x01
+#define TCP_FLAGS_SYN_V         0x02
+#define TCP_FLAGS_RST_V         0x04
+#define TCP_FLAGS_PUSH_V        0x08
+#define TCP_FLAGS_ACK_V         0x10
+#define TCP_HEADER_LEN_PLAIN    20
+#define TCP_OPTIONS_P           0x36
+
+#endif
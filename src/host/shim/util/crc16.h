@@ -0,0 +1,27 @@
+/*
+ * Host versions of the avr-libc CRC updates the firmware uses, from the C
+ * equivalents given in its documentation.
+ */
+
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stdint.h>
+
+static inline uint16_t
+_crc16_update(uint16_t crc, uint8_t a) {
+    crc ^= a;
+    for (int i = 0; i < 8; ++i)
+        crc = crc & 1 ? (crc >> 1) ^ 0xA001 : crc >> 1;
+    return crc;
+}
+
+static inline uint16_t
+_crc_xmodem_update(uint16_t crc, uint8_t data) {
+    crc ^= (uint16_t)data << 8;
+    for (int i = 0; i < 8; i++)
+        crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    return crc;
+}
+
+#endif